@@ -1,5 +1,7 @@
 #include <gst/gst.h>
 
+#include "registry_snapshot.h"
+
 int main(int argc, char *argv[]) {
   GstElement *pipeline = NULL;
   GstBus *bus = NULL;
@@ -8,7 +10,8 @@ int main(int argc, char *argv[]) {
                "uri=https://www.freedesktop.org/software/gstreamer-sdk/data/"
                "media/sintel_trailer-480p.webm";
 
-  /* Initialize GStreamer */
+  /* Initialize GStreamer, from the trimmed registry if $GST_TUTORIAL_REGISTRY_SNAPSHOT points to one */
+  registry_snapshot_use(NULL);
   gst_init(&argc, &argv);
 
   /* Build the pipeline */
@@ -0,0 +1,135 @@
+#include <gst/gst.h>
+
+#include "pipeline_pool.h"
+#include "registry_snapshot.h"
+
+#define DEFAULT_RUNS 5      // Playback requests to serve
+#define DEFAULT_POOL_SIZE 2 // Idle playbins kept ready
+
+/* Waits for the first frame (end of the preroll), returns FALSE on error */
+static gboolean wait_first_frame(GstElement *);
+
+int main(int argc, char *argv[]) {
+  PipelinePool *pool = NULL;
+  GError *err = NULL;
+  gint runs = DEFAULT_RUNS, pool_size = DEFAULT_POOL_SIZE;
+  gboolean cold = FALSE, warmup = FALSE;
+  gchar *uri = NULL;
+  GOptionEntry entries[] = {
+      {"runs", 'r', 0, G_OPTION_ARG_INT, &runs, "Playback requests to serve", "N"},
+      {"pool-size", 'k', 0, G_OPTION_ARG_INT, &pool_size, "Idle playbins kept ready", "K"},
+      {"warmup", 'w', 0, G_OPTION_ARG_NONE, &warmup, "Preroll the URI once in every new playbin", NULL},
+      {"cold", 'c', 0, G_OPTION_ARG_NONE, &cold, "Build a new playbin for every request, for comparison", NULL},
+      {"uri", 'u', 0, G_OPTION_ARG_STRING, &uri, "Media to play", "URI"},
+      {NULL}};
+  GOptionContext *context;
+  gdouble total = 0;
+
+  /* Initialize GStreamer and parse the options, from the trimmed registry if there is one */
+  registry_snapshot_use(NULL);
+  context = g_option_context_new("- time to first frame with a pool of playbins");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("Failed to parse options: %s\n", err->message);
+    g_clear_error(&err);
+    g_option_context_free(context);
+
+    return -1;
+  }
+  g_option_context_free(context);
+
+  if (runs < 1 || pool_size < 1) {
+    g_printerr("Runs and pool size must be positive.\n");
+    return -1;
+  }
+  if (uri == NULL)
+    uri = g_strdup("https://www.freedesktop.org/software/gstreamer-sdk/data/media/sintel_trailer-480p.webm");
+
+  /* Build the pool, off the critical path of the requests */
+  if (!cold) {
+    pool = pipeline_pool_new("playbin", pool_size, warmup ? uri : NULL, &err);
+    if (!pool) {
+      g_error("Unable to build the pipeline pool: %s", err->message);
+      g_clear_error(&err);
+
+      return -1;
+    }
+  }
+
+  for (gint i = 0; i < runs; i++) {
+    GstElement *pipeline;
+    gint64 start = g_get_monotonic_time();
+    gdouble elapsed;
+
+    /* Get a pipeline for the request */
+    if (cold) {
+      gchar *description = g_strdup_printf("playbin uri=%s", uri);
+
+      pipeline = gst_parse_launch(description, &err);
+      g_free(description);
+    } else {
+      pipeline = pipeline_pool_acquire(pool, uri, &err);
+    }
+    if (!pipeline) {
+      g_error("Unable to get a pipeline: %s", err->message);
+      g_clear_error(&err);
+
+      return -1;
+    }
+
+    /* Start playing */
+    if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE || !wait_first_frame(pipeline)) {
+      g_printerr("Run %d failed\n", i);
+    } else {
+      elapsed = (g_get_monotonic_time() - start) / 1000.0;
+      total += elapsed;
+      g_print("Run %d: first frame after %.1f ms\n", i, elapsed);
+    }
+
+    /* Give it back */
+    if (cold) {
+      gst_element_set_state(pipeline, GST_STATE_NULL);
+      gst_object_unref(pipeline);
+    } else {
+      pipeline_pool_release(pool, pipeline);
+    }
+  }
+
+  g_print("Average time to first frame (%s): %.1f ms\n", cold ? "cold" : "pool", total / runs);
+  if (pool) {
+    PipelinePoolStats stats;
+
+    pipeline_pool_get_stats(pool, &stats);
+    g_print("Pool: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses, %" G_GUINT64_FORMAT " built\n", stats.hits,
+            stats.misses, stats.built);
+  }
+
+  /* Free resources */
+  pipeline_pool_free(pool);
+  g_free(uri);
+
+  return 0;
+}
+
+static gboolean wait_first_frame(GstElement *pipeline) {
+  GstBus *bus = gst_element_get_bus(pipeline);
+  GstMessage *msg;
+  gboolean ret;
+
+  /* ASYNC_DONE is posted once the sinks prerolled, that is once the first frame is ready to be shown */
+  msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_ASYNC_DONE | GST_MESSAGE_ERROR);
+  ret = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ASYNC_DONE;
+  if (!ret) {
+    GError *err;
+
+    gst_message_parse_error(msg, &err, NULL);
+    g_printerr("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
+    g_clear_error(&err);
+  }
+
+  gst_message_unref(msg);
+  gst_object_unref(bus);
+
+  return ret;
+}
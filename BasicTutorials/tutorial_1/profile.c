@@ -0,0 +1,412 @@
+#include <gst/gst.h>
+#include <string.h>
+
+#include "registry_snapshot.h"
+
+#define DEFAULT_DURATION 5 // Seconds played before stopping
+
+/* One measured phase (duration >= 0) or instant (duration < 0), times in microseconds since main() started */
+typedef struct _ProfileEvent {
+  gchar *name;
+  const gchar *category;
+  gint64 start;
+  gint64 duration;
+  GThread *thread;
+} ProfileEvent;
+
+/* A sink found in the pipeline, with the probe waiting for its first buffer */
+typedef struct _SinkData {
+  struct _CustomData *data;
+  gchar *name;
+  gint64 first_buffer; // -1 until a buffer arrived
+  gboolean rendered;   // Have we recorded the first render yet?
+} SinkData;
+
+/* Structure to contain all our information, so we can pass it around */
+typedef struct _CustomData {
+  gint64 origin; // Monotonic time at the start of main()
+  GstElement *pipeline;
+
+  GMutex lock;            // Events come from the streaming threads too, everything below is protected
+  GArray *events;         // ProfileEvent
+  GPtrArray *sinks;       // SinkData
+  gint64 last_transition; // End of the previous state transition of the pipeline, start of the next one
+  gint64 playing;         // When the pipeline reached PLAYING, -1 before
+} CustomData;
+
+/* Microseconds since main() started */
+static gint64 profile_now(CustomData *);
+
+/* Record a phase or an instant, the lock must be held for instants from streaming threads */
+static void add_event(CustomData *, const gchar *, const gchar *, gint64, gint64);
+
+/* Time state transitions as soon as they are posted, in the thread that posts them */
+static GstBusSyncReply sync_handler(GstBus *, GstMessage *, CustomData *);
+
+/* Put a first buffer probe on every sink, including the ones playbin creates later */
+static void watch_sink(CustomData *, GstElement *);
+static void deep_element_added_cb(GstBin *, GstBin *, GstElement *, CustomData *);
+
+/* Write the per-phase breakdown and the Chrome trace */
+static gchar *profile_to_json(CustomData *, const gchar *);
+static gchar *profile_to_trace(CustomData *);
+
+int main(int argc, char *argv[]) {
+  CustomData data;
+  GstBus *bus;
+  GstMessage *msg;
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+  GError *err = NULL;
+  gint64 start;
+  gint duration = DEFAULT_DURATION;
+  gchar *uri = NULL, *description = NULL, *output = NULL, *trace = NULL, *json;
+  gboolean snapshot;
+  GOptionEntry entries[] = {
+      {"uri", 'u', 0, G_OPTION_ARG_STRING, &uri, "Media played by playbin", "URI"},
+      {"pipeline", 'p', 0, G_OPTION_ARG_STRING, &description, "Launch this pipeline instead of playbin", "DESCRIPTION"},
+      {"duration", 'd', 0, G_OPTION_ARG_INT, &duration, "Seconds played before stopping", "SECONDS"},
+      {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the phase breakdown there instead of stdout", "FILE"},
+      {"trace", 't', 0, G_OPTION_ARG_FILENAME, &trace, "Write a Chrome trace (chrome://tracing, Perfetto)", "FILE"},
+      {NULL}};
+  GOptionContext *context;
+
+  /* Initialize custom data structure, the clock starts now */
+  memset(&data, 0, sizeof(data));
+  data.origin = g_get_monotonic_time();
+  data.events = g_array_new(FALSE, FALSE, sizeof(ProfileEvent));
+  data.sinks = g_ptr_array_new();
+  data.playing = -1;
+  g_mutex_init(&data.lock);
+
+  /* Initialize GStreamer, the registry is loaded (and updated if needed) here */
+  start = profile_now(&data);
+  snapshot = registry_snapshot_use(NULL);
+  context = g_option_context_new("- where the startup time goes, from gst_init to the first frame");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("Failed to parse options: %s\n", err->message);
+    g_clear_error(&err);
+    g_option_context_free(context);
+
+    return -1;
+  }
+  g_option_context_free(context);
+  add_event(&data, snapshot ? "gst_init (registry snapshot)" : "gst_init", "init", start, profile_now(&data) - start);
+
+  if (description == NULL) {
+    GstElementFactory *factory;
+
+    if (uri == NULL)
+      uri = g_strdup("https://www.freedesktop.org/software/gstreamer-sdk/data/media/sintel_trailer-480p.webm");
+    description = g_strdup_printf("playbin uri=%s", uri);
+
+    /* Loading the playbin plugin is otherwise hidden in gst_parse_launch */
+    start = profile_now(&data);
+    factory = gst_element_factory_find("playbin");
+    if (factory) {
+      GstPluginFeature *loaded = gst_plugin_feature_load(GST_PLUGIN_FEATURE(factory));
+
+      if (loaded)
+        gst_object_unref(loaded);
+      gst_object_unref(factory);
+    }
+    add_event(&data, "plugin load (playbin)", "init", start, profile_now(&data) - start);
+  }
+
+  /* Build the pipeline */
+  start = profile_now(&data);
+  data.pipeline = gst_parse_launch(description, &err);
+  add_event(&data, "gst_parse_launch", "init", start, profile_now(&data) - start);
+  if (!data.pipeline) {
+    g_printerr("Unable to build the pipeline: %s\n", err->message);
+    g_clear_error(&err);
+
+    return -1;
+  }
+  g_clear_error(&err);
+
+  /* Sinks that exist already, then the ones added later */
+  it = gst_bin_iterate_recurse(GST_BIN(data.pipeline));
+  while (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+    watch_sink(&data, g_value_get_object(&item));
+    g_value_reset(&item);
+  }
+  g_value_unset(&item);
+  gst_iterator_free(it);
+  g_signal_connect(data.pipeline, "deep-element-added", G_CALLBACK(deep_element_added_cb), &data);
+
+  bus = gst_element_get_bus(data.pipeline);
+  gst_bus_set_sync_handler(bus, (GstBusSyncHandler)sync_handler, &data, NULL);
+
+  /* Start playing */
+  g_mutex_lock(&data.lock);
+  data.last_transition = profile_now(&data);
+  g_mutex_unlock(&data.lock);
+  if (gst_element_set_state(data.pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    g_printerr("Unable to set the pipeline to the playing state.\n");
+
+  /* Play for a while, or until error or EOS */
+  msg = gst_bus_timed_pop_filtered(bus, duration * GST_SECOND, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+  if (msg != NULL) {
+    if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+      gst_message_parse_error(msg, &err, NULL);
+      g_printerr("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
+      g_clear_error(&err);
+    }
+    gst_message_unref(msg);
+  }
+
+  /* The shutdown is timed as well */
+  g_mutex_lock(&data.lock);
+  data.last_transition = profile_now(&data);
+  g_mutex_unlock(&data.lock);
+  gst_element_set_state(data.pipeline, GST_STATE_NULL);
+
+  /* Write the results */
+  json = profile_to_json(&data, description);
+  if (output) {
+    if (!g_file_set_contents(output, json, -1, &err)) {
+      g_printerr("Could not write %s: %s\n", output, err->message);
+      g_clear_error(&err);
+    }
+  } else {
+    g_print("%s", json);
+  }
+  g_free(json);
+
+  if (trace) {
+    json = profile_to_trace(&data);
+    if (!g_file_set_contents(trace, json, -1, &err)) {
+      g_printerr("Could not write %s: %s\n", trace, err->message);
+      g_clear_error(&err);
+    }
+    g_free(json);
+  }
+
+  /* Free resources */
+  gst_bus_set_sync_handler(bus, NULL, NULL, NULL);
+  gst_object_unref(bus);
+  gst_object_unref(data.pipeline);
+  for (guint i = 0; i < data.events->len; i++)
+    g_free(g_array_index(data.events, ProfileEvent, i).name);
+  g_array_free(data.events, TRUE);
+  for (guint i = 0; i < data.sinks->len; i++) {
+    SinkData *sink = g_ptr_array_index(data.sinks, i);
+
+    g_free(sink->name);
+    g_free(sink);
+  }
+  g_ptr_array_free(data.sinks, TRUE);
+  g_mutex_clear(&data.lock);
+  g_free(uri);
+  g_free(description);
+  g_free(output);
+  g_free(trace);
+
+  return 0;
+}
+
+static gint64 profile_now(CustomData *data) {
+  return g_get_monotonic_time() - data->origin;
+}
+
+static void add_event(CustomData *data, const gchar *name, const gchar *category, gint64 start, gint64 duration) {
+  ProfileEvent event;
+
+  event.name = g_strdup(name);
+  event.category = category;
+  event.start = start;
+  event.duration = duration;
+  event.thread = g_thread_self();
+  g_array_append_val(data->events, event);
+}
+
+/* Must be called with the lock */
+static void add_first_render(CustomData *data, SinkData *sink, gint64 now) {
+  gchar *name;
+
+  /* A prerolled frame is shown once the pipeline is PLAYING, a later one as soon as it arrives */
+  if (sink->rendered || sink->first_buffer < 0 || data->playing < 0)
+    return;
+
+  name = g_strdup_printf("first render %s", sink->name);
+  add_event(data, name, "first-render", now, -1);
+  g_free(name);
+  sink->rendered = TRUE;
+}
+
+static GstBusSyncReply sync_handler(GstBus *bus, GstMessage *msg, CustomData *data) {
+  GstState old_state, new_state;
+  gchar *name;
+  gint64 now;
+
+  if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_STATE_CHANGED || GST_MESSAGE_SRC(msg) != GST_OBJECT(data->pipeline))
+    return GST_BUS_PASS;
+
+  now = profile_now(data);
+  gst_message_parse_state_changed(msg, &old_state, &new_state, NULL);
+
+  /* Named like the dot dumps, NULL_READY, READY_PAUSED... */
+  name = g_strdup_printf("%s_%s", gst_element_state_get_name(old_state), gst_element_state_get_name(new_state));
+
+  g_mutex_lock(&data->lock);
+  add_event(data, name, "state", data->last_transition, now - data->last_transition);
+  data->last_transition = now;
+
+  if (new_state == GST_STATE_PLAYING && data->playing < 0) {
+    data->playing = now;
+    for (guint i = 0; i < data->sinks->len; i++)
+      add_first_render(data, g_ptr_array_index(data->sinks, i), now);
+  }
+  g_mutex_unlock(&data->lock);
+
+  g_free(name);
+
+  return GST_BUS_PASS;
+}
+
+static GstPadProbeReturn first_buffer_probe(GstPad *pad, GstPadProbeInfo *info, SinkData *sink) {
+  CustomData *data = sink->data;
+  gint64 now = profile_now(data);
+  gchar *name;
+
+  name = g_strdup_printf("first buffer %s", sink->name);
+
+  g_mutex_lock(&data->lock);
+  if (sink->first_buffer < 0) {
+    sink->first_buffer = now;
+    add_event(data, name, "first-buffer", now, -1);
+    add_first_render(data, sink, now);
+  }
+  g_mutex_unlock(&data->lock);
+
+  g_free(name);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+static void watch_sink(CustomData *data, GstElement *element) {
+  SinkData *sink;
+  GstPad *pad;
+
+  /* Bins holding a sink have the flag too, only the real sinks are interesting */
+  if (GST_IS_BIN(element) || !GST_OBJECT_FLAG_IS_SET(element, GST_ELEMENT_FLAG_SINK))
+    return;
+
+  pad = gst_element_get_static_pad(element, "sink");
+  if (!pad)
+    return;
+
+  sink = g_new0(SinkData, 1);
+  sink->data = data;
+  sink->name = gst_object_get_name(GST_OBJECT(element));
+  sink->first_buffer = -1;
+
+  g_mutex_lock(&data->lock);
+  g_ptr_array_add(data->sinks, sink);
+  g_mutex_unlock(&data->lock);
+
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+                    (GstPadProbeCallback)first_buffer_probe, sink, NULL);
+  gst_object_unref(pad);
+}
+
+static void deep_element_added_cb(GstBin *bin, GstBin *sub_bin, GstElement *element, CustomData *data) {
+  watch_sink(data, element);
+}
+
+static void append_json_string(GString *json, const gchar *str) {
+  g_string_append_c(json, '"');
+  for (const gchar *c = str; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      g_string_append_printf(json, "\\%c", *c);
+    else if ((guchar)*c < 0x20)
+      g_string_append_printf(json, "\\u%04x", *c);
+    else
+      g_string_append_c(json, *c);
+  }
+  g_string_append_c(json, '"');
+}
+
+static gchar *profile_to_json(CustomData *data, const gchar *description) {
+  GString *json = g_string_new("{\n  \"pipeline\": ");
+  gint64 first_render = -1;
+  gboolean first = TRUE;
+
+  append_json_string(json, description);
+
+  g_string_append(json, ",\n  \"phases\": [");
+  for (guint i = 0; i < data->events->len; i++) {
+    ProfileEvent *event = &g_array_index(data->events, ProfileEvent, i);
+
+    if (event->duration < 0)
+      continue;
+
+    g_string_append(json, first ? "\n    {\"name\": " : ",\n    {\"name\": ");
+    append_json_string(json, event->name);
+    g_string_append_printf(json, ", \"category\": \"%s\", \"start_ms\": %.3f, \"duration_ms\": %.3f}", event->category,
+                           event->start / 1000.0, event->duration / 1000.0);
+    first = FALSE;
+  }
+
+  first = TRUE;
+  g_string_append(json, "\n  ],\n  \"events\": [");
+  for (guint i = 0; i < data->events->len; i++) {
+    ProfileEvent *event = &g_array_index(data->events, ProfileEvent, i);
+
+    if (event->duration >= 0)
+      continue;
+
+    if (g_str_equal(event->category, "first-render") && (first_render < 0 || event->start < first_render))
+      first_render = event->start;
+
+    g_string_append(json, first ? "\n    {\"name\": " : ",\n    {\"name\": ");
+    append_json_string(json, event->name);
+    g_string_append_printf(json, ", \"category\": \"%s\", \"time_ms\": %.3f}", event->category, event->start / 1000.0);
+    first = FALSE;
+  }
+
+  g_string_append(json, "\n  ],\n  \"time_to_first_render_ms\": ");
+  if (first_render >= 0)
+    g_string_append_printf(json, "%.3f\n}\n", first_render / 1000.0);
+  else
+    g_string_append(json, "null\n}\n");
+
+  return g_string_free(json, FALSE);
+}
+
+static gchar *profile_to_trace(CustomData *data) {
+  GString *json = g_string_new("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+  GHashTable *threads = g_hash_table_new(NULL, NULL);
+
+  for (guint i = 0; i < data->events->len; i++) {
+    ProfileEvent *event = &g_array_index(data->events, ProfileEvent, i);
+    guint tid = GPOINTER_TO_UINT(g_hash_table_lookup(threads, event->thread));
+
+    /* Small thread ids in order of appearance, the main thread is 1 */
+    if (tid == 0) {
+      tid = g_hash_table_size(threads) + 1;
+      g_hash_table_insert(threads, event->thread, GUINT_TO_POINTER(tid));
+    }
+
+    g_string_append(json, i == 0 ? "\n  {\"name\": " : ",\n  {\"name\": ");
+    append_json_string(json, event->name);
+    if (event->duration >= 0)
+      g_string_append_printf(json,
+                             ", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %" G_GINT64_FORMAT
+                             ", \"dur\": %" G_GINT64_FORMAT ", \"pid\": 1, \"tid\": %u}",
+                             event->category, event->start, event->duration, tid);
+    else
+      g_string_append_printf(json,
+                             ", \"cat\": \"%s\", \"ph\": \"i\", \"s\": \"g\", \"ts\": %" G_GINT64_FORMAT
+                             ", \"pid\": 1, \"tid\": %u}",
+                             event->category, event->start, tid);
+  }
+  g_string_append(json, "\n]}\n");
+
+  g_hash_table_destroy(threads);
+
+  return g_string_free(json, FALSE);
+}
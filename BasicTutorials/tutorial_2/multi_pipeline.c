@@ -0,0 +1,149 @@
+#include <gst/gst.h>
+#include <string.h>
+
+#include "bus_mux.h"
+
+#define DEFAULT_PIPELINES 100 // Pipelines running at the same time
+#define DEFAULT_BUFFERS 150   // Frames of each pipeline, 5 seconds at 30 fps
+
+typedef struct _CustomData CustomData;
+
+/* One pipeline and its bus registration */
+typedef struct _PipelineData {
+  CustomData *data;
+  GstElement *pipeline;
+  guint index;
+  guint mux_id;
+} PipelineData;
+
+/* Structure to contain all our information, so we can pass it around */
+struct _CustomData {
+  BusMux *mux;
+  PipelineData *pipelines;
+  guint n_pipelines;
+  guint n_finished; /* Only touched by the dispatcher thread */
+  guint n_errors;
+};
+
+/* Bus handler of every pipeline, called from the dispatcher thread */
+static void handle_message(GstMessage *, PipelineData *);
+
+int main(int argc, char *argv[]) {
+  CustomData data;
+  GError *err = NULL;
+  gint n_pipelines = DEFAULT_PIPELINES, n_buffers = DEFAULT_BUFFERS;
+  GOptionEntry entries[] = {
+      {"pipelines", 'n', 0, G_OPTION_ARG_INT, &n_pipelines, "Pipelines running at the same time", "N"},
+      {"buffers", 'b', 0, G_OPTION_ARG_INT, &n_buffers, "Frames each pipeline plays", "N"},
+      {NULL}};
+  GOptionContext *context;
+  BusMuxStats stats;
+  gint64 start;
+
+  /* Initialize GStreamer and parse the options */
+  context = g_option_context_new("- many pipelines, one bus dispatcher");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("Failed to parse options: %s\n", err->message);
+    g_clear_error(&err);
+    g_option_context_free(context);
+
+    return -1;
+  }
+  g_option_context_free(context);
+
+  if (n_pipelines < 1 || n_buffers < 1) {
+    g_printerr("Pipelines and buffers must be positive.\n");
+    return -1;
+  }
+
+  /* Initialize custom data structure */
+  memset(&data, 0, sizeof(data));
+  data.mux = bus_mux_new();
+  data.n_pipelines = n_pipelines;
+  data.pipelines = g_new0(PipelineData, n_pipelines);
+
+  /* Create the pipelines, all of their buses go to the same dispatcher */
+  for (guint i = 0; i < data.n_pipelines; i++) {
+    PipelineData *p = &data.pipelines[i];
+    gchar *description;
+
+    description = g_strdup_printf("videotestsrc num-buffers=%d ! video/x-raw,width=320,height=240 ! fakesink sync=true",
+                                  n_buffers);
+    p->pipeline = gst_parse_launch(description, &err);
+    g_free(description);
+    if (!p->pipeline) {
+      g_error("Unable to build the pipeline: %s", err->message);
+      g_clear_error(&err);
+
+      return -1;
+    }
+
+    p->data = &data;
+    p->index = i;
+    p->mux_id = bus_mux_add(data.mux, p->pipeline, (BusMuxHandler)handle_message, p, NULL);
+  }
+
+  /* Start playing */
+  start = g_get_monotonic_time();
+  for (guint i = 0; i < data.n_pipelines; i++) {
+    if (gst_element_set_state(data.pipelines[i].pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+      g_error("Unable to set pipeline %u to the playing state.", i);
+
+      return -1;
+    }
+  }
+
+  /* One thread waits for the messages of all the pipelines, until the last one finished */
+  bus_mux_run(data.mux);
+
+  bus_mux_get_stats(data.mux, &stats);
+  g_print("%u pipelines finished (%u errors) in %.2f s: %" G_GUINT64_FORMAT " messages, %" G_GUINT64_FORMAT
+          " wakeups, %.1f messages per wakeup, at most %u from one bus at once\n",
+          data.n_finished, data.n_errors, (g_get_monotonic_time() - start) / 1e6, stats.messages, stats.wakeups,
+          stats.wakeups ? (gdouble)stats.messages / stats.wakeups : 0.0, stats.max_batch);
+
+  /* Free resources */
+  for (guint i = 0; i < data.n_pipelines; i++) {
+    bus_mux_remove(data.mux, data.pipelines[i].mux_id);
+    gst_element_set_state(data.pipelines[i].pipeline, GST_STATE_NULL);
+    gst_object_unref(data.pipelines[i].pipeline);
+  }
+  bus_mux_free(data.mux);
+  g_free(data.pipelines);
+
+  return 0;
+}
+
+static void handle_message(GstMessage *msg, PipelineData *p) {
+  CustomData *data = p->data;
+  GError *err;
+  gchar *debug_info;
+
+  switch (GST_MESSAGE_TYPE(msg)) {
+  case GST_MESSAGE_ERROR:
+    gst_message_parse_error(msg, &err, &debug_info);
+    g_printerr("Pipeline %u: error received from element %s: %s\n", p->index, GST_OBJECT_NAME(msg->src),
+               err->message);
+    g_printerr("Debugging information: %s\n", debug_info ? debug_info : "none");
+
+    g_clear_error(&err);
+    g_free(debug_info);
+    data->n_errors++;
+
+    /* Fall through, this pipeline is done as well */
+  case GST_MESSAGE_EOS:
+    /* Nothing more to hear from this bus */
+    bus_mux_remove(data->mux, p->mux_id);
+
+    if (++data->n_finished == data->n_pipelines)
+      bus_mux_quit(data->mux);
+
+    break;
+
+  default:
+    /* State changes, stream status, latency... everything else is only counted by the dispatcher */
+    break;
+  }
+}
@@ -1,5 +1,7 @@
 #include <gst/gst.h>
 
+#include "autoplug_cache.h"
+
 /* Structure to contain all out information, so we can pass it to callbacks */
 typedef struct _CustomDaat {
   GstElement *pipeline;
@@ -7,6 +9,9 @@ typedef struct _CustomDaat {
   GstElement *convert;
   GstElement *resample;
   GstElement *sink;
+
+  AutoplugCache *cache; /* NULL unless --autoplug-cache */
+  gint64 start;         /* When playing was requested, for the time to link */
 } CustomData;
 
 /* Handler for the pad-added signal */
@@ -17,12 +22,28 @@ int main(int argc, char *argv[]) {
   GstBus *bus;
   GstMessage *msg;
   GstStateChangeReturn ret;
-  gboolean terminate = FALSE;
+  gboolean terminate = FALSE, use_cache = FALSE;
   const gchar *uri = "https://www.freedesktop.org/software/gstreamer-sdk/data/"
                      "media/sintel_trailer-480p.webm";
+  GOptionEntry entries[] = {
+      {"autoplug-cache", 'a', 0, G_OPTION_ARG_NONE, &use_cache, "Plug the decoders uridecodebin picked in earlier runs",
+       NULL},
+      {NULL}};
+  GOptionContext *context;
+  GError *err = NULL;
+
+  /* Initialize GStreamer and parse the options */
+  context = g_option_context_new("- dynamic pads of uridecodebin");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("Failed to parse options: %s\n", err->message);
+    g_clear_error(&err);
+    g_option_context_free(context);
 
-  /* Initialize GStreamer */
-  gst_init(&argc, &argv);
+    return -1;
+  }
+  g_option_context_free(context);
 
   /* Create the elements */
   data.source = gst_element_factory_make("uridecodebin", "source");
@@ -55,7 +76,13 @@ int main(int argc, char *argv[]) {
   /* Connect to the pad-added signal */
   g_signal_connect(data.source, "pad-added", G_CALLBACK(pad_added_handler), &data);
 
+  /* Let uridecodebin plug the chains it found in earlier runs */
+  data.cache = use_cache ? autoplug_cache_new(NULL) : NULL;
+  if (data.cache)
+    autoplug_cache_attach(data.cache, data.source);
+
   /* Start playing */
+  data.start = g_get_monotonic_time();
   ret = gst_element_set_state(data.pipeline, GST_STATE_PLAYING);
   if (ret == GST_STATE_CHANGE_FAILURE) {
     g_error("Unable to set the pipeline to the playing state.");
@@ -72,12 +99,17 @@ int main(int argc, char *argv[]) {
 
     /* Parse message */
     if (msg != NULL) {
-      GError *err;
       gchar *debug_info;
 
       switch (GST_MESSAGE_TYPE(msg)) {
       case GST_MESSAGE_ERROR:
         gst_message_parse_error(msg, &err, &debug_info);
+
+        /* The cached chains may be what failed */
+        if (data.cache) {
+          autoplug_cache_forget(data.cache);
+          autoplug_cache_save(data.cache, NULL);
+        }
         g_error("Error received from element %s: %s", GST_OBJECT_NAME(msg->src), err->message);
         g_error("Debugging information: %s", debug_info ? debug_info : "none");
 
@@ -100,6 +132,12 @@ int main(int argc, char *argv[]) {
           gst_message_parse_state_changed(msg, &old_state, &new_state, &pending_state);
           g_message("Pipeline state changed from %s to %s:", gst_element_state_get_name(old_state),
                     gst_element_state_get_name(new_state));
+
+          /* The media prerolled, the chains that were plugged work */
+          if (new_state == GST_STATE_PLAYING && data.cache && !autoplug_cache_save(data.cache, &err)) {
+            g_warning("Could not save the autoplug cache: %s", err->message);
+            g_clear_error(&err);
+          }
         }
 
         break;
@@ -113,10 +151,20 @@ int main(int argc, char *argv[]) {
     }
   } while (!terminate);
 
+  if (data.cache) {
+    AutoplugCacheStats stats;
+
+    autoplug_cache_get_stats(data.cache, &stats);
+    g_message("Autoplug cache: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses, %" G_GUINT64_FORMAT
+              " typefinds skipped, %" G_GUINT64_FORMAT " learned",
+              stats.hits, stats.misses, stats.typefind_skipped, stats.learned);
+  }
+
   /* Free resources */
   gst_object_unref(bus);
   gst_element_set_state(data.pipeline, GST_STATE_NULL);
   gst_object_unref(data.pipeline);
+  autoplug_cache_free(data.cache);
 
   return 0;
 }
@@ -153,7 +201,8 @@ static void pad_added_handler(GstElement *src, GstPad *new_pad, CustomData *data
   if (GST_PAD_LINK_FAILED(ret)) {
     g_message("Type is '%' but link failed.", new_pad_type);
   } else {
-    g_message("Link succeeded (type '%s').", new_pad_type);
+    g_message("Link succeeded (type '%s'), %.1f ms after the start.", new_pad_type,
+              (g_get_monotonic_time() - data->start) / 1000.0);
   }
 
 exit:
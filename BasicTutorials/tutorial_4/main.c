@@ -1,27 +1,49 @@
 #include <gst/gst.h>
 
+#include "keyframe_index.h"
+#include "position_reporter.h"
+
+#define REPORT_INTERVAL (100 * GST_MSECOND) // Time between two position reports
+
 /* Structure to contain all out information, so we can pass it around */
 typedef struct _CustomData {
-  GstElement *playbin;   // Out one and only element
-  gboolean playing;      // Are we in the PLAYING state
-  gboolean terminate;    // Sould we terminate execution?
-  gboolean seek_enabled; // Is seeking enabled for this media?
-  gboolean seek_done;    // Have we performed the seek already?
-  gint64 duration;       // How long does this media last, in nanoseconds
+  GstElement *playbin;        // Out one and only element
+  gboolean playing;           // Are we in the PLAYING state
+  gboolean terminate;         // Sould we terminate execution?
+  gboolean seek_enabled;      // Is seeking enabled for this media?
+  gboolean seek_done;         // Have we performed the seek already?
+  gint64 duration;            // How long does this media last, in nanoseconds
+  const gchar *uri;           // What we are playing
+  KeyframeIndex *index;       // Keyframes of the media, NULL until the index thread is done
+  gint cancel_index;          // Set at shutdown to stop the index thread
+  PositionReporter *reporter; // Posts the position on the bus while PLAYING
 } CustomData;
 
 /* Forward definition of the message processing function */
 static void handle_message(CustomData *, GstMessage *);
 
+/* Called for every position report */
+static void handle_position(CustomData *, GstClockTime, GstClockTime);
+
+/* Loads or builds the keyframe index while the media plays */
+static gpointer build_index(CustomData *);
+
 int main(int argc, char *argv[]) {
   CustomData data = {
       .playbin = NULL, .playing = FALSE, .terminate = FALSE, .seek_enabled = FALSE, .duration = GST_CLOCK_TIME_NONE};
   GstBus *bus = NULL;
   GstMessage *msg = NULL;
   GstStateChangeReturn ret = GST_STATE_CHANGE_FAILURE;
+  GThread *index_thread = NULL;
   const gchar *uri = "https://www.freedesktop.org/software/gstreamer-sdk/data/"
                      "media/sintel_trailer-480p.webm";
 
+  /* If a URI was provided, use it instead of the default one */
+  if (argc > 1) {
+    uri = argv[1];
+  }
+  data.uri = uri;
+
   /* Initialize GStreamer */
   gst_init(&argc, &argv);
 
@@ -36,6 +58,9 @@ int main(int argc, char *argv[]) {
   /* Set the URI to play */
   g_object_set(data.playbin, "uri", uri, NULL);
 
+  /* Reports come from the pipeline clock, so nothing has to poll the position */
+  data.reporter = position_reporter_new(data.playbin, REPORT_INTERVAL);
+
   /* Start playing */
   ret = gst_element_set_state(data.playbin, GST_STATE_PLAYING);
   if (ret == GST_STATE_CHANGE_FAILURE) {
@@ -45,58 +70,79 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 
+  /* The index is only needed for the seek, don't delay the playback for it */
+  index_thread = g_thread_new("keyframe-index", (GThreadFunc)build_index, &data);
+
   /* Listen to the bus */
   bus = gst_element_get_bus(data.playbin);
 
   do {
-    msg = gst_bus_timed_pop_filtered(
-        bus, 100 * GST_MSECOND, GST_MESSAGE_STATE_CHANGED | GST_MESSAGE_ERROR | GST_MESSAGE_EOS | GST_MESSAGE_DURATION);
+    /* Every wakeup is a message, the position reports included */
+    msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+                                     GST_MESSAGE_STATE_CHANGED | GST_MESSAGE_ERROR | GST_MESSAGE_EOS |
+                                         GST_MESSAGE_DURATION_CHANGED | GST_MESSAGE_APPLICATION);
 
     /* Parse message */
-    if (msg != NULL) {
-      handle_message(&data, msg);
-    } else {
-      /* We got no message, this means the timeout expired */
-      if (data.playing) {
-        guint64 current = -1;
-
-        /* Query the current position of the stream */
-        if (!gst_element_query_position(data.playbin, GST_FORMAT_TIME, &current)) {
-          g_error("Could not query current position.");
-        }
-
-        /* If we didn't know it yet, query the stream duration */
-        if (!GST_CLOCK_TIME_IS_VALID(data.duration)) {
-          if (!gst_element_query_duration(data.playbin, GST_FORMAT_TIME, &data.duration)) {
-            g_error("Coult not query current duration.");
-          }
-        }
-
-        /* Print current position and total duration */
-        g_message("Position %" GST_TIME_FORMAT " / %" GST_TIME_FORMAT "\r", GST_TIME_ARGS(current),
-                  GST_TIME_ARGS(data.duration));
-
-        /* If seeking is enabled, we have not done yet, and the time is right,
-         * seek */
-        if (data.seek_enabled && !data.seek_done && current > 10 * GST_SECOND) {
-          g_message("\nReaced 10s, performing seek...");
-          gst_element_seek_simple(data.playbin, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT,
-                                  30 * GST_SECOND);
-          data.seek_done = TRUE;
-        }
-      }
-    }
+    handle_message(&data, msg);
   } while (!data.terminate);
 
   /* Free resources */
   gst_object_unref(bus);
+  position_reporter_free(data.reporter);
   gst_element_set_state(data.playbin, GST_STATE_NULL);
   gst_object_unref(data.playbin);
+  g_atomic_int_set(&data.cancel_index, 1);
+  g_thread_join(index_thread);
+  keyframe_index_free(data.index);
+}
+
+static gpointer build_index(CustomData *data) {
+  KeyframeIndex *index;
+  GError *err = NULL;
+
+  index = keyframe_index_get(data->uri, &data->cancel_index, &err);
+  if (!index) {
+    if (!g_atomic_int_get(&data->cancel_index))
+      g_message("No keyframe index, seeks are left to the demuxer: %s", err->message);
+    g_clear_error(&err);
+
+    return NULL;
+  }
+
+  g_message("Keyframe index ready, %u keyframes", keyframe_index_get_n_entries(index));
+  g_atomic_pointer_set(&data->index, index);
+
+  return NULL;
+}
+
+static void handle_position(CustomData *data, GstClockTime current, GstClockTime duration) {
+  data->duration = duration;
+
+  /* Print current position and total duration */
+  g_message("Position %" GST_TIME_FORMAT " / %" GST_TIME_FORMAT "\r", GST_TIME_ARGS(current),
+            GST_TIME_ARGS(data->duration));
+
+  /* If seeking is enabled, we have not done yet, and the time is right,
+   * seek. With the index the target is the keyframe before 30s, so the demuxer doesn't have to look for it. */
+  if (data->seek_enabled && !data->seek_done && current > 10 * GST_SECOND) {
+    g_message("\nReaced 10s, performing seek...");
+    keyframe_index_seek(g_atomic_pointer_get(&data->index), data->playbin, 30 * GST_SECOND, GST_SEEK_FLAG_SNAP_BEFORE);
+    data->seek_done = TRUE;
+  }
 }
 
 static void handle_message(CustomData *data, GstMessage *msg) {
   GError *err;
   gchar *debug_info;
+  GstClockTime position, duration;
+
+  /* The reporter follows the state and duration changes, and tells which messages are its reports */
+  if (position_reporter_handle_message(data->reporter, msg, &position, &duration)) {
+    handle_position(data, position, duration);
+    gst_message_unref(msg);
+
+    return;
+  }
 
   switch (GST_MESSAGE_TYPE(msg)) {
   case GST_MESSAGE_ERROR:
@@ -116,8 +162,8 @@ static void handle_message(CustomData *data, GstMessage *msg) {
 
     break;
 
-  case GST_MESSAGE_DURATION:
-    /* The duration has changed, mark the current one as invalid */
+  case GST_MESSAGE_DURATION_CHANGED:
+    /* The duration has changed, the reporter queries it again for the next report */
     data->duration = GST_CLOCK_TIME_NONE;
     break;
 
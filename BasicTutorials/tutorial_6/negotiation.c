@@ -0,0 +1,130 @@
+#include <gst/gst.h>
+
+#include "caps_profiler.h"
+
+#define DEFAULT_TOP 15 // Pads listed, the ones that took the most time
+
+/* Waits for the end of the preroll, returns FALSE on error */
+static gboolean wait_preroll(GstElement *);
+
+/* Prints the pads that answered caps queries and the totals */
+static void print_stats(GPtrArray *, gint);
+
+int main(int argc, char *argv[]) {
+  GstElement *pipeline;
+  CapsProfiler *profiler;
+  GError *err = NULL;
+  gchar *description = NULL;
+  gboolean memoize = FALSE;
+  gint top = DEFAULT_TOP;
+  GOptionEntry entries[] = {
+      {"pipeline", 'p', 0, G_OPTION_ARG_STRING, &description, "Pipeline to profile, playbin by default", "DESC"},
+      {"memoize", 'm', 0, G_OPTION_ARG_NONE, &memoize, "Answer repeated caps queries on pad templates from a cache",
+       NULL},
+      {"top", 't', 0, G_OPTION_ARG_INT, &top, "Pads listed", "N"},
+      {NULL}};
+  GOptionContext *context;
+  GstClockTime start;
+  GPtrArray *stats;
+  gboolean ret;
+
+  /* Initialize GStreamer and parse the options */
+  context = g_option_context_new("- caps queries of a pipeline while it prerolls");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("Failed to parse options: %s\n", err->message);
+    g_clear_error(&err);
+    g_option_context_free(context);
+
+    return -1;
+  }
+  g_option_context_free(context);
+
+  if (description == NULL)
+    description = g_strdup(
+        "playbin uri=https://www.freedesktop.org/software/gstreamer-sdk/data/media/sintel_trailer-480p.webm");
+
+  /* Build the pipeline */
+  pipeline = gst_parse_launch(description, &err);
+  if (!pipeline) {
+    g_error("Unable to build the pipeline: %s", err->message);
+    g_clear_error(&err);
+
+    return -1;
+  }
+
+  /* Only the READY->PAUSED transition is profiled, where the elements are autoplugged and the caps negotiated */
+  profiler = caps_profiler_new(pipeline, memoize);
+  if (gst_element_set_state(pipeline, GST_STATE_READY) == GST_STATE_CHANGE_FAILURE) {
+    g_printerr("Unable to set the pipeline to the ready state.\n");
+    ret = FALSE;
+  } else {
+    start = gst_util_get_timestamp();
+    caps_profiler_start(profiler);
+    ret = gst_element_set_state(pipeline, GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE && wait_preroll(pipeline);
+    caps_profiler_stop(profiler);
+
+    if (ret)
+      g_print("Prerolled in %.1f ms%s\n", (gst_util_get_timestamp() - start) / 1e6, memoize ? ", with memoize" : "");
+  }
+
+  stats = caps_profiler_get_stats(profiler);
+  print_stats(stats, top);
+  g_ptr_array_unref(stats);
+
+  /* Free resources, the probes go away once the pipeline is stopped */
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  caps_profiler_free(profiler);
+  gst_object_unref(pipeline);
+  g_free(description);
+
+  return ret ? 0 : -1;
+}
+
+static gboolean wait_preroll(GstElement *pipeline) {
+  GstBus *bus = gst_element_get_bus(pipeline);
+  GstMessage *msg;
+  gboolean ret;
+
+  msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_ASYNC_DONE | GST_MESSAGE_ERROR);
+  ret = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ASYNC_DONE;
+  if (!ret) {
+    GError *err;
+
+    gst_message_parse_error(msg, &err, NULL);
+    g_printerr("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
+    g_clear_error(&err);
+  }
+
+  gst_message_unref(msg);
+  gst_object_unref(bus);
+
+  return ret;
+}
+
+static void print_stats(GPtrArray *stats, gint top) {
+  guint64 caps_queries = 0, cache_hits = 0, accept_caps = 0, intersect_work = 0;
+
+  g_print("%-40s %8s %6s %9s %8s %7s %9s %9s\n", "pad", "queries", "cached", "intersect", "accepts", "refused",
+          "caps ms", "accept ms");
+  for (guint i = 0; i < stats->len; i++) {
+    CapsProfilerPadStats *pad = g_ptr_array_index(stats, i);
+
+    caps_queries += pad->caps_queries;
+    cache_hits += pad->cache_hits;
+    accept_caps += pad->accept_caps;
+    intersect_work += pad->intersect_work;
+
+    /* Queries nest, the time of a pad includes the time of the pads it asked */
+    if (i < (guint)top)
+      g_print("%-40s %8" G_GUINT64_FORMAT " %6" G_GUINT64_FORMAT " %9" G_GUINT64_FORMAT " %8" G_GUINT64_FORMAT
+              " %7" G_GUINT64_FORMAT " %9.3f %9.3f\n",
+              pad->name, pad->caps_queries, pad->cache_hits, pad->intersect_work, pad->accept_caps, pad->refused,
+              pad->caps_time / 1e6, pad->accept_time / 1e6);
+  }
+
+  g_print("%u pads: %" G_GUINT64_FORMAT " caps queries (%" G_GUINT64_FORMAT " from the cache), %" G_GUINT64_FORMAT
+          " accept-caps queries, %" G_GUINT64_FORMAT " structure pairs intersected\n",
+          stats->len, caps_queries, cache_hits, accept_caps, intersect_work);
+}
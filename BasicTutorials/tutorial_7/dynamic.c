@@ -0,0 +1,152 @@
+#include <gst/gst.h>
+#include <string.h>
+
+#include "branch_manager.h"
+
+#define DEFAULT_CYCLES 4                // Times each extra branch is added and removed
+#define DEFAULT_PERIOD 2000             // Milliseconds between two changes
+#define REMOVE_TIMEOUT (2 * GST_SECOND) // Longest wait for the EOS of a removed branch
+
+/* Branches that come and go, next to the audio branch that is always there */
+static const gchar *branch_names[] = {"visual", "record"};
+static const gchar *branch_descriptions[] = {
+    "audioconvert ! wavescope shader=0 style=1 ! videoconvert ! autovideosink",
+    "audioconvert ! wavenc ! filesink location=tutorial_7_dynamic.wav"};
+
+/* Structure to contain all our information, so we can pass it to callbacks */
+typedef struct _CustomData {
+  GstElement *pipeline, *tee;
+  BranchManager *manager;
+  guint changes_left; /* Branch additions and removals still to do */
+  guint removing;     /* Removals not finished yet */
+  GMainLoop *main_loop;
+} CustomData;
+
+/* Called every period: adds the next branch if it is not there, removes it otherwise */
+static gboolean change_branches(CustomData *);
+
+/* Called by the branch manager once a branch is gone */
+static void branch_removed(BranchManager *, const gchar *, gboolean, CustomData *);
+
+/* This function is called when an error message is posted on the bus */
+static void error_cb(GstBus *, GstMessage *, CustomData *);
+
+int main(int argc, char *argv[]) {
+  CustomData data;
+  GError *err = NULL;
+  gint cycles = DEFAULT_CYCLES, period = DEFAULT_PERIOD;
+  GOptionEntry entries[] = {
+      {"cycles", 'c', 0, G_OPTION_ARG_INT, &cycles, "Times each extra branch is added and removed", "N"},
+      {"period", 'p', 0, G_OPTION_ARG_INT, &period, "Milliseconds between two changes", "MS"},
+      {NULL}};
+  GOptionContext *context;
+  BranchManagerStats stats;
+  GstBus *bus;
+
+  /* Initialize GStreamer and parse the options */
+  context = g_option_context_new("- tee branches added and removed while playing");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("Failed to parse options: %s\n", err->message);
+    g_clear_error(&err);
+    g_option_context_free(context);
+
+    return -1;
+  }
+  g_option_context_free(context);
+
+  if (cycles < 1 || period < 1) {
+    g_printerr("Cycles and period must be positive.\n");
+    return -1;
+  }
+
+  /* Initialize custom data structure */
+  memset(&data, 0, sizeof(data));
+  data.changes_left = cycles * 2 * G_N_ELEMENTS(branch_names);
+
+  /* Build the pipeline with the branch that stays, the others are added later */
+  data.pipeline = gst_parse_launch("audiotestsrc is-live=true freq=215 ! tee name=tee allow-not-linked=true "
+                                   "tee. ! queue ! audioconvert ! audioresample ! autoaudiosink",
+                                   &err);
+  if (!data.pipeline) {
+    g_error("Unable to build the pipeline: %s", err->message);
+    g_clear_error(&err);
+
+    return -1;
+  }
+  data.tee = gst_bin_get_by_name(GST_BIN(data.pipeline), "tee");
+  data.main_loop = g_main_loop_new(NULL, FALSE);
+  data.manager = branch_manager_new(data.pipeline, data.tee, REMOVE_TIMEOUT);
+
+  bus = gst_element_get_bus(data.pipeline);
+  gst_bus_add_signal_watch(bus);
+  g_signal_connect(G_OBJECT(bus), "message::error", (GCallback)error_cb, &data);
+  gst_object_unref(bus);
+
+  /* Start playing the pipeline, and change the branches while it plays */
+  gst_element_set_state(data.pipeline, GST_STATE_PLAYING);
+  g_timeout_add(period / G_N_ELEMENTS(branch_names), (GSourceFunc)change_branches, &data);
+  g_main_loop_run(data.main_loop);
+
+  branch_manager_get_stats(data.manager, &stats);
+  g_print("%" G_GUINT64_FORMAT " branches added (longest %.1f ms), %" G_GUINT64_FORMAT
+          " removed (longest %.1f ms), %" G_GUINT64_FORMAT " timeouts\n",
+          stats.added, stats.max_add_time / 1000.0, stats.removed, stats.max_remove_time / 1000.0, stats.timeouts);
+
+  /* Free resources */
+  branch_manager_free(data.manager);
+  gst_element_set_state(data.pipeline, GST_STATE_NULL);
+  gst_object_unref(data.tee);
+  gst_object_unref(data.pipeline);
+  g_main_loop_unref(data.main_loop);
+
+  return 0;
+}
+
+static gboolean change_branches(CustomData *data) {
+  guint index = data->changes_left % G_N_ELEMENTS(branch_names);
+  const gchar *name = branch_names[index];
+  GError *err = NULL;
+
+  if (data->changes_left == 0) {
+    /* Quit once the last removals are done */
+    if (data->removing == 0)
+      g_main_loop_quit(data->main_loop);
+    return data->removing > 0;
+  }
+  data->changes_left--;
+
+  if (branch_manager_has_branch(data->manager, name)) {
+    if (branch_manager_remove(data->manager, name, (BranchRemovedFunc)branch_removed, data)) {
+      data->removing++;
+      g_print("Removing branch %s\n", name);
+    }
+  } else if (branch_manager_add(data->manager, name, branch_descriptions[index], &err)) {
+    g_print("Added branch %s\n", name);
+  } else {
+    g_printerr("Could not add branch %s: %s\n", name, err->message);
+    g_clear_error(&err);
+  }
+
+  return TRUE;
+}
+
+static void branch_removed(BranchManager *manager, const gchar *name, gboolean drained, CustomData *data) {
+  data->removing--;
+  g_print("Branch %s is gone%s\n", name, drained ? "" : ", it timed out before the EOS went through");
+}
+
+static void error_cb(GstBus *bus, GstMessage *msg, CustomData *data) {
+  GError *err;
+  gchar *debug_info;
+
+  /* Print error details on the screen */
+  gst_message_parse_error(msg, &err, &debug_info);
+  g_printerr("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
+  g_printerr("Debugging information: %s\n", debug_info ? debug_info : "none");
+  g_clear_error(&err);
+  g_free(debug_info);
+
+  g_main_loop_quit(data->main_loop);
+}
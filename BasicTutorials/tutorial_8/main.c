@@ -1,9 +1,30 @@
+#include <gst/app/gstappsink.h>
 #include <gst/audio/audio.h>
 #include <gst/gst.h>
 #include <string.h>
 
-#define CHUNK_SIZE 1024   // Amount of bytes we are sending in each buffer
-#define SAMPLE_RATE 44100 // Samples per second we are sending
+#include "producer_pool.h"
+#include "queue_tuner.h"
+#include "spsc_ring.h"
+#include "waveform.h"
+
+#define DEFAULT_CHUNK_SIZE 1024 // Amount of bytes we are sending in each buffer
+#define DEFAULT_MAX_BYTES 65536 // Bytes appsrc queues before it has enough data
+#define DEFAULT_POOL_EXTRA 32   // Pooled buffers on top of what appsrc queues, for the ones travelling downstream
+#define DEFAULT_RING_SIZE 64    // Samples waiting for each consumer worker
+#define MAX_CONSUMERS 64        // Upper limit of --consumers
+#define SAMPLE_RATE 44100       // Samples per second we are sending
+
+/* Period of the queue tuner with --tune-queues */
+#define TUNE_INTERVAL (500 * GST_MSECOND)
+
+/* A thread consuming appsink samples from its own ring */
+typedef struct _ConsumerWorker {
+  SpscRing *ring;
+  GThread *thread;
+  guint64 consumed; /* Samples handled */
+  gint peak;        /* Loudest sample seen, the "work" of this example */
+} ConsumerWorker;
 
 /* Structure to contain all our information, so we can pass it to callbacks */
 typedef struct _CustomData {
@@ -12,19 +33,41 @@ typedef struct _CustomData {
   GstElement *app_queue, *app_sink;
 
   guint64 num_samples; /* Number of samples generated so far (for timestamp generation) */
-  gfloat a, b, c, d;   /* For waveform generation */
+  Waveform wf;         /* For waveform generation */
+
+  guint chunk_size;    /* Bytes in each buffer */
+  GstBufferPool *pool; /* Recycles the buffers, sized from the appsrc max-bytes */
 
   guint sourceid; /* To control the GSource */
 
+  gboolean producer_thread; /* Feed appsrc from a thread of our own instead of the main loop */
+  GThread *producer;
+  gint stopping; /* Set when the producer thread has to leave, accessed atomically */
+
+  guint n_consumers;       /* Worker threads taking the appsink samples, 0 to handle them in the new-sample signal */
+  gboolean ring_block;     /* Wait for room when a ring is full instead of dropping the sample */
+  ConsumerWorker *workers; /* Only the appsink streaming thread pushes into their rings */
+  guint next_worker;       /* Round robin over the workers, only used by the streaming thread */
+
+  QueueTuner *queue_tuner; /* Sizes the branch queues, NULL without --tune-queues */
+
   GMainLoop *main_loop; /* GLib's Main Loop */
 } CustomData;
 
-/* This method is called by the idle GSource in the mainloop, to feed CHUNK_SIZE bytes into appsrc.
+/* Create the next chunk_size bytes of the waveform, with timestamps */
+static GstBuffer *generate_buffer(CustomData *);
+
+/* This method is called by the idle GSource in the mainloop, to feed chunk_size bytes into appsrc.
  * The idle handler is added to the mainloop when appsrc requests us to start sending data (need-data signal)
  * and is removed when appsrc has enough data (enough-data signal).
  */
 static gboolean push_data(CustomData *);
 
+/* Body of the producer thread. appsrc is in blocking mode, so push-buffer waits while max-bytes are queued and the
+ * thread produces exactly as fast as the pipeline consumes. It returns when the push fails, which happens at the
+ * latest when the pipeline goes to NULL and appsrc stops flushing. */
+static gpointer produce_data(CustomData *);
+
 /* This signal callback triggers when appsrc needs data. Here, we add an idle handler
  * to the mainloop to start pushing data into the appsrc */
 static void start_feed(GstElement *, guint, CustomData *);
@@ -36,6 +79,16 @@ static void stop_feed(GstElement *, CustomData *);
 /* The appsink has received abuffer */
 static GstFlowReturn new_sample(GstElement *, CustomData *);
 
+/* The appsink has received a buffer, consumer mode. Called directly by appsink without signal marshalling, it hands
+ * the sample reference to the next worker through its ring. */
+static GstFlowReturn new_sample_ring(GstAppSink *, gpointer);
+
+/* Body of a consumer worker */
+static gpointer consume_samples(gpointer);
+
+/* Print what the queue tuner did with the branch queues */
+static void print_queue_tuning(CustomData *);
+
 /* This function is called when an error message is posted on the bus */
 static void error_cb(GstBus *, GstMessage *, CustomData *);
 
@@ -46,14 +99,54 @@ int main(int argc, char *argv[]) {
   GstAudioInfo info;
   GstCaps *audio_caps;
   GstBus *bus;
+  gint chunk_size = DEFAULT_CHUNK_SIZE, max_bytes = DEFAULT_MAX_BYTES, pool_extra = DEFAULT_POOL_EXTRA;
+  gint n_consumers = 0, ring_size = DEFAULT_RING_SIZE;
+  gboolean producer_thread = FALSE, ring_block = FALSE, tune_queues = FALSE;
+  GOptionEntry entries[] = {
+      {"producer-thread", 'p', 0, G_OPTION_ARG_NONE, &producer_thread,
+       "Feed appsrc from a dedicated thread with blocking push-buffer", NULL},
+      {"chunk-size", 'c', 0, G_OPTION_ARG_INT, &chunk_size, "Bytes in each buffer (even)", "BYTES"},
+      {"max-bytes", 'm', 0, G_OPTION_ARG_INT, &max_bytes, "Bytes queued in appsrc before it has enough", "BYTES"},
+      {"pool-extra", 'e', 0, G_OPTION_ARG_INT, &pool_extra, "Pooled buffers beyond what appsrc can queue", "N"},
+      {"consumers", 'w', 0, G_OPTION_ARG_INT, &n_consumers, "Worker threads consuming the appsink samples", "N"},
+      {"ring-size", 'r', 0, G_OPTION_ARG_INT, &ring_size, "Samples queued for each worker", "N"},
+      {"ring-block", 'b', 0, G_OPTION_ARG_NONE, &ring_block, "Wait when a worker is behind instead of dropping",
+       NULL},
+      {"tune-queues", 'q', 0, G_OPTION_ARG_NONE, &tune_queues, "Shrink the branch queues to the levels they need",
+       NULL},
+      {NULL}};
+  GOptionContext *context;
+  GError *err = NULL;
 
   /* Initialize custom data structure */
   memset(&data, 0, sizeof(data));
-  data.b = 1; // For waveform generator
-  data.d = 1;
+  waveform_init(&data.wf);
 
-  /* Initialize GStreamer */
-  gst_init(&argc, &argv);
+  /* Initialize GStreamer and parse the options */
+  context = g_option_context_new("- appsrc/appsink tutorial");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("Failed to parse options: %s\n", err->message);
+    g_clear_error(&err);
+    g_option_context_free(context);
+
+    return -1;
+  }
+  g_option_context_free(context);
+
+  if (chunk_size < 2 || chunk_size % 2 != 0 || max_bytes < chunk_size || pool_extra < 0) {
+    g_printerr("The chunk size must be even and positive, max-bytes at least one chunk and pool-extra not negative.\n");
+    return -1;
+  }
+  if (n_consumers < 0 || n_consumers > MAX_CONSUMERS || ring_size < 1) {
+    g_printerr("Use 0 to %d consumers and a positive ring size.\n", MAX_CONSUMERS);
+    return -1;
+  }
+  data.chunk_size = chunk_size;
+  data.producer_thread = producer_thread;
+  data.n_consumers = n_consumers;
+  data.ring_block = ring_block;
 
   /* Create the elements */
   data.app_source = gst_element_factory_make("appsrc", "audio_source");
@@ -86,13 +179,37 @@ int main(int argc, char *argv[]) {
   /* Configure appsrc */
   gst_audio_info_set_format(&info, GST_AUDIO_FORMAT_S16, SAMPLE_RATE, 1, NULL);
   audio_caps = gst_audio_info_to_caps(&info);
-  g_object_set(data.app_source, "caps", audio_caps, "format", GST_FORMAT_TIME, NULL);
-  g_signal_connect(data.app_source, "need-data", G_CALLBACK(start_feed), &data);
-  g_signal_connect(data.app_source, "enough-data", G_CALLBACK(stop_feed), &data);
+  g_object_set(data.app_source, "caps", audio_caps, "format", GST_FORMAT_TIME, "max-bytes", (guint64)max_bytes, NULL);
+  if (data.producer_thread) {
+    /* backpressure comes from push-buffer blocking, the signals are not needed */
+    g_object_set(data.app_source, "block", TRUE, NULL);
+  } else {
+    g_signal_connect(data.app_source, "need-data", G_CALLBACK(start_feed), &data);
+    g_signal_connect(data.app_source, "enough-data", G_CALLBACK(stop_feed), &data);
+  }
+
+  /* The buffers come from a pool, so once it has warmed up pushing allocates nothing */
+  data.pool = producer_pool_new(data.app_source, data.chunk_size, pool_extra);
+  if (!data.pool) {
+    g_printerr("Could not create the buffer pool.\n");
+    return -1;
+  }
 
   /* Configure appsink */
-  g_object_set(data.app_sink, "emit-signals", TRUE, "caps", audio_caps, NULL);
-  g_signal_connect(data.app_sink, "new-sample", G_CALLBACK(new_sample), &data);
+  if (data.n_consumers > 0) {
+    GstAppSinkCallbacks callbacks = {NULL};
+
+    data.workers = g_new0(ConsumerWorker, data.n_consumers);
+    for (guint i = 0; i < data.n_consumers; i++)
+      data.workers[i].ring = spsc_ring_new(ring_size);
+
+    callbacks.new_sample = new_sample_ring;
+    gst_app_sink_set_callbacks(GST_APP_SINK(data.app_sink), &callbacks, &data, NULL);
+    g_object_set(data.app_sink, "caps", audio_caps, NULL);
+  } else {
+    g_object_set(data.app_sink, "emit-signals", TRUE, "caps", audio_caps, NULL);
+    g_signal_connect(data.app_sink, "new-sample", G_CALLBACK(new_sample), &data);
+  }
   gst_caps_unref(audio_caps);
 
   /* Link all elements that can be automatically linked because they have "Always" pads */
@@ -143,10 +260,54 @@ int main(int argc, char *argv[]) {
   /* Start playing the pipeline */
   gst_element_set_state(data.pipeline, GST_STATE_PLAYING);
 
+  for (guint i = 0; i < data.n_consumers; i++)
+    data.workers[i].thread = g_thread_new("consumer", consume_samples, &data.workers[i]);
+
+  if (data.producer_thread) {
+    g_message("Feeding from a producer thread, %u bytes per buffer", data.chunk_size);
+    data.producer = g_thread_new("producer", (GThreadFunc)produce_data, &data);
+  }
+
+  /* Start from the default limits of the queues and let the tuner bring them down */
+  if (tune_queues) {
+    data.queue_tuner = queue_tuner_new(TUNE_INTERVAL);
+    queue_tuner_add(data.queue_tuner, data.audio_queue);
+    queue_tuner_add(data.queue_tuner, data.video_queue);
+    queue_tuner_add(data.queue_tuner, data.app_queue);
+  }
+
   /* Create a GLib Main Loop and set it to run */
   data.main_loop = g_main_loop_new(NULL, FALSE);
   g_main_loop_run(data.main_loop);
 
+  if (data.queue_tuner)
+    print_queue_tuning(&data);
+
+  /* Going to NULL wakes up a producer blocked in push-buffer, so it can only be joined afterwards */
+  g_atomic_int_set(&data.stopping, TRUE);
+  gst_element_set_state(data.pipeline, GST_STATE_NULL);
+  if (data.producer)
+    g_thread_join(data.producer);
+  producer_pool_free(data.pool);
+
+  /* The streaming threads are stopped, none of them is in an overrun or underrun handler anymore */
+  queue_tuner_free(data.queue_tuner);
+
+  /* No more samples come from appsink, let the workers drain their rings and leave */
+  for (guint i = 0; i < data.n_consumers; i++) {
+    ConsumerWorker *worker = &data.workers[i];
+    SpscRingStats stats;
+
+    spsc_ring_close(worker->ring);
+    g_thread_join(worker->thread);
+    spsc_ring_get_stats(worker->ring, &stats);
+    g_print("Worker %u: %" G_GUINT64_FORMAT " consumed (peak %d), %" G_GUINT64_FORMAT " dropped, %" G_GUINT64_FORMAT
+            " times full, at most %u of %u queued\n",
+            i, worker->consumed, worker->peak, stats.dropped, stats.backpressure, stats.max_occupancy, stats.capacity);
+    spsc_ring_free(worker->ring, (GDestroyNotify)gst_sample_unref);
+  }
+  g_free(data.workers);
+
   /* Release the request pads from the Tee, and unref them */
   gst_element_release_request_pad(data.tee, tee_audio_pad);
   gst_element_release_request_pad(data.tee, tee_video_pad);
@@ -156,47 +317,43 @@ int main(int argc, char *argv[]) {
   gst_object_unref(tee_app_pad);
 
   /* Free resources */
-  gst_element_set_state(data.pipeline, GST_STATE_NULL);
   gst_object_unref(data.pipeline);
+  g_main_loop_unref(data.main_loop);
 
   return 0;
 }
 
-static gboolean push_data(CustomData *data) {
+static GstBuffer *generate_buffer(CustomData *data) {
   GstBuffer *buffer;
   GstMapInfo map;
-  gint16 *raw;
-  gfloat freq;
-  gint num_samples = CHUNK_SIZE / 2; // Because each sample is 16 bits
-  GstFlowReturn ret = GST_FLOW_ERROR;
+  gint num_samples = data->chunk_size / 2; // Because each sample is 16 bits
 
-  /* Create a new empty buffer */
-  buffer = gst_buffer_new_and_alloc(CHUNK_SIZE);
-
-  /* Set its timestamp and duration */
-  GST_BUFFER_TIMESTAMP(buffer) = gst_util_uint64_scale(data->num_samples, GST_SECOND, SAMPLE_RATE);
-  GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale(num_samples, GST_SECOND, SAMPLE_RATE);
+  /* Take a recycled buffer with its timestamp and duration set */
+  buffer = producer_pool_acquire(data->pool, gst_util_uint64_scale(data->num_samples, GST_SECOND, SAMPLE_RATE),
+                                 gst_util_uint64_scale(num_samples, GST_SECOND, SAMPLE_RATE));
+  if (buffer == NULL)
+    return NULL;
 
   /* Generate some psychodelic waveforms */
   gst_buffer_map(buffer, &map, GST_MAP_WRITE);
-  raw = (gint16 *)map.data;
-  data->c += data->d;
-  data->d -= data->c / 1000;
-  freq = 1100 + 1000 * data->d;
-
-  for (gint i = 0; i < num_samples; i++) {
-    data->a += data->b;
-    data->b -= data->a / freq;
-    raw[i] = (gint16)(500 * data->a);
-  }
-
+  waveform_fill(&data->wf, (gint16 *)map.data, num_samples);
   gst_buffer_unmap(buffer, &map);
   data->num_samples += num_samples;
 
+  return buffer;
+}
+
+static gboolean push_data(CustomData *data) {
+  GstBuffer *buffer = generate_buffer(data);
+  GstFlowReturn ret = GST_FLOW_ERROR;
+
+  if (buffer == NULL)
+    return FALSE;
+
   /* Push the buffer into appsrc */
   g_signal_emit_by_name(data->app_source, "push-buffer", buffer, &ret);
 
-  /* Free the buffer now that we are done with it */
+  /* Drop our reference, the buffer goes back to the pool once the pipeline is done with it */
   gst_buffer_unref(buffer);
 
   if (ret != GST_FLOW_OK) {
@@ -207,6 +364,26 @@ static gboolean push_data(CustomData *data) {
   return TRUE;
 }
 
+static gpointer produce_data(CustomData *data) {
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  while (ret == GST_FLOW_OK && !g_atomic_int_get(&data->stopping)) {
+    GstBuffer *buffer = generate_buffer(data);
+
+    if (buffer == NULL)
+      break;
+
+    /* Blocks while appsrc holds max-bytes */
+    g_signal_emit_by_name(data->app_source, "push-buffer", buffer, &ret);
+    gst_buffer_unref(buffer);
+  }
+
+  if (ret != GST_FLOW_OK && ret != GST_FLOW_FLUSHING)
+    g_message("Producer stopped: %s", gst_flow_get_name(ret));
+
+  return NULL;
+}
+
 static void start_feed(GstElement *source, guint size, CustomData *data) {
   if (data->sourceid == 0) {
     g_print("\n");
@@ -240,6 +417,64 @@ static GstFlowReturn new_sample(GstElement *sink, CustomData *data) {
   return ret;
 }
 
+static GstFlowReturn new_sample_ring(GstAppSink *sink, gpointer user_data) {
+  CustomData *data = user_data;
+  GstSample *sample;
+  ConsumerWorker *worker;
+
+  sample = gst_app_sink_pull_sample(sink);
+  if (sample == NULL)
+    return GST_FLOW_ERROR;
+
+  /* The reference is handed over as is, the data is not copied. A refused sample is counted as dropped by the ring. */
+  worker = &data->workers[data->next_worker++ % data->n_consumers];
+  if (!spsc_ring_push(worker->ring, sample, data->ring_block))
+    gst_sample_unref(sample);
+
+  return GST_FLOW_OK;
+}
+
+static gpointer consume_samples(gpointer user_data) {
+  ConsumerWorker *worker = user_data;
+  GstSample *sample;
+
+  while ((sample = spsc_ring_pop_wait(worker->ring)) != NULL) {
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    GstMapInfo map;
+
+    if (buffer && gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+      const gint16 *raw = (const gint16 *)map.data;
+
+      for (gsize i = 0; i < map.size / 2; i++)
+        worker->peak = MAX(worker->peak, ABS(raw[i]));
+      gst_buffer_unmap(buffer, &map);
+    }
+
+    worker->consumed++;
+    gst_sample_unref(sample);
+  }
+
+  return NULL;
+}
+
+static void print_queue_tuning(CustomData *data) {
+  GstElement *queues[] = {data->audio_queue, data->video_queue, data->app_queue};
+
+  for (guint i = 0; i < G_N_ELEMENTS(queues); i++) {
+    QueueTunerStats stats;
+
+    if (!queue_tuner_get_stats(data->queue_tuner, queues[i], &stats))
+      continue;
+
+    g_print("%s: %u buffers, %u bytes, %" GST_TIME_FORMAT " -> %u buffers, %u bytes, %" GST_TIME_FORMAT
+            " (peak %u bytes, %" G_GUINT64_FORMAT " overruns, %" G_GUINT64_FORMAT " underruns)\n",
+            GST_ELEMENT_NAME(queues[i]), stats.initial.buffers, stats.initial.bytes, GST_TIME_ARGS(stats.initial.time),
+            stats.limits.buffers, stats.limits.bytes, GST_TIME_ARGS(stats.limits.time), stats.peak.bytes,
+            stats.overruns, stats.underruns);
+  }
+  g_print("Queue limits lowered by %" G_GUINT64_FORMAT " bytes\n", queue_tuner_get_bytes_saved(data->queue_tuner));
+}
+
 static void error_cb(GstBus *bus, GstMessage *msg, CustomData *data) {
   GError *err;
   gchar *debug_info;
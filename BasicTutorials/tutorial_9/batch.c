@@ -0,0 +1,469 @@
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+#include <gst/pbutils/pbutils.h>
+#include <string.h>
+
+#include "discoverer_record.h"
+
+#define DEFAULT_TIMEOUT 5          // Seconds the discoverer spends on one file at most
+#define CACHE_SAVE_INTERVAL 1000   // New results between two saves of the cache
+
+/* What we keep of a discovered file */
+typedef struct _BatchResult {
+  GstDiscovererResult result;
+  GstClockTime duration;
+  gboolean seekable;
+  guint n_video, n_audio, n_subtitles;
+  gchar *container; /* Description of the top level stream, NULL if unknown */
+  GVariant *record; /* Payload of the binary record, see discoverer_record_variant_new() */
+} BatchResult;
+
+/* One file (or URI) to discover */
+typedef struct _BatchJob {
+  gchar *uri;
+  gchar *path;   /* Local file, NULL for remote URIs which are not cached */
+  gint64 mtime;  /* Cache key together with path and size */
+  guint64 size;
+} BatchJob;
+
+/* Structure to contain all our information, so we can pass it around */
+typedef struct _CustomData {
+  GAsyncQueue *discoverers;        /* Idle discoverers, a worker takes one for each file */
+  DiscovererRecordWriter *records; /* Binary records of every file, NULL if not asked for */
+
+  GMutex lock; /* Protects everything below */
+  GKeyFile *cache;
+  gchar *cache_file;
+  guint unsaved;
+  guint n_probed, n_cached, n_failed;
+} CustomData;
+
+/* Turn a command line argument or a line of a list file into a job */
+static BatchJob *batch_job_new(const gchar *);
+static void batch_job_free(BatchJob *);
+
+/* Collect jobs from a directory (all regular files in it) or a list file (one path or URI per line) */
+static void add_directory(GPtrArray *, const gchar *, gboolean);
+static void add_list_file(GPtrArray *, const gchar *);
+
+/* Look up and store results in the cache, keyed by path, mtime and size */
+static gboolean cache_lookup(CustomData *, BatchJob *, BatchResult *);
+static void cache_store(CustomData *, BatchJob *, BatchResult *);
+static void cache_save(CustomData *);
+
+/* Keep what we need of a GstDiscovererInfo */
+static void result_from_info(GstDiscovererInfo *, BatchResult *);
+
+/* Worker of the thread pool, discovers one job with one of the idle discoverers */
+static void discover_job(gpointer, gpointer);
+
+int main(int argc, char *argv[]) {
+  CustomData data;
+  GPtrArray *jobs;
+  GThreadPool *pool;
+  GError *err = NULL;
+  gint n_jobs = g_get_num_processors(), timeout = DEFAULT_TIMEOUT;
+  gboolean recursive = FALSE;
+  gchar *cache_file = NULL, *cache_dir, *records_file = NULL;
+  GOptionEntry entries[] = {
+      {"jobs", 'j', 0, G_OPTION_ARG_INT, &n_jobs, "Files discovered in parallel", "N"},
+      {"timeout", 't', 0, G_OPTION_ARG_INT, &timeout, "Seconds spent on one file at most", "SECONDS"},
+      {"recursive", 'r', 0, G_OPTION_ARG_NONE, &recursive, "Descend into subdirectories", NULL},
+      {"cache", 'c', 0, G_OPTION_ARG_FILENAME, &cache_file, "Result cache, in the user cache directory by default",
+       "FILE"},
+      {"records", 'o', 0, G_OPTION_ARG_FILENAME, &records_file,
+       "Write binary records of all files for tutorial_9_query", "FILE"},
+      {NULL}};
+  GOptionContext *context;
+
+  /* Initialize custom data structure */
+  memset(&data, 0, sizeof(data));
+  g_mutex_init(&data.lock);
+
+  /* Initialize GStreamer and parse the options */
+  context = g_option_context_new("<DIRECTORY | LIST FILE>... - discover many media files in parallel");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("Failed to parse options: %s\n", err->message);
+    g_clear_error(&err);
+    g_option_context_free(context);
+
+    return -1;
+  }
+  g_option_context_free(context);
+
+  if (argc < 2 || n_jobs < 1 || timeout < 1) {
+    g_printerr("Give at least one directory or list file, and positive jobs and timeout.\n");
+    return -1;
+  }
+
+  /* Collect the work */
+  jobs = g_ptr_array_new();
+  for (gint i = 1; i < argc; i++) {
+    if (g_file_test(argv[i], G_FILE_TEST_IS_DIR))
+      add_directory(jobs, argv[i], recursive);
+    else
+      add_list_file(jobs, argv[i]);
+  }
+  g_message("%u files to discover with %d discoverers", jobs->len, n_jobs);
+
+  /* Load the cache */
+  if (cache_file == NULL) {
+    cache_dir = g_build_filename(g_get_user_cache_dir(), "gstreamer-tutorial", NULL);
+    g_mkdir_with_parents(cache_dir, 0755);
+    cache_file = g_build_filename(cache_dir, "discoverer.cache", NULL);
+    g_free(cache_dir);
+  }
+  data.cache_file = cache_file;
+  data.cache = g_key_file_new();
+  if (!g_key_file_load_from_file(data.cache, data.cache_file, G_KEY_FILE_NONE, &err)) {
+    if (!g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+      g_printerr("Ignoring the cache %s: %s\n", data.cache_file, err->message);
+    g_clear_error(&err);
+  }
+
+  if (records_file)
+    data.records = discoverer_record_writer_new();
+
+  /* One synchronous discoverer per worker, handed around through the queue */
+  data.discoverers = g_async_queue_new_full(g_object_unref);
+  for (gint i = 0; i < n_jobs; i++) {
+    GstDiscoverer *discoverer = gst_discoverer_new(timeout * GST_SECOND, &err);
+
+    if (!discoverer) {
+      g_printerr("Error creating discoverer instance: %s\n", err->message);
+      g_clear_error(&err);
+
+      return -1;
+    }
+    g_async_queue_push(data.discoverers, discoverer);
+  }
+
+  /* Run the jobs and wait for all of them */
+  pool = g_thread_pool_new(discover_job, &data, n_jobs, FALSE, NULL);
+  for (guint i = 0; i < jobs->len; i++)
+    g_thread_pool_push(pool, g_ptr_array_index(jobs, i), NULL);
+  g_thread_pool_free(pool, FALSE, TRUE);
+
+  cache_save(&data);
+  if (data.records) {
+    if (!discoverer_record_writer_save(data.records, records_file, &err)) {
+      g_printerr("Could not write the records: %s\n", err->message);
+      g_clear_error(&err);
+    }
+    discoverer_record_writer_free(data.records);
+    g_free(records_file);
+  }
+  g_print("Finished discovering: %u probed, %u from the cache, %u failed\n", data.n_probed, data.n_cached,
+          data.n_failed);
+
+  /* Free resources */
+  g_ptr_array_free(jobs, TRUE);
+  g_async_queue_unref(data.discoverers);
+  g_key_file_free(data.cache);
+  g_free(data.cache_file);
+  g_mutex_clear(&data.lock);
+
+  return 0;
+}
+
+static BatchJob *batch_job_new(const gchar *location) {
+  BatchJob *job = g_new0(BatchJob, 1);
+  GStatBuf st;
+
+  if (gst_uri_is_valid(location)) {
+    job->uri = g_strdup(location);
+    job->path = g_filename_from_uri(location, NULL, NULL);
+  } else {
+    if (g_path_is_absolute(location)) {
+      job->path = g_strdup(location);
+    } else {
+      gchar *cwd = g_get_current_dir();
+
+      job->path = g_build_filename(cwd, location, NULL);
+      g_free(cwd);
+    }
+    job->uri = gst_filename_to_uri(job->path, NULL);
+  }
+
+  if (job->path && g_stat(job->path, &st) == 0) {
+    job->mtime = st.st_mtime;
+    job->size = st.st_size;
+  } else {
+    /* Nothing to key the cache with */
+    g_clear_pointer(&job->path, g_free);
+  }
+
+  if (job->uri == NULL) {
+    batch_job_free(job);
+    return NULL;
+  }
+
+  return job;
+}
+
+static void batch_job_free(BatchJob *job) {
+  g_free(job->uri);
+  g_free(job->path);
+  g_free(job);
+}
+
+static void add_directory(GPtrArray *jobs, const gchar *dirname, gboolean recursive) {
+  GDir *dir;
+  const gchar *name;
+  GError *err = NULL;
+
+  dir = g_dir_open(dirname, 0, &err);
+  if (!dir) {
+    g_printerr("Cannot read %s: %s\n", dirname, err->message);
+    g_clear_error(&err);
+    return;
+  }
+
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    gchar *path = g_build_filename(dirname, name, NULL);
+
+    if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+      if (recursive)
+        add_directory(jobs, path, recursive);
+    } else if (g_file_test(path, G_FILE_TEST_IS_REGULAR)) {
+      BatchJob *job = batch_job_new(path);
+
+      if (job)
+        g_ptr_array_add(jobs, job);
+    }
+
+    g_free(path);
+  }
+
+  g_dir_close(dir);
+}
+
+static void add_list_file(GPtrArray *jobs, const gchar *filename) {
+  gchar *contents, **lines;
+  GError *err = NULL;
+
+  if (!g_file_get_contents(filename, &contents, NULL, &err)) {
+    g_printerr("Cannot read %s: %s\n", filename, err->message);
+    g_clear_error(&err);
+    return;
+  }
+
+  lines = g_strsplit(contents, "\n", -1);
+  for (gchar **line = lines; *line; line++) {
+    BatchJob *job;
+
+    g_strstrip(*line);
+    if (**line == '\0' || **line == '#')
+      continue;
+
+    job = batch_job_new(*line);
+    if (job)
+      g_ptr_array_add(jobs, job);
+    else
+      g_printerr("Skipping '%s'\n", *line);
+  }
+
+  g_strfreev(lines);
+  g_free(contents);
+}
+
+/* Paths may hold characters a key file group name can't, the group is named after their checksum */
+static gchar *cache_group(BatchJob *job) {
+  return g_compute_checksum_for_string(G_CHECKSUM_SHA1, job->path, -1);
+}
+
+static gboolean cache_lookup(CustomData *data, BatchJob *job, BatchResult *result) {
+  gboolean hit = FALSE;
+  gchar *group, *path;
+
+  if (job->path == NULL)
+    return FALSE;
+
+  group = cache_group(job);
+  g_mutex_lock(&data->lock);
+  path = g_key_file_get_string(data->cache, group, "path", NULL);
+  /* Caches of older versions may still hold failures, they are probed again */
+  if (g_strcmp0(path, job->path) == 0 && g_key_file_get_int64(data->cache, group, "mtime", NULL) == job->mtime &&
+      g_key_file_get_uint64(data->cache, group, "size", NULL) == job->size &&
+      g_key_file_get_integer(data->cache, group, "result", NULL) == GST_DISCOVERER_OK) {
+    gchar *record = g_key_file_get_string(data->cache, group, "record", NULL);
+
+    if (record) {
+      result->record = g_variant_parse(G_VARIANT_TYPE(DISCOVERER_RECORD_VARIANT_TYPE), record, NULL, NULL, NULL);
+      g_free(record);
+    }
+    /* Entries without a record (or with a broken one) can't fill the records file */
+    hit = result->record != NULL || data->records == NULL;
+  }
+  if (hit) {
+    result->result = g_key_file_get_integer(data->cache, group, "result", NULL);
+    result->duration = g_key_file_get_uint64(data->cache, group, "duration", NULL);
+    result->seekable = g_key_file_get_boolean(data->cache, group, "seekable", NULL);
+    result->n_video = g_key_file_get_integer(data->cache, group, "video", NULL);
+    result->n_audio = g_key_file_get_integer(data->cache, group, "audio", NULL);
+    result->n_subtitles = g_key_file_get_integer(data->cache, group, "subtitles", NULL);
+    result->container = g_key_file_get_string(data->cache, group, "container", NULL);
+  } else {
+    g_clear_pointer(&result->record, g_variant_unref);
+  }
+  g_mutex_unlock(&data->lock);
+  g_free(path);
+  g_free(group);
+
+  return hit;
+}
+
+static void cache_store(CustomData *data, BatchJob *job, BatchResult *result) {
+  gchar *group;
+
+  if (job->path == NULL)
+    return;
+
+  group = cache_group(job);
+  g_mutex_lock(&data->lock);
+
+  /* Failures are not kept: a timeout or a busy discoverer may go away the next time, and missing plugins or a broken
+   * pipeline too once the registry changes. Whatever an older version of the file left is dropped as well. */
+  if (result->result != GST_DISCOVERER_OK) {
+    g_key_file_remove_group(data->cache, group, NULL);
+    g_mutex_unlock(&data->lock);
+    g_free(group);
+    return;
+  }
+
+  g_key_file_set_string(data->cache, group, "path", job->path);
+  g_key_file_set_int64(data->cache, group, "mtime", job->mtime);
+  g_key_file_set_uint64(data->cache, group, "size", job->size);
+  g_key_file_set_integer(data->cache, group, "result", result->result);
+  g_key_file_set_uint64(data->cache, group, "duration", result->duration);
+  g_key_file_set_boolean(data->cache, group, "seekable", result->seekable);
+  g_key_file_set_integer(data->cache, group, "video", result->n_video);
+  g_key_file_set_integer(data->cache, group, "audio", result->n_audio);
+  g_key_file_set_integer(data->cache, group, "subtitles", result->n_subtitles);
+  if (result->container)
+    g_key_file_set_string(data->cache, group, "container", result->container);
+  else
+    g_key_file_remove_key(data->cache, group, "container", NULL);
+  if (result->record) {
+    gchar *record = g_variant_print(result->record, FALSE);
+
+    g_key_file_set_string(data->cache, group, "record", record);
+    g_free(record);
+  } else {
+    g_key_file_remove_key(data->cache, group, "record", NULL);
+  }
+  g_free(group);
+
+  /* Don't lose everything if a long batch is interrupted */
+  if (++data->unsaved >= CACHE_SAVE_INTERVAL) {
+    g_mutex_unlock(&data->lock);
+    cache_save(data);
+    return;
+  }
+  g_mutex_unlock(&data->lock);
+}
+
+static void cache_save(CustomData *data) {
+  GError *err = NULL;
+
+  g_mutex_lock(&data->lock);
+  if (!g_key_file_save_to_file(data->cache, data->cache_file, &err)) {
+    g_printerr("Could not save the cache %s: %s\n", data->cache_file, err->message);
+    g_clear_error(&err);
+  }
+  data->unsaved = 0;
+  g_mutex_unlock(&data->lock);
+}
+
+static void result_from_info(GstDiscovererInfo *info, BatchResult *result) {
+  GstDiscovererStreamInfo *sinfo;
+  GList *streams;
+
+  result->result = gst_discoverer_info_get_result(info);
+  if (result->result != GST_DISCOVERER_OK)
+    return;
+
+  result->duration = gst_discoverer_info_get_duration(info);
+  result->seekable = gst_discoverer_info_get_seekable(info);
+  result->record = discoverer_record_variant_new(info);
+
+  streams = gst_discoverer_info_get_video_streams(info);
+  result->n_video = g_list_length(streams);
+  gst_discoverer_stream_info_list_free(streams);
+  streams = gst_discoverer_info_get_audio_streams(info);
+  result->n_audio = g_list_length(streams);
+  gst_discoverer_stream_info_list_free(streams);
+  streams = gst_discoverer_info_get_subtitle_streams(info);
+  result->n_subtitles = g_list_length(streams);
+  gst_discoverer_stream_info_list_free(streams);
+
+  sinfo = gst_discoverer_info_get_stream_info(info);
+  if (sinfo) {
+    GstCaps *caps = gst_discoverer_stream_info_get_caps(sinfo);
+
+    if (caps) {
+      if (gst_caps_is_fixed(caps))
+        result->container = gst_pb_utils_get_codec_description(caps);
+      else
+        result->container = gst_caps_to_string(caps);
+      gst_caps_unref(caps);
+    }
+    gst_discoverer_stream_info_unref(sinfo);
+  }
+}
+
+static void discover_job(gpointer job_data, gpointer user_data) {
+  BatchJob *job = job_data;
+  CustomData *data = user_data;
+  BatchResult result;
+  gboolean cached;
+
+  memset(&result, 0, sizeof(result));
+
+  cached = cache_lookup(data, job, &result);
+  if (!cached) {
+    GstDiscoverer *discoverer = g_async_queue_pop(data->discoverers);
+    GstDiscovererInfo *info;
+    GError *err = NULL;
+
+    info = gst_discoverer_discover_uri(discoverer, job->uri, &err);
+    g_async_queue_push(data->discoverers, discoverer);
+
+    if (info) {
+      result_from_info(info, &result);
+    } else {
+      result.result = GST_DISCOVERER_ERROR;
+    }
+    if (info)
+      gst_discoverer_info_unref(info);
+    g_clear_error(&err);
+
+    cache_store(data, job, &result);
+  }
+
+  /* Unchanged files get their record from the cache, like the rest of their result */
+  if (data->records)
+    discoverer_record_writer_add_variant(data->records, job->uri, result.result, result.record);
+
+  g_mutex_lock(&data->lock);
+  if (cached)
+    data->n_cached++;
+  else
+    data->n_probed++;
+  if (result.result != GST_DISCOVERER_OK)
+    data->n_failed++;
+  g_mutex_unlock(&data->lock);
+
+  if (result.result == GST_DISCOVERER_OK)
+    g_print("%c %" GST_TIME_FORMAT " %s video:%u audio:%u subtitles:%u %s %s\n", cached ? 'C' : 'P',
+            GST_TIME_ARGS(result.duration), result.seekable ? "seekable" : "not-seekable", result.n_video,
+            result.n_audio, result.n_subtitles, result.container ? result.container : "-", job->uri);
+  else
+    g_print("%c failed (%d) %s\n", cached ? 'C' : 'P', result.result, job->uri);
+
+  g_free(result.container);
+  g_clear_pointer(&result.record, g_variant_unref);
+  batch_job_free(job);
+}
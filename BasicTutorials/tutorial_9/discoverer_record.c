@@ -0,0 +1,399 @@
+#include "discoverer_record.h"
+
+#include <string.h>
+
+/* DISCOVERER_RECORD_VARIANT_TYPE, with the stream array taken as a GVariant */
+#define DISCOVERER_RECORD_VARIANT_FORMAT "(tbsss@a" DISCOVERER_RECORD_STREAM_VARIANT_TYPE ")"
+
+/* Keep the tables 8 byte aligned inside the file, so a mapped file can be used in place */
+G_STATIC_ASSERT(sizeof(DiscovererRecordHeader) == 48);
+G_STATIC_ASSERT(sizeof(DiscovererRecord) == 32);
+G_STATIC_ASSERT(sizeof(DiscovererStream) == 32);
+
+struct _DiscovererRecordWriter {
+  GMutex lock;
+  GArray *records;     /* DiscovererRecord */
+  GArray *streams;     /* DiscovererStream */
+  GByteArray *strings; /* String pool, starts with the empty string */
+  GHashTable *offsets; /* String -> offset in the pool */
+};
+
+struct _DiscovererRecordFile {
+  GMappedFile *mapped;
+  const DiscovererRecordHeader *header;
+  const DiscovererRecord *records;
+  const DiscovererStream *streams;
+  const gchar *strings;
+  gsize strings_size;
+};
+
+static guint32 writer_intern(DiscovererRecordWriter *writer, const gchar *str) {
+  gpointer offset;
+  guint32 new_offset;
+
+  if (str == NULL || *str == '\0')
+    return 0;
+
+  if (g_hash_table_lookup_extended(writer->offsets, str, NULL, &offset))
+    return GPOINTER_TO_UINT(offset);
+
+  new_offset = writer->strings->len;
+  g_byte_array_append(writer->strings, (const guint8 *)str, strlen(str) + 1);
+  g_hash_table_insert(writer->offsets, g_strdup(str), GUINT_TO_POINTER(new_offset));
+
+  return new_offset;
+}
+
+static gchar *dup_tag(const GstTagList *tags, const gchar *tag) {
+  gchar *str = NULL;
+
+  if (tags == NULL || !gst_tag_list_get_string(tags, tag, &str))
+    return g_strdup("");
+
+  return str;
+}
+
+/* Same walk as print_topology() in main.c, parents are added before their children */
+static void variant_add_stream(GVariantBuilder *streams, guint *n_streams, GstDiscovererStreamInfo *info, gint parent) {
+  GstDiscovererStreamInfo *next;
+  GstCaps *caps;
+  gchar *caps_str = NULL;
+  const gchar *language = NULL;
+  DiscovererStreamType type;
+  guint32 bitrate = 0, values[4] = {0, 0, 0, 0};
+  gint index;
+
+  /* Parents are stored as gint16 */
+  if (*n_streams >= G_MAXINT16)
+    return;
+
+  caps = gst_discoverer_stream_info_get_caps(info);
+  if (caps) {
+    caps_str = gst_caps_to_string(caps);
+    gst_caps_unref(caps);
+  }
+
+  if (GST_IS_DISCOVERER_CONTAINER_INFO(info)) {
+    type = DISCOVERER_STREAM_CONTAINER;
+  } else if (GST_IS_DISCOVERER_AUDIO_INFO(info)) {
+    GstDiscovererAudioInfo *audio = GST_DISCOVERER_AUDIO_INFO(info);
+
+    type = DISCOVERER_STREAM_AUDIO;
+    language = gst_discoverer_audio_info_get_language(audio);
+    bitrate = gst_discoverer_audio_info_get_bitrate(audio);
+    values[0] = gst_discoverer_audio_info_get_sample_rate(audio);
+    values[1] = gst_discoverer_audio_info_get_channels(audio);
+    values[2] = gst_discoverer_audio_info_get_depth(audio);
+  } else if (GST_IS_DISCOVERER_VIDEO_INFO(info)) {
+    GstDiscovererVideoInfo *video = GST_DISCOVERER_VIDEO_INFO(info);
+
+    type = DISCOVERER_STREAM_VIDEO;
+    bitrate = gst_discoverer_video_info_get_bitrate(video);
+    values[0] = gst_discoverer_video_info_get_width(video);
+    values[1] = gst_discoverer_video_info_get_height(video);
+    values[2] = gst_discoverer_video_info_get_framerate_num(video);
+    values[3] = gst_discoverer_video_info_get_framerate_denom(video);
+  } else if (GST_IS_DISCOVERER_SUBTITLE_INFO(info)) {
+    type = DISCOVERER_STREAM_SUBTITLE;
+    language = gst_discoverer_subtitle_info_get_language(GST_DISCOVERER_SUBTITLE_INFO(info));
+  } else {
+    type = DISCOVERER_STREAM_UNKNOWN;
+  }
+
+  index = (*n_streams)++;
+  g_variant_builder_add(streams, DISCOVERER_RECORD_STREAM_VARIANT_TYPE, caps_str ? caps_str : "", (gint16)parent,
+                        (guint8)type, language ? language : "", bitrate, values[0], values[1], values[2], values[3]);
+  g_free(caps_str);
+
+  next = gst_discoverer_stream_info_get_next(info);
+  if (next) {
+    variant_add_stream(streams, n_streams, next, index);
+    gst_discoverer_stream_info_unref(next);
+  } else if (GST_IS_DISCOVERER_CONTAINER_INFO(info)) {
+    GList *tmp, *list;
+
+    list = gst_discoverer_container_info_get_streams(GST_DISCOVERER_CONTAINER_INFO(info));
+    for (tmp = list; tmp; tmp = tmp->next)
+      variant_add_stream(streams, n_streams, (GstDiscovererStreamInfo *)tmp->data, index);
+    gst_discoverer_stream_info_list_free(list);
+  }
+}
+
+GVariant *discoverer_record_variant_new(GstDiscovererInfo *info) {
+  const GstTagList *tags = gst_discoverer_info_get_tags(info);
+  GstDiscovererStreamInfo *sinfo;
+  GVariantBuilder streams;
+  GVariant *variant;
+  gchar *title, *artist, *album;
+  guint n_streams = 0;
+
+  g_variant_builder_init(&streams, G_VARIANT_TYPE("a" DISCOVERER_RECORD_STREAM_VARIANT_TYPE));
+  sinfo = gst_discoverer_info_get_stream_info(info);
+  if (sinfo) {
+    variant_add_stream(&streams, &n_streams, sinfo, -1);
+    gst_discoverer_stream_info_unref(sinfo);
+  }
+
+  title = dup_tag(tags, GST_TAG_TITLE);
+  artist = dup_tag(tags, GST_TAG_ARTIST);
+  album = dup_tag(tags, GST_TAG_ALBUM);
+  variant = g_variant_new(DISCOVERER_RECORD_VARIANT_FORMAT, gst_discoverer_info_get_duration(info),
+                          gst_discoverer_info_get_seekable(info), title, artist, album,
+                          g_variant_builder_end(&streams));
+  g_free(title);
+  g_free(artist);
+  g_free(album);
+
+  return g_variant_ref_sink(variant);
+}
+
+DiscovererRecordWriter *discoverer_record_writer_new(void) {
+  DiscovererRecordWriter *writer = g_new0(DiscovererRecordWriter, 1);
+
+  g_mutex_init(&writer->lock);
+  writer->records = g_array_new(FALSE, FALSE, sizeof(DiscovererRecord));
+  writer->streams = g_array_new(FALSE, FALSE, sizeof(DiscovererStream));
+  writer->strings = g_byte_array_new();
+  g_byte_array_append(writer->strings, (const guint8 *)"", 1);
+  writer->offsets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  return writer;
+}
+
+void discoverer_record_writer_free(DiscovererRecordWriter *writer) {
+  g_array_free(writer->records, TRUE);
+  g_array_free(writer->streams, TRUE);
+  g_byte_array_free(writer->strings, TRUE);
+  g_hash_table_destroy(writer->offsets);
+  g_mutex_clear(&writer->lock);
+  g_free(writer);
+}
+
+void discoverer_record_writer_add(DiscovererRecordWriter *writer, const gchar *uri, GstDiscovererResult result,
+                                  GstDiscovererInfo *info) {
+  GVariant *variant = NULL;
+
+  if (info && result == GST_DISCOVERER_OK)
+    variant = discoverer_record_variant_new(info);
+  discoverer_record_writer_add_variant(writer, uri, result, variant);
+  g_clear_pointer(&variant, g_variant_unref);
+}
+
+void discoverer_record_writer_add_variant(DiscovererRecordWriter *writer, const gchar *uri, GstDiscovererResult result,
+                                          GVariant *variant) {
+  DiscovererRecord record;
+
+  g_return_if_fail(variant == NULL || g_variant_is_of_type(variant, G_VARIANT_TYPE(DISCOVERER_RECORD_VARIANT_TYPE)));
+
+  memset(&record, 0, sizeof(record));
+  record.duration = GST_CLOCK_TIME_NONE;
+  record.result = result;
+
+  g_mutex_lock(&writer->lock);
+  record.uri = writer_intern(writer, uri);
+  record.first_stream = writer->streams->len;
+
+  if (variant && result == GST_DISCOVERER_OK) {
+    const gchar *title, *artist, *album, *caps, *language;
+    GVariantIter *streams;
+    gboolean seekable;
+    gint16 parent;
+    guint8 type;
+    guint32 bitrate, values[4];
+
+    g_variant_get(variant, "(tb&s&s&sa" DISCOVERER_RECORD_STREAM_VARIANT_TYPE ")", &record.duration, &seekable, &title,
+                  &artist, &album, &streams);
+    record.seekable = seekable;
+    record.title = writer_intern(writer, title);
+    record.artist = writer_intern(writer, artist);
+    record.album = writer_intern(writer, album);
+
+    while (g_variant_iter_next(streams, "(&sny&su(uuuu))", &caps, &parent, &type, &language, &bitrate, &values[0],
+                               &values[1], &values[2], &values[3])) {
+      DiscovererStream stream;
+
+      /* A variant read back from elsewhere must still give a file the reader accepts */
+      if (record.n_streams >= G_MAXINT16 || parent < -1 || parent >= record.n_streams)
+        break;
+
+      memset(&stream, 0, sizeof(stream));
+      stream.caps = writer_intern(writer, caps);
+      stream.parent = parent;
+      stream.type = type <= DISCOVERER_STREAM_SUBTITLE ? type : DISCOVERER_STREAM_UNKNOWN;
+      stream.language = writer_intern(writer, language);
+      stream.bitrate = bitrate;
+      if (stream.type == DISCOVERER_STREAM_AUDIO) {
+        stream.info.audio.rate = values[0];
+        stream.info.audio.channels = values[1];
+        stream.info.audio.depth = values[2];
+      } else if (stream.type == DISCOVERER_STREAM_VIDEO) {
+        stream.info.video.width = values[0];
+        stream.info.video.height = values[1];
+        stream.info.video.framerate_n = values[2];
+        stream.info.video.framerate_d = values[3];
+      }
+
+      record.n_streams++;
+      g_array_append_val(writer->streams, stream);
+    }
+    g_variant_iter_free(streams);
+  }
+
+  g_array_append_val(writer->records, record);
+  g_mutex_unlock(&writer->lock);
+}
+
+guint discoverer_record_writer_get_n_records(DiscovererRecordWriter *writer) {
+  guint n_records;
+
+  g_mutex_lock(&writer->lock);
+  n_records = writer->records->len;
+  g_mutex_unlock(&writer->lock);
+
+  return n_records;
+}
+
+gboolean discoverer_record_writer_save(DiscovererRecordWriter *writer, const gchar *filename, GError **error) {
+  DiscovererRecordHeader header;
+  gsize records_size, streams_size, size;
+  gchar *contents;
+  gboolean ret;
+
+  g_mutex_lock(&writer->lock);
+
+  records_size = writer->records->len * sizeof(DiscovererRecord);
+  streams_size = writer->streams->len * sizeof(DiscovererStream);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, DISCOVERER_RECORD_MAGIC, sizeof(header.magic));
+  header.version = DISCOVERER_RECORD_VERSION;
+  header.n_records = writer->records->len;
+  header.n_streams = writer->streams->len;
+  header.records_offset = sizeof(header);
+  header.streams_offset = header.records_offset + records_size;
+  header.strings_offset = header.streams_offset + streams_size;
+  header.strings_size = writer->strings->len;
+  size = header.strings_offset + header.strings_size;
+
+  contents = g_malloc(size);
+  memcpy(contents, &header, sizeof(header));
+  memcpy(contents + header.records_offset, writer->records->data, records_size);
+  memcpy(contents + header.streams_offset, writer->streams->data, streams_size);
+  memcpy(contents + header.strings_offset, writer->strings->data, header.strings_size);
+
+  g_mutex_unlock(&writer->lock);
+
+  /* Written to a temporary file and renamed, readers never see half a file */
+  ret = g_file_set_contents(filename, contents, size, error);
+  g_free(contents);
+
+  return ret;
+}
+
+static gboolean file_check_table(gsize size, guint64 offset, guint64 n, gsize element_size) {
+  return offset % 8 == 0 && offset <= size && n <= (size - offset) / element_size;
+}
+
+DiscovererRecordFile *discoverer_record_file_open(const gchar *filename, GError **error) {
+  DiscovererRecordFile *file;
+  const DiscovererRecordHeader *header;
+  GMappedFile *mapped;
+  const gchar *data;
+  gsize size;
+
+  mapped = g_mapped_file_new(filename, FALSE, error);
+  if (!mapped)
+    return NULL;
+
+  data = g_mapped_file_get_contents(mapped);
+  size = g_mapped_file_get_length(mapped);
+  header = (const DiscovererRecordHeader *)data;
+
+  if (size < sizeof(*header) || memcmp(header->magic, DISCOVERER_RECORD_MAGIC, sizeof(header->magic)) != 0) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a discoverer record file", filename);
+    g_mapped_file_unref(mapped);
+    return NULL;
+  }
+
+  if (header->version != DISCOVERER_RECORD_VERSION) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s has an unsupported version or byte order", filename);
+    g_mapped_file_unref(mapped);
+    return NULL;
+  }
+
+  if (!file_check_table(size, header->records_offset, header->n_records, sizeof(DiscovererRecord)) ||
+      !file_check_table(size, header->streams_offset, header->n_streams, sizeof(DiscovererStream)) ||
+      !file_check_table(size, header->strings_offset, header->strings_size, 1) || header->strings_size == 0 ||
+      data[header->strings_offset] != '\0' || data[header->strings_offset + header->strings_size - 1] != '\0') {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is truncated or corrupted", filename);
+    g_mapped_file_unref(mapped);
+    return NULL;
+  }
+
+  file = g_new0(DiscovererRecordFile, 1);
+  file->mapped = mapped;
+  file->header = header;
+  file->records = (const DiscovererRecord *)(data + header->records_offset);
+  file->streams = (const DiscovererStream *)(data + header->streams_offset);
+  file->strings = data + header->strings_offset;
+  file->strings_size = header->strings_size;
+
+  /* Check every reference once, so lookups can trust them */
+  for (guint i = 0; i < header->n_records; i++) {
+    const DiscovererRecord *record = &file->records[i];
+    gboolean valid;
+
+    valid = record->uri < file->strings_size && record->title < file->strings_size &&
+            record->artist < file->strings_size && record->album < file->strings_size &&
+            record->first_stream <= header->n_streams && record->n_streams <= header->n_streams - record->first_stream;
+
+    for (guint j = 0; valid && j < record->n_streams; j++) {
+      const DiscovererStream *stream = &file->streams[record->first_stream + j];
+
+      valid = stream->caps < file->strings_size && stream->language < file->strings_size && stream->parent >= -1 &&
+              stream->parent < (gint)j;
+    }
+
+    if (!valid) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s has an invalid record %u", filename, i);
+      discoverer_record_file_close(file);
+      return NULL;
+    }
+  }
+
+  return file;
+}
+
+void discoverer_record_file_close(DiscovererRecordFile *file) {
+  g_mapped_file_unref(file->mapped);
+  g_free(file);
+}
+
+guint discoverer_record_file_get_n_records(DiscovererRecordFile *file) {
+  return file->header->n_records;
+}
+
+const DiscovererRecord *discoverer_record_file_get_record(DiscovererRecordFile *file, guint index) {
+  g_return_val_if_fail(index < file->header->n_records, NULL);
+
+  return &file->records[index];
+}
+
+const DiscovererStream *discoverer_record_file_get_streams(DiscovererRecordFile *file, const DiscovererRecord *record) {
+  return &file->streams[record->first_stream];
+}
+
+const gchar *discoverer_record_file_get_string(DiscovererRecordFile *file, guint32 offset) {
+  g_return_val_if_fail(offset < file->strings_size, "");
+
+  return file->strings + offset;
+}
+
+const gchar *discoverer_stream_type_get_nick(DiscovererStreamType type) {
+  static const gchar *nicks[] = {"unknown", "container", "audio", "video", "subtitles"};
+
+  if ((guint)type >= G_N_ELEMENTS(nicks))
+    return nicks[0];
+
+  return nicks[type];
+}
@@ -0,0 +1,108 @@
+#ifndef __DISCOVERER_RECORD_H__
+#define __DISCOVERER_RECORD_H__
+
+#include <gst/gst.h>
+#include <gst/pbutils/pbutils.h>
+
+G_BEGIN_DECLS
+
+/* Binary file of discovered media, meant to be mapped and queried without parsing.
+ *
+ * The file is a header followed by three tables: fixed size records (one per URI), fixed size streams (the stream
+ * trees of all records, one after the other) and a pool of NUL terminated strings. Records and streams refer to strings
+ * by their offset in the pool, offset 0 is the empty string. Identical strings, like the caps of streams in the same
+ * format, are stored once. Everything is in host byte order, a file from another byte order is refused. */
+
+#define DISCOVERER_RECORD_MAGIC "GDRC"
+#define DISCOVERER_RECORD_VERSION 1
+
+typedef enum {
+  DISCOVERER_STREAM_UNKNOWN,
+  DISCOVERER_STREAM_CONTAINER,
+  DISCOVERER_STREAM_AUDIO,
+  DISCOVERER_STREAM_VIDEO,
+  DISCOVERER_STREAM_SUBTITLE,
+} DiscovererStreamType;
+
+typedef struct _DiscovererRecordHeader {
+  gchar magic[4];
+  guint32 version;
+  guint32 n_records;
+  guint32 n_streams;
+  guint64 records_offset;
+  guint64 streams_offset;
+  guint64 strings_offset;
+  guint64 strings_size;
+} DiscovererRecordHeader;
+
+typedef struct _DiscovererRecord {
+  guint64 duration;      /* GST_CLOCK_TIME_NONE when unknown */
+  guint32 uri;           /* string */
+  guint32 first_stream;  /* index in the stream table */
+  guint16 n_streams;
+  guint8 result;         /* GstDiscovererResult */
+  guint8 seekable;
+  guint32 title;         /* strings, 0 when the tag is missing */
+  guint32 artist;
+  guint32 album;
+} DiscovererRecord;
+
+typedef struct _DiscovererStream {
+  guint32 caps;          /* string, the full caps and not their description */
+  gint16 parent;         /* index among the streams of the record, -1 for the top level stream */
+  guint8 type;           /* DiscovererStreamType */
+  guint8 reserved;
+  guint32 language;      /* string, audio and subtitle streams */
+  guint32 bitrate;       /* audio and video streams, 0 when unknown */
+  union {
+    struct {
+      guint32 width, height, framerate_n, framerate_d;
+    } video;
+    struct {
+      guint32 rate, channels, depth, reserved;
+    } audio;
+  } info;
+} DiscovererStream;
+
+/* Writing, records are kept in memory until the file is saved. Adding is thread safe. */
+typedef struct _DiscovererRecordWriter DiscovererRecordWriter;
+
+DiscovererRecordWriter *discoverer_record_writer_new(void);
+void discoverer_record_writer_free(DiscovererRecordWriter *writer);
+
+/* info may be NULL when the discoverer failed before it got anything */
+void discoverer_record_writer_add(DiscovererRecordWriter *writer, const gchar *uri, GstDiscovererResult result,
+                                  GstDiscovererInfo *info);
+
+/* What a record keeps of a successful GstDiscovererInfo, as a GVariant that can be printed and parsed again. It lets a
+ * caller keep records elsewhere (tutorial_9_batch keeps them in its cache) and add them without discovering the URI
+ * again. Streams are (caps, parent, type, language, bitrate, (width or rate, height or channels, framerate_n or depth,
+ * framerate_d)). Free with g_variant_unref(). */
+#define DISCOVERER_RECORD_STREAM_VARIANT_TYPE "(snysu(uuuu))"
+#define DISCOVERER_RECORD_VARIANT_TYPE "(tbsssa" DISCOVERER_RECORD_STREAM_VARIANT_TYPE ")"
+
+GVariant *discoverer_record_variant_new(GstDiscovererInfo *info);
+/* variant may be NULL, like info above */
+void discoverer_record_writer_add_variant(DiscovererRecordWriter *writer, const gchar *uri, GstDiscovererResult result,
+                                          GVariant *variant);
+guint discoverer_record_writer_get_n_records(DiscovererRecordWriter *writer);
+gboolean discoverer_record_writer_save(DiscovererRecordWriter *writer, const gchar *filename, GError **error);
+
+/* Reading, the file is mapped and validated once so the accessors below don't need to check anything */
+typedef struct _DiscovererRecordFile DiscovererRecordFile;
+
+DiscovererRecordFile *discoverer_record_file_open(const gchar *filename, GError **error);
+void discoverer_record_file_close(DiscovererRecordFile *file);
+
+guint discoverer_record_file_get_n_records(DiscovererRecordFile *file);
+const DiscovererRecord *discoverer_record_file_get_record(DiscovererRecordFile *file, guint index);
+
+/* The record's streams are streams[0] to streams[record->n_streams - 1], parents come before their children */
+const DiscovererStream *discoverer_record_file_get_streams(DiscovererRecordFile *file, const DiscovererRecord *record);
+const gchar *discoverer_record_file_get_string(DiscovererRecordFile *file, guint32 offset);
+
+const gchar *discoverer_stream_type_get_nick(DiscovererStreamType type);
+
+G_END_DECLS
+
+#endif /* __DISCOVERER_RECORD_H__ */
@@ -0,0 +1,181 @@
+#include <gst/gst.h>
+#include <string.h>
+
+#include "discoverer_record.h"
+
+/* Structure to contain all our information, so we can pass it around */
+typedef struct _CustomData {
+  DiscovererRecordFile *file;
+
+  /* Filters, from the command line */
+  gdouble min_duration, max_duration; /* seconds, negative when not set */
+  gboolean seekable;
+  gchar *type;
+  gchar *caps;
+
+  /* Strings are shared between records, remember which ones matched the caps filter */
+  GHashTable *caps_matches; /* string offset -> 1 (no match) or 2 (match) */
+} CustomData;
+
+/* Returns TRUE if the record passes all the filters */
+static gboolean record_matches(CustomData *, const DiscovererRecord *);
+
+/* Print a record, and its stream tree if asked */
+static void print_record(CustomData *, const DiscovererRecord *, gboolean);
+
+int main(int argc, char *argv[]) {
+  CustomData data;
+  GError *err = NULL;
+  gboolean tree = FALSE, count = FALSE;
+  guint n_matches = 0;
+  GOptionEntry entries[] = {
+      {"min-duration", 0, 0, G_OPTION_ARG_DOUBLE, &data.min_duration, "Shortest duration", "SECONDS"},
+      {"max-duration", 0, 0, G_OPTION_ARG_DOUBLE, &data.max_duration, "Longest duration", "SECONDS"},
+      {"seekable", 's', 0, G_OPTION_ARG_NONE, &data.seekable, "Only seekable files", NULL},
+      {"type", 0, 0, G_OPTION_ARG_STRING, &data.type, "Files with a stream of this type (audio, video, subtitles)",
+       "TYPE"},
+      {"caps", 0, 0, G_OPTION_ARG_STRING, &data.caps, "Files with a stream whose caps contain this string", "STRING"},
+      {"tree", 0, 0, G_OPTION_ARG_NONE, &tree, "Print the stream tree of the matching files", NULL},
+      {"count", 0, 0, G_OPTION_ARG_NONE, &count, "Only print how many files match", NULL},
+      {NULL}};
+  GOptionContext *context;
+
+  /* Initialize custom data structure */
+  memset(&data, 0, sizeof(data));
+  data.min_duration = -1;
+  data.max_duration = -1;
+
+  /* Initialize GStreamer and parse the options */
+  context = g_option_context_new("RECORD FILE - query files written by tutorial_9_batch --records");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("Failed to parse options: %s\n", err->message);
+    g_clear_error(&err);
+    g_option_context_free(context);
+
+    return -1;
+  }
+  g_option_context_free(context);
+
+  if (argc != 2) {
+    g_printerr("Give one record file.\n");
+    return -1;
+  }
+
+  data.file = discoverer_record_file_open(argv[1], &err);
+  if (!data.file) {
+    g_printerr("%s\n", err->message);
+    g_clear_error(&err);
+
+    return -1;
+  }
+  data.caps_matches = g_hash_table_new(NULL, NULL);
+
+  /* The records are used in place, nothing is parsed */
+  for (guint i = 0; i < discoverer_record_file_get_n_records(data.file); i++) {
+    const DiscovererRecord *record = discoverer_record_file_get_record(data.file, i);
+
+    if (!record_matches(&data, record))
+      continue;
+
+    n_matches++;
+    if (!count)
+      print_record(&data, record, tree);
+  }
+
+  g_print("%u of %u files match\n", n_matches, discoverer_record_file_get_n_records(data.file));
+
+  /* Free resources */
+  g_hash_table_destroy(data.caps_matches);
+  discoverer_record_file_close(data.file);
+  g_free(data.type);
+  g_free(data.caps);
+
+  return 0;
+}
+
+static gboolean caps_match(CustomData *data, guint32 offset) {
+  guint match = GPOINTER_TO_UINT(g_hash_table_lookup(data->caps_matches, GUINT_TO_POINTER(offset)));
+
+  if (match == 0) {
+    match = strstr(discoverer_record_file_get_string(data->file, offset), data->caps) ? 2 : 1;
+    g_hash_table_insert(data->caps_matches, GUINT_TO_POINTER(offset), GUINT_TO_POINTER(match));
+  }
+
+  return match == 2;
+}
+
+static gboolean record_matches(CustomData *data, const DiscovererRecord *record) {
+  const DiscovererStream *streams;
+  gboolean type_found = data->type == NULL, caps_found = data->caps == NULL;
+
+  if (record->result != GST_DISCOVERER_OK)
+    return FALSE;
+
+  if (data->seekable && !record->seekable)
+    return FALSE;
+
+  if (data->min_duration >= 0 || data->max_duration >= 0) {
+    gdouble duration;
+
+    if (record->duration == GST_CLOCK_TIME_NONE)
+      return FALSE;
+
+    duration = (gdouble)record->duration / GST_SECOND;
+    if ((data->min_duration >= 0 && duration < data->min_duration) ||
+        (data->max_duration >= 0 && duration > data->max_duration))
+      return FALSE;
+  }
+
+  streams = discoverer_record_file_get_streams(data->file, record);
+  for (guint i = 0; i < record->n_streams && !(type_found && caps_found); i++) {
+    if (!type_found && g_str_equal(discoverer_stream_type_get_nick(streams[i].type), data->type))
+      type_found = TRUE;
+    if (!caps_found && caps_match(data, streams[i].caps))
+      caps_found = TRUE;
+  }
+
+  return type_found && caps_found;
+}
+
+static void print_record(CustomData *data, const DiscovererRecord *record, gboolean tree) {
+  const DiscovererStream *streams;
+  gint *depths;
+
+  g_print("%" GST_TIME_FORMAT " %s %s", GST_TIME_ARGS(record->duration), record->seekable ? "seekable" : "not-seekable",
+          discoverer_record_file_get_string(data->file, record->uri));
+  if (record->title)
+    g_print(" \"%s\"", discoverer_record_file_get_string(data->file, record->title));
+  g_print("\n");
+
+  if (!tree || record->n_streams == 0)
+    return;
+
+  /* Parents come first, so depths can be filled in one pass */
+  streams = discoverer_record_file_get_streams(data->file, record);
+  depths = g_new(gint, record->n_streams);
+  for (guint i = 0; i < record->n_streams; i++) {
+    const DiscovererStream *stream = &streams[i];
+
+    depths[i] = stream->parent < 0 ? 1 : depths[stream->parent] + 1;
+    g_print("%*s%s: %s", 2 * depths[i], " ", discoverer_stream_type_get_nick(stream->type),
+            discoverer_record_file_get_string(data->file, stream->caps));
+
+    switch (stream->type) {
+    case DISCOVERER_STREAM_VIDEO:
+      g_print(" (%ux%u@%u/%u)", stream->info.video.width, stream->info.video.height, stream->info.video.framerate_n,
+              stream->info.video.framerate_d);
+      break;
+    case DISCOVERER_STREAM_AUDIO:
+      g_print(" (%u Hz, %u channels)", stream->info.audio.rate, stream->info.audio.channels);
+      break;
+    default:
+      break;
+    }
+    if (stream->language)
+      g_print(" [%s]", discoverer_record_file_get_string(data->file, stream->language));
+    g_print("\n");
+  }
+  g_free(depths);
+}
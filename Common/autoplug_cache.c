@@ -0,0 +1,327 @@
+#include <string.h>
+
+#include "autoplug_cache.h"
+
+#define AUTOPLUG_CACHE_HEADER "# autoplug cache 1\n" // First line of the file, with the format version
+#define CHAIN_ENTRY "chain"                          // Lines with a caps signature and the factory picked for it
+#define MEDIA_ENTRY "media"                          // Lines with a URI and its container caps
+#define AUTOPLUG_SELECT_TRY 0                        // GST_AUTOPLUG_SELECT_TRY, decodebin doesn't install its enum
+
+/* The fields that select a parser or a decoder, the other ones describe the file */
+static const gchar *signature_fields[] = {
+    "parsed", "framed", "stream-format", "alignment", "mpegversion", "layer", "variant", "systemstream", NULL};
+
+struct _AutoplugCache {
+  gchar *filename;
+
+  GMutex lock;         /* the autoplug signals come from the streaming threads */
+  GHashTable *chains;  /* caps signature -> factory name */
+  GHashTable *media;   /* URI -> container caps */
+  GHashTable *touched; /* chain signatures and URIs used or learned since the last save */
+  gboolean dirty;      /* the file is not up to date */
+  AutoplugCacheStats stats;
+};
+
+/* The URI a decodebin typefinds */
+typedef struct _MediaTypefind {
+  AutoplugCache *cache;
+  gchar *uri;
+} MediaTypefind;
+
+static void media_typefind_free(gpointer data, GClosure *closure) {
+  MediaTypefind *typefind = data;
+
+  g_free(typefind->uri);
+  g_free(typefind);
+}
+
+static void load(AutoplugCache *cache) {
+  gchar *contents;
+  gchar **lines;
+
+  if (!g_file_get_contents(cache->filename, &contents, NULL, NULL))
+    return;
+
+  if (!g_str_has_prefix(contents, AUTOPLUG_CACHE_HEADER)) {
+    GST_WARNING("%s is not an autoplug cache of this version, ignoring it", cache->filename);
+    g_free(contents);
+    return;
+  }
+
+  lines = g_strsplit(contents + strlen(AUTOPLUG_CACHE_HEADER), "\n", -1);
+  for (gchar **line = lines; *line; line++) {
+    gchar **fields = g_strsplit(*line, "\t", 3);
+
+    if (g_strv_length(fields) == 3) {
+      if (g_str_equal(fields[0], CHAIN_ENTRY))
+        g_hash_table_replace(cache->chains, g_strdup(fields[1]), g_strdup(fields[2]));
+      else if (g_str_equal(fields[0], MEDIA_ENTRY))
+        g_hash_table_replace(cache->media, g_strdup(fields[1]), g_strdup(fields[2]));
+    }
+    g_strfreev(fields);
+  }
+
+  g_strfreev(lines);
+  g_free(contents);
+}
+
+/* The media type and the fields of signature_fields, NULL for caps that are not fixed enough to be remembered */
+static gchar *caps_signature(GstCaps *caps) {
+  GstStructure *structure, *signature;
+  gchar *str;
+
+  if (gst_caps_is_any(caps) || gst_caps_is_empty(caps))
+    return NULL;
+
+  structure = gst_caps_get_structure(caps, 0);
+  signature = gst_structure_new_empty(gst_structure_get_name(structure));
+  for (const gchar **field = signature_fields; *field; field++) {
+    const GValue *value = gst_structure_get_value(structure, *field);
+
+    if (value)
+      gst_structure_set_value(signature, *field, value);
+  }
+
+  str = gst_structure_to_string(signature);
+  gst_structure_free(signature);
+
+  return str;
+}
+
+/* decodebin doesn't plug a parser after itself, whatever its output caps are */
+static gboolean is_upstream_factory(GstPad *pad, GstElementFactory *factory) {
+  GstElement *parent = gst_pad_get_parent_element(pad);
+  gboolean ret = parent && gst_element_get_factory(parent) == factory;
+
+  if (parent)
+    gst_object_unref(parent);
+
+  return ret;
+}
+
+/* What the default handler of uridecodebin answers: its accumulator stops at the first handler, the default one never
+ * runs once ours did, and an empty answer makes decodebin expose the pad as it is */
+static GList *registry_factories(GstCaps *caps) {
+  GList *decodable = gst_element_factory_list_get_elements(GST_ELEMENT_FACTORY_TYPE_DECODABLE, GST_RANK_MARGINAL);
+  GList *factories = gst_element_factory_list_filter(decodable, caps, GST_PAD_SINK, FALSE);
+
+  gst_plugin_feature_list_free(decodable);
+
+  return g_list_sort(factories, gst_plugin_feature_rank_compare_func);
+}
+
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+static GValueArray *autoplug_factories_cb(GstElement *bin, GstPad *pad, GstCaps *caps, AutoplugCache *cache) {
+  GstElementFactory *factory = NULL;
+  GList *factories = NULL;
+  GValueArray *result;
+  gchar *signature = caps_signature(caps);
+  const gchar *name;
+
+  if (signature) {
+    g_mutex_lock(&cache->lock);
+    name = g_hash_table_lookup(cache->chains, signature);
+    if (name)
+      factory = gst_element_factory_find(name);
+
+    /* The plugin may be gone or changed since the choice was made */
+    if (factory && gst_element_factory_can_sink_any_caps(factory, caps) && !is_upstream_factory(pad, factory)) {
+      factories = g_list_prepend(NULL, gst_object_ref(factory));
+      g_hash_table_add(cache->touched, g_strdup(signature));
+      cache->stats.hits++;
+    } else {
+      cache->stats.misses++;
+    }
+    g_mutex_unlock(&cache->lock);
+
+    if (factory)
+      gst_object_unref(factory);
+    g_free(signature);
+  }
+
+  /* On a miss all the candidates of the registry, autoplug-select learns the one that works */
+  if (!factories)
+    factories = registry_factories(caps);
+
+  result = g_value_array_new(g_list_length(factories));
+  for (GList *l = factories; l; l = l->next) {
+    GValue value = G_VALUE_INIT;
+
+    g_value_init(&value, GST_TYPE_ELEMENT_FACTORY);
+    g_value_set_object(&value, l->data);
+    g_value_array_append(result, &value);
+    g_value_unset(&value);
+  }
+  gst_plugin_feature_list_free(factories);
+
+  return result;
+}
+G_GNUC_END_IGNORE_DEPRECATIONS
+
+/* decodebin tries the factories in turn, the last one it selects for some caps is the one that worked */
+static gint autoplug_select_cb(GstElement *bin, GstPad *pad, GstCaps *caps, GstElementFactory *factory,
+                               AutoplugCache *cache) {
+  const gchar *name = gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory));
+  gchar *signature;
+
+  if (is_upstream_factory(pad, factory) || (signature = caps_signature(caps)) == NULL)
+    return AUTOPLUG_SELECT_TRY;
+
+  g_mutex_lock(&cache->lock);
+  if (g_strcmp0(g_hash_table_lookup(cache->chains, signature), name) != 0) {
+    g_hash_table_replace(cache->chains, g_strdup(signature), g_strdup(name));
+    g_hash_table_add(cache->touched, g_strdup(signature));
+    cache->stats.learned++;
+    cache->dirty = TRUE;
+  }
+  g_mutex_unlock(&cache->lock);
+
+  g_free(signature);
+
+  return AUTOPLUG_SELECT_TRY;
+}
+
+static void have_type_cb(GstElement *element, guint probability, GstCaps *caps, MediaTypefind *typefind) {
+  AutoplugCache *cache = typefind->cache;
+  gchar *str = gst_caps_to_string(caps);
+
+  g_mutex_lock(&cache->lock);
+  if (g_strcmp0(g_hash_table_lookup(cache->media, typefind->uri), str) != 0) {
+    g_hash_table_replace(cache->media, g_strdup(typefind->uri), g_strdup(str));
+    g_hash_table_add(cache->touched, g_strdup(typefind->uri));
+    cache->stats.learned++;
+    cache->dirty = TRUE;
+  }
+  g_mutex_unlock(&cache->lock);
+
+  g_free(str);
+}
+
+static void deep_element_added_cb(GstBin *bin, GstBin *sub_bin, GstElement *element, AutoplugCache *cache) {
+  GstElementFactory *factory = gst_element_get_factory(element);
+  GstElement *typefind;
+  MediaTypefind *media_typefind;
+  const gchar *caps_str;
+  gchar *uri;
+
+  if (!factory || !g_str_equal(gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)), "decodebin"))
+    return;
+
+  g_object_get(bin, "uri", &uri, NULL);
+  if (!uri)
+    return;
+
+  /* decodebin is not started yet: with its sink caps set, its typefind element takes them without looking at the
+   * data */
+  g_mutex_lock(&cache->lock);
+  caps_str = g_hash_table_lookup(cache->media, uri);
+  if (caps_str) {
+    GstCaps *caps = gst_caps_from_string(caps_str);
+
+    if (caps) {
+      g_object_set(element, "sink-caps", caps, NULL);
+      gst_caps_unref(caps);
+      g_hash_table_add(cache->touched, g_strdup(uri));
+      cache->stats.typefind_skipped++;
+    }
+  }
+  g_mutex_unlock(&cache->lock);
+
+  /* Learn the container caps, or see them change */
+  typefind = gst_bin_get_by_name(GST_BIN(element), "typefind");
+  if (typefind) {
+    media_typefind = g_new0(MediaTypefind, 1);
+    media_typefind->cache = cache;
+    media_typefind->uri = g_strdup(uri);
+    g_signal_connect_data(typefind, "have-type", G_CALLBACK(have_type_cb), media_typefind, media_typefind_free, 0);
+    gst_object_unref(typefind);
+  }
+
+  g_free(uri);
+}
+
+AutoplugCache *autoplug_cache_new(const gchar *filename) {
+  AutoplugCache *cache = g_new0(AutoplugCache, 1);
+
+  if (filename)
+    cache->filename = g_strdup(filename);
+  else
+    cache->filename = g_build_filename(g_get_user_cache_dir(), "gstreamer-tutorial", "autoplug-cache.txt", NULL);
+
+  g_mutex_init(&cache->lock);
+  cache->chains = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  cache->media = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  cache->touched = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  load(cache);
+
+  return cache;
+}
+
+void autoplug_cache_free(AutoplugCache *cache) {
+  if (!cache)
+    return;
+
+  g_hash_table_destroy(cache->chains);
+  g_hash_table_destroy(cache->media);
+  g_hash_table_destroy(cache->touched);
+  g_mutex_clear(&cache->lock);
+  g_free(cache->filename);
+  g_free(cache);
+}
+
+void autoplug_cache_attach(AutoplugCache *cache, GstElement *uridecodebin) {
+  g_signal_connect(uridecodebin, "autoplug-factories", G_CALLBACK(autoplug_factories_cb), cache);
+  g_signal_connect(uridecodebin, "autoplug-select", G_CALLBACK(autoplug_select_cb), cache);
+  g_signal_connect(uridecodebin, "deep-element-added", G_CALLBACK(deep_element_added_cb), cache);
+}
+
+gboolean autoplug_cache_save(AutoplugCache *cache, GError **error) {
+  GHashTableIter iter;
+  gpointer key, value;
+  GString *contents;
+  gchar *dir;
+  gboolean ret = TRUE;
+
+  g_mutex_lock(&cache->lock);
+  if (cache->dirty) {
+    contents = g_string_new(AUTOPLUG_CACHE_HEADER);
+    g_hash_table_iter_init(&iter, cache->chains);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+      g_string_append_printf(contents, "%s\t%s\t%s\n", CHAIN_ENTRY, (const gchar *)key, (const gchar *)value);
+    g_hash_table_iter_init(&iter, cache->media);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+      g_string_append_printf(contents, "%s\t%s\t%s\n", MEDIA_ENTRY, (const gchar *)key, (const gchar *)value);
+
+    dir = g_path_get_dirname(cache->filename);
+    g_mkdir_with_parents(dir, 0755);
+    g_free(dir);
+
+    ret = g_file_set_contents(cache->filename, contents->str, contents->len, error);
+    g_string_free(contents, TRUE);
+    cache->dirty = !ret;
+  }
+  if (ret)
+    g_hash_table_remove_all(cache->touched);
+  g_mutex_unlock(&cache->lock);
+
+  return ret;
+}
+
+void autoplug_cache_forget(AutoplugCache *cache) {
+  GHashTableIter iter;
+  gpointer key;
+
+  g_mutex_lock(&cache->lock);
+  g_hash_table_iter_init(&iter, cache->touched);
+  while (g_hash_table_iter_next(&iter, &key, NULL))
+    if (g_hash_table_remove(cache->chains, key) || g_hash_table_remove(cache->media, key))
+      cache->dirty = TRUE;
+  g_hash_table_remove_all(cache->touched);
+  g_mutex_unlock(&cache->lock);
+}
+
+void autoplug_cache_get_stats(AutoplugCache *cache, AutoplugCacheStats *stats) {
+  g_mutex_lock(&cache->lock);
+  *stats = cache->stats;
+  g_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,43 @@
+#ifndef __COMMON_AUTOPLUG_CACHE_H__
+#define __COMMON_AUTOPLUG_CACHE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Remembers the demuxers, parsers and decoders uridecodebin picked, so later runs plug the same chain directly.
+ *
+ * Each caps uridecodebin has to find an element for is reduced to a signature: the media type and the few fields that
+ * select a parser or decoder (parsed, stream-format, alignment...), not the ones of the file (size, rate, codec data).
+ * On a hit the autoplug-factories signal answers with the remembered factory alone, which skips filtering and sorting
+ * the factories of the registry. The container caps of every URI are remembered too and given to decodebin as its
+ * sink-caps, which skips its typefinding. Streams have already been typefound by uridecodebin at that point.
+ *
+ * A choice is only kept for good once autoplug_cache_save() is called, after the media prerolled. If a run fails,
+ * autoplug_cache_forget() drops what it used and learned, the next run goes through the registry again. */
+typedef struct _AutoplugCache AutoplugCache;
+
+typedef struct _AutoplugCacheStats {
+  guint64 hits, misses;     /* autoplug-factories answered from the cache, or from the registry */
+  guint64 typefind_skipped; /* decodebins given the container caps */
+  guint64 learned;          /* new choices and container caps, saved or not */
+} AutoplugCacheStats;
+
+/* Loads filename if it exists, NULL for autoplug-cache.txt in the user cache directory */
+AutoplugCache *autoplug_cache_new(const gchar *filename);
+void autoplug_cache_free(AutoplugCache *cache);
+
+/* Connects to a uridecodebin, before it goes to PAUSED. The cache must outlive it. */
+void autoplug_cache_attach(AutoplugCache *cache, GstElement *uridecodebin);
+
+/* Writes what was learned since the last save */
+gboolean autoplug_cache_save(AutoplugCache *cache, GError **error);
+
+/* Drops the entries used or learned since the last save, saved entries included */
+void autoplug_cache_forget(AutoplugCache *cache);
+
+void autoplug_cache_get_stats(AutoplugCache *cache, AutoplugCacheStats *stats);
+
+G_END_DECLS
+
+#endif /* __COMMON_AUTOPLUG_CACHE_H__ */
@@ -0,0 +1,324 @@
+#include "branch_manager.h"
+
+#define HEAD_QUEUE_BUFFERS 200 // Buffers the leaky queue at the head of a branch holds
+
+typedef struct _Branch {
+  gint ref_count; /* one for the table, one for each pending probe or source */
+
+  BranchManager *manager;
+  GMainContext *context;
+  gchar *name;
+  GstElement *bin;
+  GstPad *tee_pad;
+  GstPad *sink_pad; /* ghost pad of the bin */
+
+  /* removal, the streaming threads only read removing and count pending_eos down */
+  gint removing;
+  gint pending_eos; /* sink pads the EOS has yet to reach */
+  gboolean finished;
+  gint64 remove_start;
+  GSource *timeout;
+  BranchRemovedFunc func;
+  gpointer user_data;
+} Branch;
+
+struct _BranchManager {
+  GstElement *pipeline, *tee;
+  GstClockTime remove_timeout;
+  GMainContext *context;
+  GHashTable *branches; /* name -> Branch, only used in the main context */
+  BranchManagerStats stats;
+};
+
+static Branch *branch_ref(Branch *branch) {
+  g_atomic_int_inc(&branch->ref_count);
+
+  return branch;
+}
+
+static void branch_unref(gpointer data) {
+  Branch *branch = data;
+
+  if (!g_atomic_int_dec_and_test(&branch->ref_count))
+    return;
+
+  if (branch->tee_pad)
+    gst_object_unref(branch->tee_pad);
+  if (branch->sink_pad)
+    gst_object_unref(branch->sink_pad);
+  gst_object_unref(branch->bin);
+  g_main_context_unref(branch->context);
+  g_free(branch->name);
+  g_free(branch);
+}
+
+/* Runs func on the branch from the main context, never from the calling thread */
+static void branch_schedule(Branch *branch, GSourceFunc func) {
+  GSource *source = g_idle_source_new();
+
+  g_source_set_callback(source, func, branch_ref(branch), branch_unref);
+  g_source_attach(source, branch->context);
+  g_source_unref(source);
+}
+
+/* Takes the branch out of the pipeline, in the main context */
+static void branch_finish(Branch *branch, gboolean drained) {
+  BranchManager *manager = branch->manager;
+  gint64 elapsed;
+
+  if (branch->finished)
+    return;
+  branch->finished = TRUE;
+
+  if (branch->timeout) {
+    g_source_destroy(branch->timeout);
+    g_source_unref(branch->timeout);
+    branch->timeout = NULL;
+  }
+
+  /* Once in NULL nothing streams in the branch anymore, so no probe can run */
+  gst_element_set_locked_state(branch->bin, TRUE);
+  gst_element_set_state(branch->bin, GST_STATE_NULL);
+  if (gst_pad_is_linked(branch->tee_pad))
+    gst_pad_unlink(branch->tee_pad, branch->sink_pad);
+  gst_bin_remove(GST_BIN(manager->pipeline), branch->bin);
+  gst_element_release_request_pad(manager->tee, branch->tee_pad);
+
+  elapsed = g_get_monotonic_time() - branch->remove_start;
+  manager->stats.removed++;
+  manager->stats.max_remove_time = MAX(manager->stats.max_remove_time, elapsed);
+
+  if (branch->func)
+    branch->func(manager, branch->name, drained, branch->user_data);
+
+  g_hash_table_remove(manager->branches, branch->name);
+}
+
+static gboolean branch_drained_cb(gpointer user_data) {
+  branch_finish(user_data, TRUE);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean branch_timeout_cb(gpointer user_data) {
+  Branch *branch = user_data;
+
+  if (!branch->finished) {
+    branch->manager->stats.timeouts++;
+    branch_finish(branch, FALSE);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+/* On the sink pads of the branch, counts the EOS of a removal */
+static GstPadProbeReturn eos_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  Branch *branch = user_data;
+
+  if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_EOS && g_atomic_int_get(&branch->removing) &&
+      g_atomic_int_dec_and_test(&branch->pending_eos))
+    branch_schedule(branch, branch_drained_cb);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Idle probe on the tee pad: nothing is being pushed to the branch, it gets nothing after its last buffer but EOS */
+static GstPadProbeReturn unlink_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  Branch *branch = user_data;
+
+  gst_pad_unlink(branch->tee_pad, branch->sink_pad);
+  gst_pad_send_event(branch->sink_pad, gst_event_new_eos());
+  if (g_atomic_int_get(&branch->pending_eos) == 0)
+    branch_schedule(branch, branch_drained_cb);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+/* Sinks that don't wait for a preroll can join and leave without the pipeline losing its state */
+static void make_sink_not_async(GstElement *element) {
+  if (GST_OBJECT_FLAG_IS_SET(element, GST_ELEMENT_FLAG_SINK) &&
+      g_object_class_find_property(G_OBJECT_GET_CLASS(element), "async"))
+    g_object_set(element, "async", FALSE, NULL);
+}
+
+static void deep_element_added_cb(GstBin *bin, GstBin *sub_bin, GstElement *element, gpointer user_data) {
+  make_sink_not_async(element);
+}
+
+/* Undoes a branch_manager_add() that failed half way */
+static void branch_discard(Branch *branch) {
+  gst_element_set_locked_state(branch->bin, TRUE);
+  gst_element_set_state(branch->bin, GST_STATE_NULL);
+  if (GST_OBJECT_PARENT(branch->bin))
+    gst_bin_remove(GST_BIN(branch->manager->pipeline), branch->bin);
+  if (branch->tee_pad)
+    gst_element_release_request_pad(branch->manager->tee, branch->tee_pad);
+  branch_unref(branch);
+}
+
+BranchManager *branch_manager_new(GstElement *pipeline, GstElement *tee, GstClockTime remove_timeout) {
+  BranchManager *manager = g_new0(BranchManager, 1);
+
+  manager->pipeline = gst_object_ref(pipeline);
+  manager->tee = gst_object_ref(tee);
+  manager->remove_timeout = remove_timeout;
+  manager->context = g_main_context_ref_thread_default();
+  manager->branches = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, branch_unref);
+
+  return manager;
+}
+
+void branch_manager_free(BranchManager *manager) {
+  GList *branches;
+
+  if (!manager)
+    return;
+
+  branches = g_hash_table_get_values(manager->branches);
+  for (GList *l = branches; l; l = l->next) {
+    Branch *branch = l->data;
+
+    if (!branch->removing)
+      branch->remove_start = g_get_monotonic_time();
+    branch_finish(branch, FALSE);
+  }
+  g_list_free(branches);
+
+  g_hash_table_destroy(manager->branches);
+  g_main_context_unref(manager->context);
+  gst_object_unref(manager->tee);
+  gst_object_unref(manager->pipeline);
+  g_free(manager);
+}
+
+gboolean branch_manager_add(BranchManager *manager, const gchar *name, const gchar *description, GError **err) {
+  gint64 start = g_get_monotonic_time(), elapsed;
+  GError *parse_err = NULL;
+  Branch *branch;
+  GstElement *bin;
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+  GstClock *clock;
+  gchar *full;
+
+  if (g_hash_table_contains(manager->branches, name)) {
+    g_set_error(err, GST_CORE_ERROR, GST_CORE_ERROR_FAILED, "There is already a branch %s", name);
+    return FALSE;
+  }
+
+  /* The leaky queue gives the branch its own thread and drops what the branch can't take instead of blocking the tee */
+  full = g_strdup_printf("queue leaky=downstream max-size-buffers=%u max-size-bytes=0 max-size-time=0 ! %s",
+                         HEAD_QUEUE_BUFFERS, description);
+  bin = gst_parse_bin_from_description(full, TRUE, &parse_err);
+  g_free(full);
+  if (parse_err) {
+    g_propagate_error(err, parse_err);
+    if (bin)
+      gst_object_unref(gst_object_ref_sink(bin));
+
+    return FALSE;
+  }
+
+  branch = g_new0(Branch, 1);
+  branch->ref_count = 1;
+  branch->manager = manager;
+  branch->context = g_main_context_ref(manager->context);
+  branch->name = g_strdup(name);
+  branch->bin = gst_object_ref_sink(bin);
+  branch->sink_pad = gst_element_get_static_pad(bin, "sink");
+  gst_object_set_name(GST_OBJECT(bin), name);
+
+  /* Also the sinks autovideosink and friends only create when they go to READY */
+  g_signal_connect(bin, "deep-element-added", G_CALLBACK(deep_element_added_cb), NULL);
+  it = gst_bin_iterate_recurse(GST_BIN(bin));
+  while (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+    make_sink_not_async(g_value_get_object(&item));
+    g_value_reset(&item);
+  }
+  gst_iterator_free(it);
+
+  /* The EOS of a removal is done once it reached the sink pad of every sink */
+  it = gst_bin_iterate_sinks(GST_BIN(bin));
+  while (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+    GstPad *pad = gst_element_get_static_pad(g_value_get_object(&item), "sink");
+
+    if (pad) {
+      branch->pending_eos++;
+      gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, eos_probe_cb, branch, NULL);
+      gst_object_unref(pad);
+    }
+    g_value_reset(&item);
+  }
+  g_value_unset(&item);
+  gst_iterator_free(it);
+
+  /* Bring the branch up on its own, with the clock and base time of the pipeline, so that the pipeline itself never
+   * changes state. Opening devices and files happens here, before any buffer goes to the branch. */
+  gst_element_set_locked_state(bin, TRUE);
+  if (!gst_bin_add(GST_BIN(manager->pipeline), bin)) {
+    g_set_error(err, GST_CORE_ERROR, GST_CORE_ERROR_FAILED, "The pipeline already has an element named %s", name);
+    branch_discard(branch);
+
+    return FALSE;
+  }
+  clock = gst_element_get_clock(manager->pipeline);
+  if (clock) {
+    gst_element_set_clock(bin, clock);
+    gst_object_unref(clock);
+  }
+  gst_element_set_base_time(bin, gst_element_get_base_time(manager->pipeline));
+  if (gst_element_set_state(bin, GST_STATE(manager->pipeline)) == GST_STATE_CHANGE_FAILURE) {
+    g_set_error(err, GST_CORE_ERROR, GST_CORE_ERROR_STATE_CHANGE, "Branch %s could not start", name);
+    branch_discard(branch);
+
+    return FALSE;
+  }
+
+  /* The new tee pad got the caps and segment of the stream, they go out with its next buffer */
+  branch->tee_pad = gst_element_get_request_pad(manager->tee, "src_%u");
+  if (!branch->tee_pad || gst_pad_link(branch->tee_pad, branch->sink_pad) != GST_PAD_LINK_OK) {
+    g_set_error(err, GST_CORE_ERROR, GST_CORE_ERROR_NEGOTIATION, "Branch %s could not be linked to the tee", name);
+    branch_discard(branch);
+
+    return FALSE;
+  }
+  gst_element_set_locked_state(bin, FALSE);
+
+  g_hash_table_insert(manager->branches, branch->name, branch);
+
+  elapsed = g_get_monotonic_time() - start;
+  manager->stats.added++;
+  manager->stats.max_add_time = MAX(manager->stats.max_add_time, elapsed);
+
+  return TRUE;
+}
+
+gboolean branch_manager_remove(BranchManager *manager, const gchar *name, BranchRemovedFunc func, gpointer user_data) {
+  Branch *branch = g_hash_table_lookup(manager->branches, name);
+
+  if (!branch || g_atomic_int_get(&branch->removing))
+    return FALSE;
+
+  branch->func = func;
+  branch->user_data = user_data;
+  branch->remove_start = g_get_monotonic_time();
+  g_atomic_int_set(&branch->removing, 1);
+
+  /* A branch whose sinks never see the EOS is taken out anyway */
+  branch->timeout = g_timeout_source_new(GST_TIME_AS_MSECONDS(manager->remove_timeout));
+  g_source_set_callback(branch->timeout, branch_timeout_cb, branch_ref(branch), branch_unref);
+  g_source_attach(branch->timeout, manager->context);
+
+  /* The leaky queue never blocks the tee pad, so it becomes idle within one buffer */
+  gst_pad_add_probe(branch->tee_pad, GST_PAD_PROBE_TYPE_IDLE, unlink_cb, branch_ref(branch), branch_unref);
+
+  return TRUE;
+}
+
+gboolean branch_manager_has_branch(BranchManager *manager, const gchar *name) {
+  return g_hash_table_contains(manager->branches, name);
+}
+
+void branch_manager_get_stats(BranchManager *manager, BranchManagerStats *stats) {
+  *stats = manager->stats;
+}
@@ -0,0 +1,47 @@
+#ifndef __COMMON_BRANCH_MANAGER_H__
+#define __COMMON_BRANCH_MANAGER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Adds and removes tee branches while the pipeline is PLAYING, without disturbing the other branches.
+ *
+ * A branch is a bin made from a description, behind a leaky queue so that it can never block the tee. It is brought
+ * to PLAYING on its own, with the clock and base time of the pipeline and its sinks in non-async mode, before it is
+ * linked: the pipeline doesn't change state and nothing is flushed. Removing a branch waits for its tee pad to be
+ * idle with a blocking probe, unlinks it there and sends an EOS down the branch, so that muxers and file sinks finish
+ * their files. Once the EOS reached every sink, or after the timeout, the branch is shut down and taken out.
+ *
+ * Everything happens in the thread-default main context of branch_manager_new(), which has to be running. */
+typedef struct _BranchManager BranchManager;
+
+typedef struct _BranchManagerStats {
+  guint64 added, removed; /* branches */
+  guint64 timeouts;       /* removals that didn't see the EOS in time */
+  gint64 max_add_time;    /* longest add, in microseconds */
+  gint64 max_remove_time; /* longest removal from the call to the end of the branch, in microseconds */
+} BranchManagerStats;
+
+/* Called in the main context when a branch is gone, drained is FALSE if it timed out before the EOS went through */
+typedef void (*BranchRemovedFunc)(BranchManager *manager, const gchar *name, gboolean drained, gpointer user_data);
+
+/* remove_timeout bounds the wait for the EOS of a removed branch */
+BranchManager *branch_manager_new(GstElement *pipeline, GstElement *tee, GstClockTime remove_timeout);
+
+/* Removes the remaining branches right away, without waiting for their EOS */
+void branch_manager_free(BranchManager *manager);
+
+/* description is a gst-launch style bin, its unlinked sink pad is fed from the tee */
+gboolean branch_manager_add(BranchManager *manager, const gchar *name, const gchar *description, GError **err);
+
+/* Returns FALSE if there is no such branch or it is already being removed, func is called once it is gone */
+gboolean branch_manager_remove(BranchManager *manager, const gchar *name, BranchRemovedFunc func, gpointer user_data);
+
+gboolean branch_manager_has_branch(BranchManager *manager, const gchar *name);
+
+void branch_manager_get_stats(BranchManager *manager, BranchManagerStats *stats);
+
+G_END_DECLS
+
+#endif /* __COMMON_BRANCH_MANAGER_H__ */
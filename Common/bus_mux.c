@@ -0,0 +1,304 @@
+#include "bus_mux.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#define BUS_MUX_USE_EPOLL 1
+#endif
+
+#define BUS_MUX_MAX_EVENTS 64 // Ready buses handled per wakeup with epoll
+#define BUS_MUX_CONTROL_ID 0  // Id of the private bus used to wake the dispatcher up
+
+typedef struct _BusMuxEntry {
+  gint ref_count; /* one for the table, one while dispatching */
+  gint removed;
+
+  GstBus *bus;
+  GPollFD pollfd;
+  BusMuxHandler handler;
+  gpointer user_data;
+  GDestroyNotify notify;
+} BusMuxEntry;
+
+struct _BusMux {
+  GMutex lock; /* protects entries, next_id and changed */
+  GHashTable *entries; /* id -> BusMuxEntry */
+  guint next_id;
+  gboolean changed; /* entries changed since the g_poll() set was built */
+
+  GstBus *control; /* a message on it wakes the dispatcher up */
+  GPollFD control_pollfd;
+  gint quit;
+
+#ifdef BUS_MUX_USE_EPOLL
+  int epoll_fd; /* -1 when epoll is not available, g_poll() is used then */
+#endif
+
+  BusMuxStats stats;
+};
+
+static void bus_mux_entry_unref(BusMuxEntry *entry) {
+  if (!g_atomic_int_dec_and_test(&entry->ref_count))
+    return;
+
+  if (entry->notify)
+    entry->notify(entry->user_data);
+  gst_object_unref(entry->bus);
+  g_free(entry);
+}
+
+static void bus_mux_wakeup(BusMux *mux) {
+  gst_bus_post(mux->control, gst_message_new_application(NULL, gst_structure_new_empty("bus-mux-wakeup")));
+}
+
+/* epoll picks up added and removed buses by itself, g_poll() has to rebuild its set */
+static void bus_mux_wakeup_poll(BusMux *mux) {
+#ifdef BUS_MUX_USE_EPOLL
+  if (mux->epoll_fd >= 0)
+    return;
+#endif
+  bus_mux_wakeup(mux);
+}
+
+/* Pops at most one batch of messages of a ready bus */
+static void bus_mux_dispatch(BusMux *mux, guint id) {
+  BusMuxEntry *entry;
+  GstMessage *msg;
+  guint n = 0;
+
+  if (id == BUS_MUX_CONTROL_ID) {
+    while ((msg = gst_bus_pop(mux->control)) != NULL)
+      gst_message_unref(msg);
+    return;
+  }
+
+  g_mutex_lock(&mux->lock);
+  entry = g_hash_table_lookup(mux->entries, GUINT_TO_POINTER(id));
+  if (entry)
+    g_atomic_int_inc(&entry->ref_count);
+  g_mutex_unlock(&mux->lock);
+
+  /* Removed after the poll returned */
+  if (entry == NULL)
+    return;
+
+  while (n < BUS_MUX_BATCH && !g_atomic_int_get(&entry->removed) && (msg = gst_bus_pop(entry->bus)) != NULL) {
+    entry->handler(msg, entry->user_data);
+    gst_message_unref(msg);
+    n++;
+  }
+
+  mux->stats.messages += n;
+  mux->stats.max_batch = MAX(mux->stats.max_batch, n);
+
+  bus_mux_entry_unref(entry);
+}
+
+#ifdef BUS_MUX_USE_EPOLL
+static void bus_mux_run_epoll(BusMux *mux) {
+  struct epoll_event events[BUS_MUX_MAX_EVENTS];
+
+  while (!g_atomic_int_get(&mux->quit)) {
+    int n = epoll_wait(mux->epoll_fd, events, BUS_MUX_MAX_EVENTS, -1);
+
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+
+      GST_ERROR("epoll_wait failed: %s", g_strerror(errno));
+      break;
+    }
+
+    mux->stats.wakeups++;
+    for (int i = 0; i < n; i++)
+      bus_mux_dispatch(mux, (guint)events[i].data.u64);
+  }
+}
+#endif
+
+static void bus_mux_run_poll(BusMux *mux) {
+  GArray *fds = g_array_new(FALSE, FALSE, sizeof(GPollFD));
+  GArray *ids = g_array_new(FALSE, FALSE, sizeof(guint));
+
+  while (!g_atomic_int_get(&mux->quit)) {
+    GHashTableIter iter;
+    gpointer key, value;
+    gint n;
+
+    /* Adding or removing a bus wakes the dispatcher up to get here */
+    g_mutex_lock(&mux->lock);
+    if (mux->changed) {
+      guint control_id = BUS_MUX_CONTROL_ID;
+
+      g_array_set_size(fds, 0);
+      g_array_set_size(ids, 0);
+      g_array_append_val(fds, mux->control_pollfd);
+      g_array_append_val(ids, control_id);
+
+      g_hash_table_iter_init(&iter, mux->entries);
+      while (g_hash_table_iter_next(&iter, &key, &value)) {
+        BusMuxEntry *entry = value;
+        guint id = GPOINTER_TO_UINT(key);
+
+        g_array_append_val(fds, entry->pollfd);
+        g_array_append_val(ids, id);
+      }
+      mux->changed = FALSE;
+    }
+    g_mutex_unlock(&mux->lock);
+
+    n = g_poll((GPollFD *)fds->data, fds->len, -1);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+
+      GST_ERROR("g_poll failed: %s", g_strerror(errno));
+      break;
+    }
+
+    mux->stats.wakeups++;
+    for (guint i = 0; i < fds->len && n > 0; i++) {
+      if (g_array_index(fds, GPollFD, i).revents & G_IO_IN) {
+        bus_mux_dispatch(mux, g_array_index(ids, guint, i));
+        n--;
+      }
+    }
+  }
+
+  g_array_free(fds, TRUE);
+  g_array_free(ids, TRUE);
+}
+
+BusMux *bus_mux_new(void) {
+  BusMux *mux = g_new0(BusMux, 1);
+
+  g_mutex_init(&mux->lock);
+  mux->entries = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)bus_mux_entry_unref);
+  mux->changed = TRUE;
+
+  mux->control = gst_bus_new();
+  gst_bus_get_pollfd(mux->control, &mux->control_pollfd);
+  mux->control_pollfd.events = G_IO_IN;
+
+#ifdef BUS_MUX_USE_EPOLL
+  mux->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (mux->epoll_fd >= 0) {
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = BUS_MUX_CONTROL_ID;
+    epoll_ctl(mux->epoll_fd, EPOLL_CTL_ADD, mux->control_pollfd.fd, &ev);
+  } else {
+    GST_WARNING("epoll_create1 failed, falling back to g_poll: %s", g_strerror(errno));
+  }
+#endif
+
+  return mux;
+}
+
+void bus_mux_free(BusMux *mux) {
+  if (mux == NULL)
+    return;
+
+#ifdef BUS_MUX_USE_EPOLL
+  if (mux->epoll_fd >= 0)
+    close(mux->epoll_fd);
+#endif
+
+  g_hash_table_destroy(mux->entries);
+  gst_object_unref(mux->control);
+  g_mutex_clear(&mux->lock);
+  g_free(mux);
+}
+
+guint bus_mux_add(BusMux *mux, GstElement *pipeline, BusMuxHandler handler, gpointer user_data, GDestroyNotify notify) {
+  BusMuxEntry *entry;
+  guint id;
+
+  g_return_val_if_fail(GST_IS_ELEMENT(pipeline), 0);
+  g_return_val_if_fail(handler != NULL, 0);
+
+  entry = g_new0(BusMuxEntry, 1);
+  entry->ref_count = 1;
+  entry->bus = gst_element_get_bus(pipeline);
+  entry->handler = handler;
+  entry->user_data = user_data;
+  entry->notify = notify;
+  gst_bus_get_pollfd(entry->bus, &entry->pollfd);
+  entry->pollfd.events = G_IO_IN;
+
+  g_mutex_lock(&mux->lock);
+  do {
+    id = ++mux->next_id;
+  } while (id == BUS_MUX_CONTROL_ID || g_hash_table_contains(mux->entries, GUINT_TO_POINTER(id)));
+  g_hash_table_insert(mux->entries, GUINT_TO_POINTER(id), entry);
+  mux->changed = TRUE;
+
+#ifdef BUS_MUX_USE_EPOLL
+  if (mux->epoll_fd >= 0) {
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = id;
+    if (epoll_ctl(mux->epoll_fd, EPOLL_CTL_ADD, entry->pollfd.fd, &ev) < 0)
+      GST_WARNING_OBJECT(pipeline, "Could not watch the bus: %s", g_strerror(errno));
+  }
+#endif
+  g_mutex_unlock(&mux->lock);
+
+  bus_mux_wakeup_poll(mux);
+
+  return id;
+}
+
+void bus_mux_remove(BusMux *mux, guint id) {
+  BusMuxEntry *entry;
+
+  g_mutex_lock(&mux->lock);
+  entry = g_hash_table_lookup(mux->entries, GUINT_TO_POINTER(id));
+  if (entry == NULL) {
+    g_mutex_unlock(&mux->lock);
+    return;
+  }
+
+  g_hash_table_steal(mux->entries, GUINT_TO_POINTER(id));
+  g_atomic_int_set(&entry->removed, 1);
+  mux->changed = TRUE;
+
+#ifdef BUS_MUX_USE_EPOLL
+  if (mux->epoll_fd >= 0)
+    epoll_ctl(mux->epoll_fd, EPOLL_CTL_DEL, entry->pollfd.fd, NULL);
+#endif
+  g_mutex_unlock(&mux->lock);
+
+  bus_mux_wakeup_poll(mux);
+
+  /* A dispatch in progress holds its own reference, notify comes after it */
+  bus_mux_entry_unref(entry);
+}
+
+void bus_mux_run(BusMux *mux) {
+#ifdef BUS_MUX_USE_EPOLL
+  if (mux->epoll_fd >= 0)
+    bus_mux_run_epoll(mux);
+  else
+#endif
+    bus_mux_run_poll(mux);
+
+  /* Ready to be run again */
+  g_atomic_int_set(&mux->quit, 0);
+}
+
+void bus_mux_quit(BusMux *mux) {
+  g_atomic_int_set(&mux->quit, 1);
+  bus_mux_wakeup(mux);
+}
+
+void bus_mux_get_stats(BusMux *mux, BusMuxStats *stats) {
+  *stats = mux->stats;
+}
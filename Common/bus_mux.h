@@ -0,0 +1,46 @@
+#ifndef __COMMON_BUS_MUX_H__
+#define __COMMON_BUS_MUX_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Dispatches the bus messages of many pipelines from one thread.
+ *
+ * Every bus is watched through its file descriptor (gst_bus_get_pollfd()), with epoll on Linux and g_poll()
+ * elsewhere. When a bus is readable up to BUS_MUX_BATCH messages are popped and given to its handler before moving on
+ * to the next ready bus, so a chatty pipeline can't starve the others. The buses must not have a watch or a sync
+ * handler that drops messages. */
+#define BUS_MUX_BATCH 32
+
+/* Called from the dispatching thread, the message is unreffed afterwards */
+typedef void (*BusMuxHandler)(GstMessage *msg, gpointer user_data);
+
+typedef struct _BusMuxStats {
+  guint64 wakeups;  /* returns from epoll_wait()/g_poll() */
+  guint64 messages; /* messages dispatched */
+  guint max_batch;  /* most messages dispatched for one bus in one go */
+} BusMuxStats;
+
+typedef struct _BusMux BusMux;
+
+BusMux *bus_mux_new(void);
+
+/* Must not be called while bus_mux_run() is running */
+void bus_mux_free(BusMux *mux);
+
+/* Adding and removing can be done from any thread, handlers included. Returns the id for bus_mux_remove(). notify
+ * is called on user_data once the handler won't be called anymore. */
+guint bus_mux_add(BusMux *mux, GstElement *pipeline, BusMuxHandler handler, gpointer user_data, GDestroyNotify notify);
+void bus_mux_remove(BusMux *mux, guint id);
+
+/* Dispatches in the calling thread until bus_mux_quit() */
+void bus_mux_run(BusMux *mux);
+void bus_mux_quit(BusMux *mux);
+
+/* The counters are written without locking, while the dispatcher runs they are approximate */
+void bus_mux_get_stats(BusMux *mux, BusMuxStats *stats);
+
+G_END_DECLS
+
+#endif /* __COMMON_BUS_MUX_H__ */
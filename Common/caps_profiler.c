@@ -0,0 +1,432 @@
+#include "caps_profiler.h"
+
+#define MAX_CACHED_ANSWERS 8 // Filters remembered per pad
+
+typedef struct _CachedAnswer {
+  GstCaps *filter; /* NULL for queries without filter */
+  GstCaps *caps;
+} CachedAnswer;
+
+/* A pad with the probe */
+typedef struct _ProfiledPad {
+  CapsProfiler *profiler;
+  GstPad *pad;
+  gulong probe_id;
+
+  /* protected by the profiler lock */
+  GList *cache;         /* CachedAnswer */
+  GstState cache_state; /* of the element when the cache was filled */
+  CapsProfilerPadStats stats;
+} ProfiledPad;
+
+/* A query being answered, on a stack per thread since queries nest */
+typedef struct _PendingQuery {
+  GstPad *pad;
+  GstQuery *query;
+  GstClockTime start;
+  gboolean nested; /* the pad queried other pads to answer */
+} PendingQuery;
+
+struct _CapsProfiler {
+  GstElement *pipeline;
+  gboolean memoize;
+  gint enabled; /* between start and stop, accessed atomically */
+
+  GMutex lock;         /* protects everything below */
+  GHashTable *pads;    /* GstPad -> ProfiledPad */
+  GPtrArray *elements; /* elements we watch for new pads */
+};
+
+static GPrivate pending_key = G_PRIVATE_INIT((GDestroyNotify)g_array_unref);
+
+static void cached_answer_free(gpointer data) {
+  CachedAnswer *answer = data;
+
+  if (answer->filter)
+    gst_caps_unref(answer->filter);
+  gst_caps_unref(answer->caps);
+  g_free(answer);
+}
+
+static void pad_link_changed_cb(GstPad *pad, GstPad *peer, ProfiledPad *p);
+
+static void profiled_pad_free(gpointer data) {
+  ProfiledPad *p = data;
+
+  gst_pad_remove_probe(p->pad, p->probe_id);
+  g_signal_handlers_disconnect_by_func(p->pad, pad_link_changed_cb, p);
+  gst_object_unref(p->pad);
+  g_list_free_full(p->cache, cached_answer_free);
+  g_free(p->stats.name);
+  g_free(p);
+}
+
+static void pad_stats_free(gpointer data) {
+  CapsProfilerPadStats *stats = data;
+
+  g_free(stats->name);
+  g_free(stats);
+}
+
+static GArray *get_pending(void) {
+  GArray *pending = g_private_get(&pending_key);
+
+  if (!pending) {
+    pending = g_array_new(FALSE, FALSE, sizeof(PendingQuery));
+    g_private_set(&pending_key, pending);
+  }
+
+  return pending;
+}
+
+/* A caps query starts while the pad on top of the stack answers: that answer depends on other pads */
+static void mark_nested(void) {
+  GArray *pending = get_pending();
+
+  if (pending->len > 0)
+    g_array_index(pending, PendingQuery, pending->len - 1).nested = TRUE;
+}
+
+/* Returns how long the query took, GST_CLOCK_TIME_NONE if its start was not seen. Queries that failed never come
+ * back, the ones above the query are dropped with it. */
+static GstClockTime pop_pending(GstPad *pad, GstQuery *query, gboolean *nested) {
+  GArray *pending = get_pending();
+
+  for (gint i = (gint)pending->len - 1; i >= 0; i--) {
+    PendingQuery *q = &g_array_index(pending, PendingQuery, i);
+
+    if (q->pad == pad && q->query == query) {
+      GstClockTime elapsed = gst_util_get_timestamp() - q->start;
+
+      *nested = q->nested;
+      g_array_set_size(pending, i);
+      return elapsed;
+    }
+  }
+
+  *nested = TRUE;
+  return GST_CLOCK_TIME_NONE;
+}
+
+/* With the profiler lock */
+static void clear_cache(ProfiledPad *p) {
+  g_list_free_full(p->cache, cached_answer_free);
+  p->cache = NULL;
+}
+
+static void drop_cache(ProfiledPad *p) {
+  g_mutex_lock(&p->profiler->lock);
+  clear_cache(p);
+  g_mutex_unlock(&p->profiler->lock);
+}
+
+/* GST_STATE_VOID_PENDING for pads without element */
+static GstState pad_element_state(GstPad *pad) {
+  GstElement *element = gst_pad_get_parent_element(pad);
+  GstState state = GST_STATE_VOID_PENDING;
+
+  if (element) {
+    GST_OBJECT_LOCK(element);
+    state = GST_STATE(element);
+    GST_OBJECT_UNLOCK(element);
+    gst_object_unref(element);
+  }
+
+  return state;
+}
+
+/* With the profiler lock. Elements opening a device answer with their template before and with what the device
+ * supports after, so answers are only kept for the state the element was in when they were given. */
+static void check_cache_state(ProfiledPad *p, GstState state) {
+  if (p->cache_state != state) {
+    clear_cache(p);
+    p->cache_state = state;
+  }
+}
+
+/* Once linked or unlinked the pad may answer differently */
+static void pad_link_changed_cb(GstPad *pad, GstPad *peer, ProfiledPad *p) {
+  drop_cache(p);
+}
+
+static gboolean answer_from_cache(ProfiledPad *p, GstQuery *query) {
+  CapsProfiler *profiler = p->profiler;
+  GstState state = pad_element_state(p->pad);
+  GstCaps *filter;
+  gboolean hit = FALSE;
+
+  gst_query_parse_caps(query, &filter);
+
+  g_mutex_lock(&profiler->lock);
+  check_cache_state(p, state);
+  for (GList *l = p->cache; l && !hit; l = l->next) {
+    CachedAnswer *answer = l->data;
+
+    /* we hold a reference to the cached filter, the same pointer is the same caps */
+    if (answer->filter == filter || (answer->filter && filter && gst_caps_is_strictly_equal(answer->filter, filter))) {
+      gst_query_set_caps_result(query, answer->caps);
+      hit = TRUE;
+    }
+  }
+  if (hit && g_atomic_int_get(&profiler->enabled)) {
+    p->stats.caps_queries++;
+    p->stats.cache_hits++;
+  }
+  g_mutex_unlock(&profiler->lock);
+
+  return hit;
+}
+
+/* Keeps the answer if it is the template caps of the pad, which the pad will answer again for the same filter. Pads
+ * that forward the query, and pads that asked others to answer, depend on their peers and are never cached. */
+static void cache_answer(ProfiledPad *p, GstQuery *query) {
+  GstPadTemplate *templ;
+  GstCaps *filter, *caps, *templ_caps, *expected;
+  GstState state;
+
+  if (GST_PAD_IS_PROXY_CAPS(p->pad) || GST_IS_PROXY_PAD(p->pad))
+    return;
+
+  /* Devices are only opened from READY on, a template answer before that says nothing about later ones */
+  state = pad_element_state(p->pad);
+  if (state < GST_STATE_READY)
+    return;
+
+  templ = gst_pad_get_pad_template(p->pad);
+  if (!templ)
+    return;
+
+  gst_query_parse_caps(query, &filter);
+  gst_query_parse_caps_result(query, &caps);
+  templ_caps = gst_pad_template_get_caps(templ);
+  expected = filter ? gst_caps_intersect_full(filter, templ_caps, GST_CAPS_INTERSECT_FIRST) : gst_caps_ref(templ_caps);
+
+  if (caps && gst_caps_is_equal(expected, caps)) {
+    g_mutex_lock(&p->profiler->lock);
+    check_cache_state(p, state);
+    if (g_list_length(p->cache) < MAX_CACHED_ANSWERS) {
+      CachedAnswer *answer = g_new0(CachedAnswer, 1);
+
+      answer->filter = filter ? gst_caps_ref(filter) : NULL;
+      answer->caps = gst_caps_ref(caps);
+      p->cache = g_list_prepend(p->cache, answer);
+    }
+    g_mutex_unlock(&p->profiler->lock);
+  }
+
+  gst_caps_unref(expected);
+  gst_caps_unref(templ_caps);
+  gst_object_unref(templ);
+}
+
+static void record_answer(ProfiledPad *p, GstQuery *query, GstClockTime elapsed) {
+  CapsProfiler *profiler = p->profiler;
+
+  g_mutex_lock(&profiler->lock);
+  if (GST_QUERY_TYPE(query) == GST_QUERY_CAPS) {
+    GstCaps *filter, *caps;
+
+    gst_query_parse_caps(query, &filter);
+    gst_query_parse_caps_result(query, &caps);
+    p->stats.caps_queries++;
+    p->stats.caps_time += elapsed;
+    p->stats.intersect_work += (filter ? gst_caps_get_size(filter) : 1) * (caps ? gst_caps_get_size(caps) : 0);
+  } else {
+    gboolean accepted;
+
+    gst_query_parse_accept_caps_result(query, &accepted);
+    p->stats.accept_caps++;
+    p->stats.accept_time += elapsed;
+    if (!accepted)
+      p->stats.refused++;
+  }
+  g_mutex_unlock(&profiler->lock);
+}
+
+static GstPadProbeReturn pad_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  ProfiledPad *p = user_data;
+  CapsProfiler *profiler = p->profiler;
+  GstPadProbeType type = GST_PAD_PROBE_INFO_TYPE(info);
+  GstQuery *query;
+  GstClockTime elapsed;
+  gboolean answering, nested;
+
+  if (type & GST_PAD_PROBE_TYPE_EVENT_BOTH) {
+    /* From now on the element answers with its current caps, or what is downstream changed */
+    switch (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info))) {
+    case GST_EVENT_CAPS:
+    case GST_EVENT_RECONFIGURE:
+      drop_cache(p);
+      break;
+    default:
+      break;
+    }
+    return GST_PAD_PROBE_OK;
+  }
+
+  query = GST_PAD_PROBE_INFO_QUERY(info);
+  if (GST_QUERY_TYPE(query) != GST_QUERY_CAPS && GST_QUERY_TYPE(query) != GST_QUERY_ACCEPT_CAPS)
+    return GST_PAD_PROBE_OK;
+
+  if (type & GST_PAD_PROBE_TYPE_PUSH)
+    mark_nested();
+
+  /* The probes of the pad sending the query to its peer see it too: upstream queries are answered by source pads and
+   * downstream ones by sink pads */
+  answering = (type & GST_PAD_PROBE_TYPE_QUERY_UPSTREAM) ? GST_PAD_IS_SRC(pad) : GST_PAD_IS_SINK(pad);
+  if (!answering)
+    return GST_PAD_PROBE_OK;
+
+  if (type & GST_PAD_PROBE_TYPE_PUSH) {
+    if (profiler->memoize && GST_QUERY_TYPE(query) == GST_QUERY_CAPS && answer_from_cache(p, query))
+      return GST_PAD_PROBE_HANDLED;
+
+    /* Also while stopped, the cache needs to know whether the answer was nested */
+    if (g_atomic_int_get(&profiler->enabled) || profiler->memoize) {
+      PendingQuery q = {pad, query, gst_util_get_timestamp(), FALSE};
+
+      g_array_append_val(get_pending(), q);
+    }
+    return GST_PAD_PROBE_OK;
+  }
+
+  /* The answer is in the query now */
+  elapsed = pop_pending(pad, query, &nested);
+  if (GST_CLOCK_TIME_IS_VALID(elapsed) && g_atomic_int_get(&profiler->enabled))
+    record_answer(p, query, elapsed);
+  if (profiler->memoize && GST_QUERY_TYPE(query) == GST_QUERY_CAPS && !nested)
+    cache_answer(p, query);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void profile_pad(CapsProfiler *profiler, GstPad *pad) {
+  GstPadProbeType mask = GST_PAD_PROBE_TYPE_QUERY_BOTH;
+  ProfiledPad *p;
+
+  g_mutex_lock(&profiler->lock);
+  if (g_hash_table_contains(profiler->pads, pad)) {
+    g_mutex_unlock(&profiler->lock);
+    return;
+  }
+  p = g_new0(ProfiledPad, 1);
+  p->profiler = profiler;
+  p->pad = gst_object_ref(pad);
+  p->stats.name = g_strdup_printf("%s:%s", GST_DEBUG_PAD_NAME(pad));
+  g_hash_table_insert(profiler->pads, pad, p);
+  g_mutex_unlock(&profiler->lock);
+
+  if (profiler->memoize) {
+    mask |= GST_PAD_PROBE_TYPE_EVENT_BOTH;
+    g_signal_connect(pad, "linked", G_CALLBACK(pad_link_changed_cb), p);
+    g_signal_connect(pad, "unlinked", G_CALLBACK(pad_link_changed_cb), p);
+  }
+  p->probe_id = gst_pad_add_probe(pad, mask, pad_probe_cb, p, NULL);
+}
+
+static void pad_added_cb(GstElement *element, GstPad *pad, CapsProfiler *profiler) {
+  profile_pad(profiler, pad);
+}
+
+static void profile_element(CapsProfiler *profiler, GstElement *element) {
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+
+  g_mutex_lock(&profiler->lock);
+  g_ptr_array_add(profiler->elements, gst_object_ref(element));
+  g_mutex_unlock(&profiler->lock);
+  g_signal_connect(element, "pad-added", G_CALLBACK(pad_added_cb), profiler);
+
+  it = gst_element_iterate_pads(element);
+  while (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+    profile_pad(profiler, g_value_get_object(&item));
+    g_value_reset(&item);
+  }
+  g_value_unset(&item);
+  gst_iterator_free(it);
+}
+
+static void deep_element_added_cb(GstBin *bin, GstBin *sub_bin, GstElement *element, CapsProfiler *profiler) {
+  profile_element(profiler, element);
+}
+
+CapsProfiler *caps_profiler_new(GstElement *pipeline, gboolean memoize) {
+  CapsProfiler *profiler = g_new0(CapsProfiler, 1);
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+
+  profiler->pipeline = gst_object_ref(pipeline);
+  profiler->memoize = memoize;
+  g_mutex_init(&profiler->lock);
+  profiler->pads = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, profiled_pad_free);
+  profiler->elements = g_ptr_array_new_with_free_func(gst_object_unref);
+
+  /* Elements autoplugged later are seen when they are added */
+  g_signal_connect(pipeline, "deep-element-added", G_CALLBACK(deep_element_added_cb), profiler);
+  profile_element(profiler, pipeline);
+  it = gst_bin_iterate_recurse(GST_BIN(pipeline));
+  while (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+    profile_element(profiler, g_value_get_object(&item));
+    g_value_reset(&item);
+  }
+  g_value_unset(&item);
+  gst_iterator_free(it);
+
+  return profiler;
+}
+
+void caps_profiler_free(CapsProfiler *profiler) {
+  if (!profiler)
+    return;
+
+  g_signal_handlers_disconnect_by_func(profiler->pipeline, deep_element_added_cb, profiler);
+  for (guint i = 0; i < profiler->elements->len; i++)
+    g_signal_handlers_disconnect_by_func(g_ptr_array_index(profiler->elements, i), pad_added_cb, profiler);
+
+  g_hash_table_destroy(profiler->pads);
+  g_ptr_array_unref(profiler->elements);
+  g_mutex_clear(&profiler->lock);
+  gst_object_unref(profiler->pipeline);
+  g_free(profiler);
+}
+
+void caps_profiler_start(CapsProfiler *profiler) {
+  g_atomic_int_set(&profiler->enabled, 1);
+}
+
+void caps_profiler_stop(CapsProfiler *profiler) {
+  g_atomic_int_set(&profiler->enabled, 0);
+}
+
+static gint compare_time(gconstpointer a, gconstpointer b) {
+  const CapsProfilerPadStats *sa = *(const CapsProfilerPadStats **)a, *sb = *(const CapsProfilerPadStats **)b;
+  GstClockTime ta = sa->caps_time + sa->accept_time, tb = sb->caps_time + sb->accept_time;
+
+  return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+GPtrArray *caps_profiler_get_stats(CapsProfiler *profiler) {
+  GPtrArray *array = g_ptr_array_new_with_free_func(pad_stats_free);
+  GHashTableIter iter;
+  gpointer value;
+
+  g_mutex_lock(&profiler->lock);
+  g_hash_table_iter_init(&iter, profiler->pads);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    ProfiledPad *p = value;
+    CapsProfilerPadStats *stats;
+
+    if (p->stats.caps_queries == 0 && p->stats.accept_caps == 0)
+      continue;
+
+    stats = g_new(CapsProfilerPadStats, 1);
+    *stats = p->stats;
+    stats->name = g_strdup(p->stats.name);
+    g_ptr_array_add(array, stats);
+  }
+  g_mutex_unlock(&profiler->lock);
+
+  g_ptr_array_sort(array, compare_time);
+
+  return array;
+}
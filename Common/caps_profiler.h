@@ -0,0 +1,46 @@
+#ifndef __COMMON_CAPS_PROFILER_H__
+#define __COMMON_CAPS_PROFILER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Counts and times the caps negotiation of a pipeline, pad by pad.
+ *
+ * Every pad of the pipeline, including the ones of elements added later by autoplugging, gets a query probe. Between
+ * caps_profiler_start() and caps_profiler_stop(), usually around READY->PAUSED, the pad answering a CAPS or
+ * ACCEPT_CAPS query is charged with the time until its answer, which includes the queries it makes itself. The caps
+ * intersections can't be seen from outside of GStreamer: they are estimated as the number of structure pairs of the
+ * filter and the answer, which is what intersecting them costs.
+ *
+ * With memoize, a pad that answered a caps query with exactly its pad template caps (restricted to the filter) gets
+ * the same answer for the same filter from a cache, without running its query function. Only answers that can't
+ * depend on the peers are cached: not the ones of proxy-caps and ghost pads, nor the ones for which the pad queried
+ * other pads. Nothing is cached while the element is below READY, as elements opening a device answer with their
+ * template before and with the device caps after. The cache of a pad is dropped when its element changes state, when it
+ * is linked or unlinked, when a RECONFIGURE event reaches it and when caps go through it, as elements answer with their
+ * current caps from then on. */
+typedef struct _CapsProfiler CapsProfiler;
+
+typedef struct _CapsProfilerPadStats {
+  gchar *name;                  /* element:pad */
+  guint64 caps_queries;         /* answered, including from the cache */
+  guint64 cache_hits;
+  guint64 accept_caps, refused; /* accept-caps queries answered, and answered with FALSE */
+  guint64 intersect_work;       /* structure pairs of filter and answer */
+  GstClockTime caps_time, accept_time;
+} CapsProfilerPadStats;
+
+CapsProfiler *caps_profiler_new(GstElement *pipeline, gboolean memoize);
+/* Free it once the pipeline is in the NULL state, no query must be in flight */
+void caps_profiler_free(CapsProfiler *profiler);
+
+void caps_profiler_start(CapsProfiler *profiler);
+void caps_profiler_stop(CapsProfiler *profiler);
+
+/* The pads that answered queries, most time first. Free with g_ptr_array_unref(). */
+GPtrArray *caps_profiler_get_stats(CapsProfiler *profiler);
+
+G_END_DECLS
+
+#endif /* __COMMON_CAPS_PROFILER_H__ */
@@ -0,0 +1,123 @@
+#include <string.h>
+
+#include "feed_controller.h"
+
+/* pushes needed to fill max-bytes */
+#define CHUNKS_PER_FILL 4
+/* decisions are taken at most once per window */
+#define WINDOW (GST_SECOND)
+
+static guint feed_controller_chunk_for(FeedController *fc, guint64 max_bytes) {
+  guint64 chunk = max_bytes / CHUNKS_PER_FILL;
+
+  chunk = CLAMP(chunk, fc->min_chunk, fc->max_chunk);
+
+  return (guint)(chunk - chunk % fc->frame_size);
+}
+
+void feed_controller_init(FeedController *fc, guint byte_rate, guint frame_size, guint min_chunk, guint max_chunk,
+                          GstClockTime max_latency, gdouble target_cycle_rate) {
+  memset(fc, 0, sizeof(FeedController));
+  g_mutex_init(&fc->lock);
+
+  fc->frame_size = MAX(frame_size, 1);
+  fc->min_chunk = MAX(min_chunk, fc->frame_size);
+  fc->max_chunk = MAX(max_chunk, fc->min_chunk);
+  fc->max_latency = max_latency;
+  fc->target_cycle_rate = target_cycle_rate;
+
+  fc->stats.byte_rate = byte_rate;
+  fc->stats.chunk_size = feed_controller_chunk_for(fc, 0);
+  fc->stats.max_bytes = (guint64)fc->stats.chunk_size * CHUNKS_PER_FILL;
+  fc->window_start = gst_util_get_timestamp();
+}
+
+void feed_controller_clear(FeedController *fc) { g_mutex_clear(&fc->lock); }
+
+void feed_controller_need_data(FeedController *fc) {
+  g_mutex_lock(&fc->lock);
+  fc->stats.need_data++;
+  g_mutex_unlock(&fc->lock);
+}
+
+void feed_controller_pushed(FeedController *fc, gsize bytes) {
+  g_mutex_lock(&fc->lock);
+  fc->stats.pushes++;
+  fc->stats.bytes += bytes;
+  fc->window_bytes += bytes;
+  g_mutex_unlock(&fc->lock);
+}
+
+gboolean feed_controller_enough_data(FeedController *fc, guint *chunk_size, guint64 *max_bytes) {
+  GstClockTime now = gst_util_get_timestamp(), elapsed;
+  guint64 limit, wanted;
+  gboolean changed = FALSE;
+
+  g_mutex_lock(&fc->lock);
+  fc->stats.enough_data++;
+  fc->window_cycles++;
+
+  elapsed = now - fc->window_start;
+  if (elapsed < WINDOW)
+    goto done;
+
+  /* everything pushed in the window was consumed, give or take one max-bytes */
+  fc->stats.cycle_rate = fc->window_cycles / ((gdouble)elapsed / GST_SECOND);
+  fc->stats.byte_rate = fc->window_bytes / ((gdouble)elapsed / GST_SECOND);
+  fc->window_start = now;
+  fc->window_cycles = 0;
+  fc->window_bytes = 0;
+
+  /* bytes that can wait in appsrc without exceeding the latency bound, at least one minimal fill */
+  limit = (guint64)(fc->stats.byte_rate * fc->max_latency / GST_SECOND);
+  limit = MAX(limit, (guint64)fc->min_chunk * CHUNKS_PER_FILL);
+
+  if (fc->stats.max_bytes > limit) {
+    wanted = limit;
+    fc->stats.shrinks++;
+  } else if (fc->stats.cycle_rate > fc->target_cycle_rate && fc->stats.max_bytes * 2 <= limit) {
+    wanted = fc->stats.max_bytes * 2;
+    fc->stats.grows++;
+  } else {
+    goto done;
+  }
+
+  fc->stats.max_bytes = wanted;
+  fc->stats.chunk_size = feed_controller_chunk_for(fc, wanted);
+  changed = TRUE;
+
+done:
+  if (chunk_size)
+    *chunk_size = fc->stats.chunk_size;
+  if (max_bytes)
+    *max_bytes = fc->stats.max_bytes;
+  g_mutex_unlock(&fc->lock);
+
+  return changed;
+}
+
+guint feed_controller_get_chunk_size(FeedController *fc) {
+  guint chunk_size;
+
+  g_mutex_lock(&fc->lock);
+  chunk_size = fc->stats.chunk_size;
+  g_mutex_unlock(&fc->lock);
+
+  return chunk_size;
+}
+
+guint64 feed_controller_get_max_bytes(FeedController *fc) {
+  guint64 max_bytes;
+
+  g_mutex_lock(&fc->lock);
+  max_bytes = fc->stats.max_bytes;
+  g_mutex_unlock(&fc->lock);
+
+  return max_bytes;
+}
+
+void feed_controller_get_stats(FeedController *fc, FeedControllerStats *stats) {
+  g_mutex_lock(&fc->lock);
+  *stats = fc->stats;
+  g_mutex_unlock(&fc->lock);
+}
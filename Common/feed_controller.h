@@ -0,0 +1,58 @@
+#ifndef __COMMON_FEED_CONTROLLER_H__
+#define __COMMON_FEED_CONTROLLER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Adapts the chunk size and max-bytes of an appsrc fed through need-data/enough-data.
+ *
+ * Every need-data/enough-data pair is one fill cycle of the appsrc queue, and every chunk is one push. Once per window
+ * the controller compares the cycle rate with its target and the queued time (max-bytes at the measured consumption
+ * rate) with the latency bound:
+ *  - over the latency bound, max-bytes and the chunk size shrink to fit it again
+ *  - cycling faster than the target, max-bytes doubles as long as it stays within the bound
+ * The chunk size follows max-bytes, so that a fill always takes the same number of pushes. */
+typedef struct _FeedControllerStats {
+  guint64 need_data, enough_data; /* signals seen */
+  guint64 pushes, bytes;          /* chunks and bytes pushed */
+  guint64 grows, shrinks;         /* decisions taken */
+  gdouble cycle_rate;             /* fill cycles per second in the last window */
+  gdouble byte_rate;              /* bytes consumed per second in the last window */
+  guint chunk_size;
+  guint64 max_bytes;
+} FeedControllerStats;
+
+typedef struct _FeedController {
+  GMutex lock;
+
+  /* configuration */
+  guint min_chunk, max_chunk, frame_size;
+  GstClockTime max_latency;
+  gdouble target_cycle_rate;
+
+  /* current window */
+  GstClockTime window_start;
+  guint64 window_cycles, window_bytes;
+
+  FeedControllerStats stats;
+} FeedController;
+
+/* byte_rate is the expected consumption rate until it has been measured, chunks are multiples of frame_size */
+void feed_controller_init(FeedController *fc, guint byte_rate, guint frame_size, guint min_chunk, guint max_chunk,
+                          GstClockTime max_latency, gdouble target_cycle_rate);
+void feed_controller_clear(FeedController *fc);
+
+void feed_controller_need_data(FeedController *fc);
+void feed_controller_pushed(FeedController *fc, gsize bytes);
+
+/* Returns TRUE when the chunk size or max-bytes changed, they are then returned through the pointers */
+gboolean feed_controller_enough_data(FeedController *fc, guint *chunk_size, guint64 *max_bytes);
+
+guint feed_controller_get_chunk_size(FeedController *fc);
+guint64 feed_controller_get_max_bytes(FeedController *fc);
+void feed_controller_get_stats(FeedController *fc, FeedControllerStats *stats);
+
+G_END_DECLS
+
+#endif /* __COMMON_FEED_CONTROLLER_H__ */
@@ -0,0 +1,368 @@
+#include "keyframe_index.h"
+
+#include <glib/gstdio.h>
+#include <gst/app/gstappsink.h>
+#include <string.h>
+
+#define KEYFRAME_INDEX_MAGIC "GKFI"
+#define KEYFRAME_INDEX_VERSION 2
+#define SCAN_POLL_INTERVAL (100 * GST_MSECOND) // How often the scan checks the bus while no buffer arrives
+#define SCAN_MAX_BUFFERS 64                     // Buffers queued in the appsink, bounds the memory of fast sources
+
+typedef struct _KeyframeIndexHeader {
+  gchar magic[4];
+  guint32 version;
+  guint64 n_entries;
+  gint64 source_mtime; /* modification time of a local source, 0 otherwise */
+} KeyframeIndexHeader;
+
+struct _KeyframeIndex {
+  GArray *entries; /* KeyframeEntry, sorted by stream time */
+  gint64 source_mtime;
+};
+
+typedef struct _ScanData {
+  GstElement *pipeline;
+  GstElement *parsebin;
+  GstElement *appsink;
+  gint video_linked; /* set once the first video stream reached the appsink */
+  gint no_more_pads;
+  const gint *cancel; /* set by the caller to stop the scan, may be NULL */
+} ScanData;
+
+static void scan_source_pad_added(GstElement *source, GstPad *pad, ScanData *scan) {
+  GstPad *sinkpad = gst_element_get_static_pad(scan->parsebin, "sink");
+
+  if (!gst_pad_is_linked(sinkpad) && GST_PAD_LINK_FAILED(gst_pad_link(pad, sinkpad)))
+    GST_WARNING_OBJECT(pad, "Could not link to parsebin");
+
+  gst_object_unref(sinkpad);
+}
+
+static void scan_parse_pad_added(GstElement *parsebin, GstPad *pad, ScanData *scan) {
+  GstCaps *caps;
+  GstElement *fakesink;
+  GstPad *sinkpad;
+  gboolean is_video;
+
+  caps = gst_pad_get_current_caps(pad);
+  if (!caps)
+    caps = gst_pad_query_caps(pad, NULL);
+  is_video = g_str_has_prefix(gst_structure_get_name(gst_caps_get_structure(caps, 0)), "video/");
+  gst_caps_unref(caps);
+
+  /* The first video stream is indexed */
+  if (is_video && g_atomic_int_compare_and_exchange(&scan->video_linked, 0, 1)) {
+    sinkpad = gst_element_get_static_pad(scan->appsink, "sink");
+    if (GST_PAD_LINK_FAILED(gst_pad_link(pad, sinkpad))) {
+      GST_WARNING_OBJECT(pad, "Could not link to the appsink");
+      g_atomic_int_set(&scan->video_linked, 0);
+    }
+    gst_object_unref(sinkpad);
+
+    return;
+  }
+
+  /* Everything else is thrown away, as fast as it comes */
+  fakesink = gst_element_factory_make("fakesink", NULL);
+  g_object_set(fakesink, "sync", FALSE, "async", FALSE, NULL);
+  gst_bin_add(GST_BIN(scan->pipeline), fakesink);
+  gst_element_sync_state_with_parent(fakesink);
+
+  sinkpad = gst_element_get_static_pad(fakesink, "sink");
+  gst_pad_link(pad, sinkpad);
+  gst_object_unref(sinkpad);
+}
+
+static void scan_no_more_pads(GstElement *parsebin, ScanData *scan) {
+  g_atomic_int_set(&scan->no_more_pads, 1);
+}
+
+static gint compare_entries(gconstpointer a, gconstpointer b) {
+  const KeyframeEntry *entry_a = a, *entry_b = b;
+
+  return entry_a->stream_time < entry_b->stream_time ? -1 : (entry_a->stream_time > entry_b->stream_time ? 1 : 0);
+}
+
+/* Pulls every video buffer until EOS, keeps the keyframes */
+static gboolean scan_run(ScanData *scan, GArray *entries, GError **error) {
+  GstBus *bus = gst_element_get_bus(scan->pipeline);
+  gboolean ret = TRUE;
+
+  while (TRUE) {
+    GstSample *sample;
+    GstMessage *msg;
+
+    if (scan->cancel && g_atomic_int_get(scan->cancel)) {
+      g_set_error(error, GST_CORE_ERROR, GST_CORE_ERROR_FAILED, "Keyframe scan cancelled");
+      ret = FALSE;
+      break;
+    }
+
+    sample = gst_app_sink_try_pull_sample(GST_APP_SINK(scan->appsink), SCAN_POLL_INTERVAL);
+
+    if (sample) {
+      GstBuffer *buffer = gst_sample_get_buffer(sample);
+      const GstSegment *segment = gst_sample_get_segment(sample);
+      GstClockTime pts = GST_BUFFER_PTS_IS_VALID(buffer) ? GST_BUFFER_PTS(buffer) : GST_BUFFER_DTS(buffer);
+
+      if (!GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT) && GST_CLOCK_TIME_IS_VALID(pts) && segment &&
+          segment->format == GST_FORMAT_TIME) {
+        KeyframeEntry entry;
+
+        /* NONE when the keyframe is outside of the segment */
+        entry.stream_time = gst_segment_to_stream_time(segment, GST_FORMAT_TIME, pts);
+        if (GST_CLOCK_TIME_IS_VALID(entry.stream_time))
+          g_array_append_val(entries, entry);
+      }
+      gst_sample_unref(sample);
+
+      continue;
+    }
+
+    if (gst_app_sink_is_eos(GST_APP_SINK(scan->appsink)))
+      break;
+
+    if (g_atomic_int_get(&scan->no_more_pads) && !g_atomic_int_get(&scan->video_linked)) {
+      g_set_error(error, GST_STREAM_ERROR, GST_STREAM_ERROR_WRONG_TYPE, "No video stream to index");
+      ret = FALSE;
+      break;
+    }
+
+    msg = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+    if (msg) {
+      if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+        gst_message_parse_error(msg, error, NULL);
+        ret = FALSE;
+      }
+      gst_message_unref(msg);
+      break;
+    }
+  }
+
+  gst_object_unref(bus);
+
+  return ret;
+}
+
+KeyframeIndex *keyframe_index_build(const gchar *uri, const gint *cancel, GError **error) {
+  ScanData scan;
+  GstElement *source;
+  GArray *entries;
+  KeyframeIndex *index;
+  gboolean ret;
+
+  g_return_val_if_fail(uri != NULL, NULL);
+
+  memset(&scan, 0, sizeof(scan));
+  scan.cancel = cancel;
+  source = gst_element_factory_make("urisourcebin", NULL);
+  scan.parsebin = gst_element_factory_make("parsebin", NULL);
+  scan.appsink = gst_element_factory_make("appsink", NULL);
+  if (!source || !scan.parsebin || !scan.appsink) {
+    g_set_error(error, GST_CORE_ERROR, GST_CORE_ERROR_MISSING_PLUGIN, "urisourcebin, parsebin and appsink are needed");
+    g_clear_object(&source);
+    g_clear_object(&scan.parsebin);
+    g_clear_object(&scan.appsink);
+
+    return NULL;
+  }
+
+  scan.pipeline = gst_pipeline_new("keyframe-scan");
+  g_object_set(source, "uri", uri, NULL);
+  g_object_set(scan.appsink, "sync", FALSE, "max-buffers", SCAN_MAX_BUFFERS, NULL);
+  gst_bin_add_many(GST_BIN(scan.pipeline), source, scan.parsebin, scan.appsink, NULL);
+  g_signal_connect(source, "pad-added", G_CALLBACK(scan_source_pad_added), &scan);
+  g_signal_connect(scan.parsebin, "pad-added", G_CALLBACK(scan_parse_pad_added), &scan);
+  g_signal_connect(scan.parsebin, "no-more-pads", G_CALLBACK(scan_no_more_pads), &scan);
+
+  entries = g_array_new(FALSE, FALSE, sizeof(KeyframeEntry));
+  if (gst_element_set_state(scan.pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_set_error(error, GST_CORE_ERROR, GST_CORE_ERROR_STATE_CHANGE, "Could not start scanning %s", uri);
+    ret = FALSE;
+  } else {
+    ret = scan_run(&scan, entries, error);
+  }
+
+  gst_element_set_state(scan.pipeline, GST_STATE_NULL);
+  gst_object_unref(scan.pipeline);
+
+  if (ret && entries->len == 0) {
+    g_set_error(error, GST_STREAM_ERROR, GST_STREAM_ERROR_DEMUX, "No keyframe found in %s", uri);
+    ret = FALSE;
+  }
+
+  if (!ret) {
+    g_array_free(entries, TRUE);
+    return NULL;
+  }
+
+  /* Keyframes come in decoding order */
+  g_array_sort(entries, compare_entries);
+
+  index = g_new0(KeyframeIndex, 1);
+  index->entries = entries;
+  GST_DEBUG("Indexed %u keyframes of %s", entries->len, uri);
+
+  return index;
+}
+
+KeyframeIndex *keyframe_index_load(const gchar *filename, GError **error) {
+  KeyframeIndexHeader header;
+  KeyframeIndex *index;
+  gchar *contents;
+  gsize size;
+
+  if (!g_file_get_contents(filename, &contents, &size, error))
+    return NULL;
+
+  if (size < sizeof(header)) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a keyframe index", filename);
+    g_free(contents);
+    return NULL;
+  }
+
+  memcpy(&header, contents, sizeof(header));
+  if (memcmp(header.magic, KEYFRAME_INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != KEYFRAME_INDEX_VERSION ||
+      header.n_entries != (size - sizeof(header)) / sizeof(KeyframeEntry) ||
+      (size - sizeof(header)) % sizeof(KeyframeEntry) != 0) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a keyframe index of this version", filename);
+    g_free(contents);
+    return NULL;
+  }
+
+  index = g_new0(KeyframeIndex, 1);
+  index->source_mtime = header.source_mtime;
+  index->entries = g_array_sized_new(FALSE, FALSE, sizeof(KeyframeEntry), header.n_entries);
+  g_array_append_vals(index->entries, contents + sizeof(header), header.n_entries);
+  g_free(contents);
+
+  return index;
+}
+
+gboolean keyframe_index_save(KeyframeIndex *index, const gchar *filename, GError **error) {
+  KeyframeIndexHeader header;
+  gsize entries_size = index->entries->len * sizeof(KeyframeEntry);
+  gchar *contents;
+  gboolean ret;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, KEYFRAME_INDEX_MAGIC, sizeof(header.magic));
+  header.version = KEYFRAME_INDEX_VERSION;
+  header.n_entries = index->entries->len;
+  header.source_mtime = index->source_mtime;
+
+  contents = g_malloc(sizeof(header) + entries_size);
+  memcpy(contents, &header, sizeof(header));
+  memcpy(contents + sizeof(header), index->entries->data, entries_size);
+  ret = g_file_set_contents(filename, contents, sizeof(header) + entries_size, error);
+  g_free(contents);
+
+  return ret;
+}
+
+KeyframeIndex *keyframe_index_get(const gchar *uri, const gint *cancel, GError **error) {
+  KeyframeIndex *index;
+  GError *err = NULL;
+  gchar *checksum, *name, *dir, *filename, *path;
+  gint64 mtime = 0;
+  GStatBuf st;
+
+  path = g_filename_from_uri(uri, NULL, NULL);
+  if (path && g_stat(path, &st) == 0)
+    mtime = st.st_mtime;
+  g_free(path);
+
+  checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, uri, -1);
+  name = g_strconcat(checksum, ".kfi", NULL);
+  dir = g_build_filename(g_get_user_cache_dir(), "gstreamer-tutorial", "keyframes", NULL);
+  filename = g_build_filename(dir, name, NULL);
+  g_free(checksum);
+  g_free(name);
+
+  index = keyframe_index_load(filename, NULL);
+  if (index && index->source_mtime != mtime)
+    g_clear_pointer(&index, keyframe_index_free);
+
+  if (!index) {
+    index = keyframe_index_build(uri, cancel, error);
+    if (index) {
+      index->source_mtime = mtime;
+      g_mkdir_with_parents(dir, 0755);
+      if (!keyframe_index_save(index, filename, &err)) {
+        GST_WARNING("Could not save the keyframe index: %s", err->message);
+        g_clear_error(&err);
+      }
+    }
+  }
+
+  g_free(dir);
+  g_free(filename);
+
+  return index;
+}
+
+void keyframe_index_free(KeyframeIndex *index) {
+  if (index == NULL)
+    return;
+
+  g_array_free(index->entries, TRUE);
+  g_free(index);
+}
+
+guint keyframe_index_get_n_entries(KeyframeIndex *index) {
+  return index->entries->len;
+}
+
+const KeyframeEntry *keyframe_index_get_entry(KeyframeIndex *index, guint i) {
+  g_return_val_if_fail(i < index->entries->len, NULL);
+
+  return &g_array_index(index->entries, KeyframeEntry, i);
+}
+
+const KeyframeEntry *keyframe_index_lookup(KeyframeIndex *index, GstClockTime position, GstSeekFlags snap) {
+  const KeyframeEntry *entries = (const KeyframeEntry *)index->entries->data;
+  const KeyframeEntry *before, *after;
+  guint lo = 0, hi = index->entries->len;
+
+  /* lo ends as the number of keyframes at or before position */
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+
+    if (entries[mid].stream_time <= position)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  before = lo > 0 ? &entries[lo - 1] : NULL;
+  if (before && before->stream_time == position)
+    after = before;
+  else
+    after = lo < index->entries->len ? &entries[lo] : NULL;
+
+  if ((snap & GST_SEEK_FLAG_SNAP_NEAREST) == GST_SEEK_FLAG_SNAP_NEAREST) {
+    if (!before || !after)
+      return before ? before : after;
+
+    return position - before->stream_time <= after->stream_time - position ? before : after;
+  }
+
+  return (snap & GST_SEEK_FLAG_SNAP_AFTER) ? after : before;
+}
+
+gboolean keyframe_index_seek(KeyframeIndex *index, GstElement *element, GstClockTime position, GstSeekFlags snap) {
+  const KeyframeEntry *entry = index ? keyframe_index_lookup(index, position, snap) : NULL;
+  GstSeekFlags flags = GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | snap;
+
+  if (!entry) {
+    GST_DEBUG_OBJECT(element, "No keyframe known around %" GST_TIME_FORMAT, GST_TIME_ARGS(position));
+    return gst_element_seek_simple(element, GST_FORMAT_TIME, flags, position);
+  }
+
+  GST_DEBUG_OBJECT(element, "Seeking to the keyframe at %" GST_TIME_FORMAT " for %" GST_TIME_FORMAT,
+                   GST_TIME_ARGS(entry->stream_time), GST_TIME_ARGS(position));
+
+  return gst_element_seek_simple(element, GST_FORMAT_TIME, flags, entry->stream_time);
+}
@@ -0,0 +1,52 @@
+#ifndef __COMMON_KEYFRAME_INDEX_H__
+#define __COMMON_KEYFRAME_INDEX_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Sorted keyframe stream times of the first video stream of a file, so seeks can target a known keyframe.
+ *
+ * The index is built once with a urisourcebin ! parsebin pass that sends the video stream to an appsink as fast as the
+ * source allows, nothing is decoded. Every buffer without GST_BUFFER_FLAG_DELTA_UNIT is a keyframe, its PTS (DTS when
+ * it has none) is turned into stream time with the segment it came in, which is what positions and seeks use. Keyframes
+ * outside of the segment, that the demuxer only sends to decode the first frames, are left out.
+ *
+ * It is a time index only: positions in bytes are left to the demuxer, GST_BUFFER_OFFSET means something else for
+ * every parser and is not kept.
+ *
+ * Saved indexes are a small header followed by the entries, in host byte order. */
+typedef struct _KeyframeEntry {
+  guint64 stream_time;
+} KeyframeEntry;
+
+typedef struct _KeyframeIndex KeyframeIndex;
+
+/* Scans uri, blocking until the whole video stream went through. Another thread can stop the scan by setting *cancel
+ * (may be NULL) with g_atomic_int_set(), it is checked for every buffer and at least every 100ms. */
+KeyframeIndex *keyframe_index_build(const gchar *uri, const gint *cancel, GError **error);
+
+KeyframeIndex *keyframe_index_load(const gchar *filename, GError **error);
+gboolean keyframe_index_save(KeyframeIndex *index, const gchar *filename, GError **error);
+
+/* Loads the index of uri from the user cache directory, or builds and saves it there. For local files an index older
+ * than the file is built again. */
+KeyframeIndex *keyframe_index_get(const gchar *uri, const gint *cancel, GError **error);
+
+void keyframe_index_free(KeyframeIndex *index);
+
+guint keyframe_index_get_n_entries(KeyframeIndex *index);
+const KeyframeEntry *keyframe_index_get_entry(KeyframeIndex *index, guint i);
+
+/* Finds the keyframe at or before position (GST_SEEK_FLAG_SNAP_BEFORE), at or after it (GST_SEEK_FLAG_SNAP_AFTER) or
+ * the closest one (both flags). Returns NULL when there is no keyframe on that side. */
+const KeyframeEntry *keyframe_index_lookup(KeyframeIndex *index, GstClockTime position, GstSeekFlags snap);
+
+/* Flushing seek of element to the keyframe found by keyframe_index_lookup(). The target is already a keyframe, so the
+ * demuxer doesn't have to search for one. Without a keyframe on that side it falls back to a KEY_UNIT seek to
+ * position. */
+gboolean keyframe_index_seek(KeyframeIndex *index, GstElement *element, GstClockTime position, GstSeekFlags snap);
+
+G_END_DECLS
+
+#endif /* __COMMON_KEYFRAME_INDEX_H__ */
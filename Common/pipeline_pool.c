@@ -0,0 +1,213 @@
+#include "pipeline_pool.h"
+
+#define WARMUP_TIMEOUT (5 * GST_SECOND) // Longest wait for a warmup preroll
+
+struct _PipelinePool {
+  gchar *description;
+  gchar *warmup_uri;
+  guint size;
+
+  GMutex lock; /* protects everything below */
+  GCond cond;  /* signals the builder thread */
+  GQueue idle; /* GstElement in READY */
+  gboolean stopping;
+  GThread *builder;
+
+  PipelinePoolStats stats;
+};
+
+static void pipeline_pool_reset(GstElement *pipeline) {
+  GstBus *bus = gst_element_get_bus(pipeline);
+
+  /* Nothing of the previous run must reach the next user */
+  gst_bus_set_flushing(bus, TRUE);
+  gst_bus_set_flushing(bus, FALSE);
+  gst_object_unref(bus);
+}
+
+static void pipeline_pool_set_uri(GstElement *pipeline, const gchar *uri) {
+  if (uri && g_object_class_find_property(G_OBJECT_GET_CLASS(pipeline), "uri"))
+    g_object_set(pipeline, "uri", uri, NULL);
+}
+
+static GstElement *pipeline_pool_build(PipelinePool *pool, GError **error) {
+  GstElement *pipeline;
+  GError *err = NULL;
+
+  pipeline = gst_parse_launch(pool->description, &err);
+  if (!pipeline) {
+    g_propagate_error(error, err);
+    return NULL;
+  }
+  if (err) {
+    /* Recoverable, like a missing property */
+    GST_WARNING("Building '%s': %s", pool->description, err->message);
+    g_clear_error(&err);
+  }
+
+  if (gst_element_set_state(pipeline, GST_STATE_READY) == GST_STATE_CHANGE_FAILURE) {
+    g_set_error(error, GST_CORE_ERROR, GST_CORE_ERROR_STATE_CHANGE, "Could not set '%s' to READY", pool->description);
+    gst_object_unref(pipeline);
+    return NULL;
+  }
+
+  if (pool->warmup_uri) {
+    pipeline_pool_set_uri(pipeline, pool->warmup_uri);
+    if (gst_element_set_state(pipeline, GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE)
+      gst_element_get_state(pipeline, NULL, NULL, WARMUP_TIMEOUT);
+    gst_element_set_state(pipeline, GST_STATE_READY);
+    pipeline_pool_reset(pipeline);
+  }
+
+  return pipeline;
+}
+
+/* Keeps size pipelines idle */
+static gpointer pipeline_pool_builder(PipelinePool *pool) {
+  g_mutex_lock(&pool->lock);
+  while (!pool->stopping) {
+    GstElement *pipeline;
+    GError *err = NULL;
+
+    if (g_queue_get_length(&pool->idle) >= pool->size) {
+      g_cond_wait(&pool->cond, &pool->lock);
+      continue;
+    }
+
+    g_mutex_unlock(&pool->lock);
+    pipeline = pipeline_pool_build(pool, &err);
+    g_mutex_lock(&pool->lock);
+
+    if (!pipeline) {
+      GST_WARNING("Could not build '%s': %s", pool->description, err->message);
+      g_clear_error(&err);
+      /* Don't spin on a description that stopped working, try again on the next acquire */
+      g_cond_wait(&pool->cond, &pool->lock);
+      continue;
+    }
+
+    if (pool->stopping || g_queue_get_length(&pool->idle) >= pool->size) {
+      /* Releases filled the pool meanwhile */
+      g_mutex_unlock(&pool->lock);
+      gst_element_set_state(pipeline, GST_STATE_NULL);
+      gst_object_unref(pipeline);
+      g_mutex_lock(&pool->lock);
+      continue;
+    }
+
+    g_queue_push_tail(&pool->idle, pipeline);
+    pool->stats.built++;
+  }
+  g_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+PipelinePool *pipeline_pool_new(const gchar *description, guint size, const gchar *warmup_uri, GError **error) {
+  PipelinePool *pool;
+  GstElement *first;
+
+  g_return_val_if_fail(description != NULL, NULL);
+  g_return_val_if_fail(size > 0, NULL);
+
+  pool = g_new0(PipelinePool, 1);
+  pool->description = g_strdup(description);
+  pool->warmup_uri = g_strdup(warmup_uri);
+  pool->size = size;
+  g_mutex_init(&pool->lock);
+  g_cond_init(&pool->cond);
+  g_queue_init(&pool->idle);
+
+  /* The first one is built here, so a broken description is reported to the caller */
+  first = pipeline_pool_build(pool, error);
+  if (!first) {
+    pipeline_pool_free(pool);
+    return NULL;
+  }
+  g_queue_push_tail(&pool->idle, first);
+  pool->stats.built++;
+
+  pool->builder = g_thread_new("pipeline-pool", (GThreadFunc)pipeline_pool_builder, pool);
+
+  return pool;
+}
+
+void pipeline_pool_free(PipelinePool *pool) {
+  GstElement *pipeline;
+
+  if (pool == NULL)
+    return;
+
+  if (pool->builder) {
+    g_mutex_lock(&pool->lock);
+    pool->stopping = TRUE;
+    g_cond_signal(&pool->cond);
+    g_mutex_unlock(&pool->lock);
+    g_thread_join(pool->builder);
+  }
+
+  while ((pipeline = g_queue_pop_head(&pool->idle)) != NULL) {
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+  }
+
+  g_cond_clear(&pool->cond);
+  g_mutex_clear(&pool->lock);
+  g_free(pool->description);
+  g_free(pool->warmup_uri);
+  g_free(pool);
+}
+
+GstElement *pipeline_pool_acquire(PipelinePool *pool, const gchar *uri, GError **error) {
+  GstElement *pipeline;
+
+  g_mutex_lock(&pool->lock);
+  pipeline = g_queue_pop_head(&pool->idle);
+  if (pipeline)
+    pool->stats.hits++;
+  else
+    pool->stats.misses++;
+  g_cond_signal(&pool->cond);
+  g_mutex_unlock(&pool->lock);
+
+  /* Empty pool, the user pays for the build this time */
+  if (!pipeline) {
+    pipeline = pipeline_pool_build(pool, error);
+    if (!pipeline)
+      return NULL;
+  }
+
+  pipeline_pool_set_uri(pipeline, uri);
+
+  return pipeline;
+}
+
+void pipeline_pool_release(PipelinePool *pool, GstElement *pipeline) {
+  gboolean keep;
+
+  /* Going down never waits for the streaming threads to preroll */
+  keep = gst_element_set_state(pipeline, GST_STATE_READY) == GST_STATE_CHANGE_SUCCESS;
+  if (keep)
+    pipeline_pool_reset(pipeline);
+
+  g_mutex_lock(&pool->lock);
+  keep = keep && !pool->stopping && g_queue_get_length(&pool->idle) < pool->size;
+  if (keep) {
+    g_queue_push_tail(&pool->idle, pipeline);
+    pool->stats.released++;
+  } else {
+    pool->stats.discarded++;
+  }
+  g_mutex_unlock(&pool->lock);
+
+  if (!keep) {
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+  }
+}
+
+void pipeline_pool_get_stats(PipelinePool *pool, PipelinePoolStats *stats) {
+  g_mutex_lock(&pool->lock);
+  *stats = pool->stats;
+  g_mutex_unlock(&pool->lock);
+}
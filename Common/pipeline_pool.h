@@ -0,0 +1,42 @@
+#ifndef __COMMON_PIPELINE_POOL_H__
+#define __COMMON_PIPELINE_POOL_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Keeps pipelines built from the same description ready to be handed out, so parsing, plugin loading and element
+ * creation are not paid when playback is requested.
+ *
+ * Idle pipelines wait in READY. They can't preroll before they know their URI, but with a warmup URI every new
+ * pipeline prerolls it once, which loads the demuxer, decoder and sink plugins the later media will likely need. A
+ * thread builds new pipelines in the background whenever fewer than size are idle. */
+typedef struct _PipelinePoolStats {
+  guint64 hits;      /* acquired pipelines that were idle in the pool */
+  guint64 misses;    /* acquired pipelines built on the spot because the pool was empty */
+  guint64 built;     /* pipelines built by the background thread */
+  guint64 released;  /* pipelines that went back into the pool */
+  guint64 discarded; /* released pipelines dropped, the pool was full or they didn't reset */
+} PipelinePoolStats;
+
+typedef struct _PipelinePool PipelinePool;
+
+/* description is given to gst_parse_launch(), "playbin" for example. warmup_uri may be NULL. Fails if the description
+ * can't be built. */
+PipelinePool *pipeline_pool_new(const gchar *description, guint size, const gchar *warmup_uri, GError **error);
+
+/* Frees the idle pipelines, the ones handed out belong to their users */
+void pipeline_pool_free(PipelinePool *pool);
+
+/* Returns a pipeline in READY with its "uri" property set (if it has one and uri is not NULL) */
+GstElement *pipeline_pool_acquire(PipelinePool *pool, const gchar *uri, GError **error);
+
+/* Takes the pipeline back: it goes to READY and its bus is flushed. Only the URI is set again by the next acquire,
+ * other properties changed by the user stay as they are. */
+void pipeline_pool_release(PipelinePool *pool, GstElement *pipeline);
+
+void pipeline_pool_get_stats(PipelinePool *pool, PipelinePoolStats *stats);
+
+G_END_DECLS
+
+#endif /* __COMMON_PIPELINE_POOL_H__ */
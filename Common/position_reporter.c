@@ -0,0 +1,169 @@
+#include "position_reporter.h"
+
+struct _PositionReporter {
+  gint ref_count; /* one for the application, one for each scheduled clock id */
+
+  GstElement *pipeline;
+  GstClockTime interval;
+
+  GMutex lock; /* protects everything below */
+  GstClockID clock_id;
+  GstClockTime duration; /* cached, GST_CLOCK_TIME_NONE until queried again */
+  gboolean stopped;
+};
+
+static PositionReporter *position_reporter_ref(PositionReporter *reporter) {
+  g_atomic_int_inc(&reporter->ref_count);
+
+  return reporter;
+}
+
+static void position_reporter_unref(PositionReporter *reporter) {
+  if (!g_atomic_int_dec_and_test(&reporter->ref_count))
+    return;
+
+  gst_object_unref(reporter->pipeline);
+  g_mutex_clear(&reporter->lock);
+  g_free(reporter);
+}
+
+/* Called from the clock thread at every interval */
+static gboolean position_reporter_tick(GstClock *clock, GstClockTime time, GstClockID id, gpointer user_data) {
+  PositionReporter *reporter = user_data;
+  GstClockTime duration;
+  gint64 position, queried;
+  GstStructure *s;
+
+  g_mutex_lock(&reporter->lock);
+  if (reporter->stopped || reporter->clock_id != id) {
+    g_mutex_unlock(&reporter->lock);
+    return TRUE;
+  }
+  duration = reporter->duration;
+  g_mutex_unlock(&reporter->lock);
+
+  if (!gst_element_query_position(reporter->pipeline, GST_FORMAT_TIME, &position))
+    return TRUE;
+
+  if (!GST_CLOCK_TIME_IS_VALID(duration) && gst_element_query_duration(reporter->pipeline, GST_FORMAT_TIME, &queried)) {
+    duration = queried;
+
+    g_mutex_lock(&reporter->lock);
+    reporter->duration = duration;
+    g_mutex_unlock(&reporter->lock);
+  }
+
+  s = gst_structure_new(POSITION_REPORTER_MESSAGE, "position", G_TYPE_UINT64, (guint64)position, "duration",
+                        G_TYPE_UINT64, (guint64)duration, NULL);
+  gst_element_post_message(reporter->pipeline, gst_message_new_application(GST_OBJECT(reporter->pipeline), s));
+
+  return TRUE;
+}
+
+/* Must be called with the lock */
+static void position_reporter_stop_locked(PositionReporter *reporter) {
+  if (reporter->clock_id == NULL)
+    return;
+
+  gst_clock_id_unschedule(reporter->clock_id);
+  gst_clock_id_unref(reporter->clock_id);
+  reporter->clock_id = NULL;
+}
+
+/* Must be called with the lock */
+static void position_reporter_start_locked(PositionReporter *reporter) {
+  GstClock *clock;
+
+  position_reporter_stop_locked(reporter);
+
+  clock = gst_element_get_clock(reporter->pipeline);
+  if (clock == NULL) {
+    GST_WARNING_OBJECT(reporter->pipeline, "No clock, no position reports");
+    return;
+  }
+
+  reporter->clock_id = gst_clock_new_periodic_id(clock, gst_clock_get_time(clock) + reporter->interval,
+                                                 reporter->interval);
+  if (gst_clock_id_wait_async(reporter->clock_id, position_reporter_tick, position_reporter_ref(reporter),
+                              (GDestroyNotify)position_reporter_unref) != GST_CLOCK_OK) {
+    GST_WARNING_OBJECT(reporter->pipeline, "Could not schedule the position reports");
+    gst_clock_id_unref(reporter->clock_id);
+    reporter->clock_id = NULL;
+  }
+
+  gst_object_unref(clock);
+}
+
+PositionReporter *position_reporter_new(GstElement *pipeline, GstClockTime interval) {
+  PositionReporter *reporter;
+
+  g_return_val_if_fail(GST_IS_ELEMENT(pipeline), NULL);
+  g_return_val_if_fail(interval > 0 && GST_CLOCK_TIME_IS_VALID(interval), NULL);
+
+  reporter = g_new0(PositionReporter, 1);
+  reporter->ref_count = 1;
+  reporter->pipeline = gst_object_ref(pipeline);
+  reporter->interval = interval;
+  reporter->duration = GST_CLOCK_TIME_NONE;
+  g_mutex_init(&reporter->lock);
+
+  return reporter;
+}
+
+void position_reporter_free(PositionReporter *reporter) {
+  if (reporter == NULL)
+    return;
+
+  g_mutex_lock(&reporter->lock);
+  reporter->stopped = TRUE;
+  position_reporter_stop_locked(reporter);
+  g_mutex_unlock(&reporter->lock);
+
+  /* A tick that is running keeps its own reference */
+  position_reporter_unref(reporter);
+}
+
+gboolean position_reporter_handle_message(PositionReporter *reporter, GstMessage *msg, GstClockTime *position,
+                                          GstClockTime *duration) {
+  switch (GST_MESSAGE_TYPE(msg)) {
+  case GST_MESSAGE_APPLICATION: {
+    const GstStructure *s = gst_message_get_structure(msg);
+
+    if (GST_MESSAGE_SRC(msg) != GST_OBJECT(reporter->pipeline) || !gst_structure_has_name(s, POSITION_REPORTER_MESSAGE))
+      return FALSE;
+
+    gst_structure_get_uint64(s, "position", position);
+    gst_structure_get_uint64(s, "duration", duration);
+
+    return TRUE;
+  }
+
+  case GST_MESSAGE_DURATION_CHANGED:
+    g_mutex_lock(&reporter->lock);
+    reporter->duration = GST_CLOCK_TIME_NONE;
+    g_mutex_unlock(&reporter->lock);
+    break;
+
+  case GST_MESSAGE_STATE_CHANGED: {
+    GstState new_state;
+
+    if (GST_MESSAGE_SRC(msg) != GST_OBJECT(reporter->pipeline))
+      break;
+
+    /* The clock is selected when going to PLAYING, and may be a different one every time */
+    gst_message_parse_state_changed(msg, NULL, &new_state, NULL);
+    g_mutex_lock(&reporter->lock);
+    if (new_state == GST_STATE_PLAYING && !reporter->stopped)
+      position_reporter_start_locked(reporter);
+    else
+      position_reporter_stop_locked(reporter);
+    g_mutex_unlock(&reporter->lock);
+    break;
+  }
+
+  default:
+    break;
+  }
+
+  return FALSE;
+}
@@ -0,0 +1,31 @@
+#ifndef __COMMON_POSITION_REPORTER_H__
+#define __COMMON_POSITION_REPORTER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Posts the position and duration of a pipeline on its bus at a fixed interval, instead of having the application
+ * wake up to query them.
+ *
+ * The reports are driven by a periodic clock id on the pipeline clock, so there are none while the pipeline is not
+ * PLAYING and the bus can be popped without a timeout. The duration is queried once and kept until a
+ * GST_MESSAGE_DURATION_CHANGED goes through position_reporter_handle_message(). */
+#define POSITION_REPORTER_MESSAGE "position-report"
+
+typedef struct _PositionReporter PositionReporter;
+
+PositionReporter *position_reporter_new(GstElement *pipeline, GstClockTime interval);
+
+/* Stops the reports, the ones already posted stay on the bus */
+void position_reporter_free(PositionReporter *reporter);
+
+/* Give every message popped from the pipeline bus to the reporter: it follows the pipeline state and duration
+ * changes. Returns TRUE if msg is a report, position and duration are filled then (GST_CLOCK_TIME_NONE when the
+ * duration is unknown). */
+gboolean position_reporter_handle_message(PositionReporter *reporter, GstMessage *msg, GstClockTime *position,
+                                          GstClockTime *duration);
+
+G_END_DECLS
+
+#endif /* __COMMON_POSITION_REPORTER_H__ */
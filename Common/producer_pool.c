@@ -0,0 +1,49 @@
+#include "producer_pool.h"
+
+GstBufferPool *producer_pool_new(GstElement *appsrc, guint chunk_size, guint extra_buffers) {
+  GstBufferPool *pool;
+  GstStructure *config;
+  guint64 max_bytes = 0;
+  guint min_buffers;
+
+  g_return_val_if_fail(chunk_size > 0, NULL);
+
+  g_object_get(appsrc, "max-bytes", &max_bytes, NULL);
+  min_buffers = (guint)MIN(max_bytes / chunk_size + extra_buffers, G_MAXUINT);
+
+  pool = gst_buffer_pool_new();
+  config = gst_buffer_pool_get_config(pool);
+  gst_buffer_pool_config_set_params(config, NULL, chunk_size, min_buffers, 0);
+
+  if (!gst_buffer_pool_set_config(pool, config) || !gst_buffer_pool_set_active(pool, TRUE)) {
+    GST_WARNING_OBJECT(appsrc, "Could not set up a pool of %u buffers of %u bytes", min_buffers, chunk_size);
+    gst_object_unref(pool);
+
+    return NULL;
+  }
+
+  GST_DEBUG_OBJECT(appsrc, "Producer pool of %u buffers of %u bytes", min_buffers, chunk_size);
+
+  return pool;
+}
+
+GstBuffer *producer_pool_acquire(GstBufferPool *pool, GstClockTime pts, GstClockTime duration) {
+  GstBuffer *buffer = NULL;
+
+  if (gst_buffer_pool_acquire_buffer(pool, &buffer, NULL) != GST_FLOW_OK)
+    return NULL;
+
+  /* the pool resets the metadata of released buffers, nothing else to clear */
+  GST_BUFFER_PTS(buffer) = pts;
+  GST_BUFFER_DURATION(buffer) = duration;
+
+  return buffer;
+}
+
+void producer_pool_free(GstBufferPool *pool) {
+  if (pool == NULL)
+    return;
+
+  gst_buffer_pool_set_active(pool, FALSE);
+  gst_object_unref(pool);
+}
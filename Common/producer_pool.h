@@ -0,0 +1,24 @@
+#ifndef __COMMON_PRODUCER_POOL_H__
+#define __COMMON_PRODUCER_POOL_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* A GstBufferPool for application code feeding an appsrc.
+ *
+ * The pool is sized from the appsrc "max-bytes" property: max-bytes / chunk_size buffers can wait inside appsrc, and
+ * extra_buffers more are downstream or being filled. They are all allocated when the pool is created. The pool has no
+ * upper limit, so a pipeline holding more buffers than expected makes it grow instead of blocking the producer. After
+ * that, buffers released downstream come back to the pool, and pushing allocates nothing. */
+GstBufferPool *producer_pool_new(GstElement *appsrc, guint chunk_size, guint extra_buffers);
+
+/* Takes a buffer of chunk_size bytes from the pool and timestamps it. Returns NULL when the pool was deactivated. */
+GstBuffer *producer_pool_acquire(GstBufferPool *pool, GstClockTime pts, GstClockTime duration);
+
+/* Deactivates the pool and drops our reference. Buffers still in the pipeline are freed when they are released. */
+void producer_pool_free(GstBufferPool *pool);
+
+G_END_DECLS
+
+#endif /* __COMMON_PRODUCER_POOL_H__ */
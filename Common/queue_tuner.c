@@ -0,0 +1,234 @@
+#include <string.h>
+
+#include "queue_tuner.h"
+
+#define WARMUP_WINDOWS 5 // Windows measuring the usual underrun rate, at the initial limits
+#define STABLE_WINDOWS 5 // Windows without overrun before a shrink
+#define HEADROOM 2       // Limits are this many times the highest level seen
+
+/* Smallest limits ever set */
+#define MIN_BUFFERS 2
+#define MIN_BYTES 4096
+#define MIN_TIME (10 * GST_MSECOND)
+
+typedef struct _TunedQueue {
+  GstElement *queue;
+  gulong overrun_id, underrun_id;
+
+  /* counted by the streaming threads, taken at each tick */
+  gint overruns, underruns;
+
+  QueueTunerLimits floor;    /* never shrink below, raised when a shrink went too far */
+  QueueTunerLimits previous; /* limits before the last shrink */
+  QueueTunerLimits window_peak;
+  guint windows;             /* windows since the queue was added */
+  guint stable;              /* windows without overrun since the last change */
+  gboolean shrunk;           /* the last change was a shrink and it is still on trial */
+  gdouble usual_underruns;   /* underruns per window during the warmup */
+
+  QueueTunerStats stats;
+} TunedQueue;
+
+struct _QueueTuner {
+  GMutex lock; /* protects queues, the tick runs in the main context but the stats can be read from anywhere */
+  GPtrArray *queues;
+  GSource *source;
+};
+
+static void overrun_cb(GstElement *queue, TunedQueue *q) {
+  g_atomic_int_inc(&q->overruns);
+}
+
+static void underrun_cb(GstElement *queue, TunedQueue *q) {
+  g_atomic_int_inc(&q->underruns);
+}
+
+static guint take_count(gint *count) {
+  gint value = g_atomic_int_get(count);
+
+  g_atomic_int_add(count, -value);
+
+  return (guint)value;
+}
+
+static void tuned_queue_free(gpointer data) {
+  TunedQueue *q = data;
+
+  g_signal_handler_disconnect(q->queue, q->overrun_id);
+  g_signal_handler_disconnect(q->queue, q->underrun_id);
+  gst_object_unref(q->queue);
+  g_free(q);
+}
+
+static void get_limits(GstElement *queue, QueueTunerLimits *limits) {
+  g_object_get(queue, "max-size-buffers", &limits->buffers, "max-size-bytes", &limits->bytes, "max-size-time",
+               &limits->time, NULL);
+}
+
+static void get_levels(GstElement *queue, QueueTunerLimits *levels) {
+  g_object_get(queue, "current-level-buffers", &levels->buffers, "current-level-bytes", &levels->bytes,
+               "current-level-time", &levels->time, NULL);
+}
+
+static void max_limits(QueueTunerLimits *a, const QueueTunerLimits *b) {
+  a->buffers = MAX(a->buffers, b->buffers);
+  a->bytes = MAX(a->bytes, b->bytes);
+  a->time = MAX(a->time, b->time);
+}
+
+/* A limit of 0 is unlimited, it stays that way */
+static guint64 clamp_limit(guint64 value, guint64 min, guint64 floor, guint64 initial) {
+  if (initial == 0)
+    return 0;
+
+  return MIN(MAX(MAX(value, min), floor), initial);
+}
+
+/* Returns FALSE if the limits were already there */
+static gboolean set_limits(TunedQueue *q, const QueueTunerLimits *limits) {
+  const QueueTunerLimits *initial = &q->stats.initial;
+  QueueTunerLimits l;
+
+  l.buffers = clamp_limit(limits->buffers, MIN_BUFFERS, q->floor.buffers, initial->buffers);
+  l.bytes = clamp_limit(limits->bytes, MIN_BYTES, q->floor.bytes, initial->bytes);
+  l.time = clamp_limit(limits->time, MIN_TIME, q->floor.time, initial->time);
+  if (l.buffers == q->stats.limits.buffers && l.bytes == q->stats.limits.bytes && l.time == q->stats.limits.time)
+    return FALSE;
+
+  q->stats.limits = l;
+  g_object_set(q->queue, "max-size-buffers", l.buffers, "max-size-bytes", l.bytes, "max-size-time", l.time, NULL);
+
+  return TRUE;
+}
+
+static void tuned_queue_tick(TunedQueue *q) {
+  QueueTunerLimits levels, target;
+  guint overruns = take_count(&q->overruns), underruns = take_count(&q->underruns);
+
+  q->stats.overruns += overruns;
+  q->stats.underruns += underruns;
+  get_levels(q->queue, &levels);
+  max_limits(&q->window_peak, &levels);
+  max_limits(&q->stats.peak, &levels);
+
+  /* Learn how often the branch underruns with the initial limits, it may well do so all the time */
+  if (++q->windows <= WARMUP_WINDOWS) {
+    q->usual_underruns += (gdouble)underruns / WARMUP_WINDOWS;
+    return;
+  }
+
+  if (overruns > 0) {
+    /* Too small to absorb the jitter, a shrink that led there must not happen again */
+    target = q->stats.limits;
+    target.buffers *= 2;
+    target.bytes *= 2;
+    target.time *= 2;
+    if (q->shrunk)
+      q->floor = target;
+    q->shrunk = FALSE;
+    if (set_limits(q, &target))
+      q->stats.grows++;
+  } else if (q->shrunk && underruns > q->usual_underruns + MAX(q->usual_underruns / 2, 1)) {
+    /* The last shrink starves the branch */
+    q->floor = q->previous;
+    q->shrunk = FALSE;
+    if (set_limits(q, &q->previous))
+      q->stats.grows++;
+  } else if (++q->stable >= STABLE_WINDOWS) {
+    /* The shrink on trial held, try a smaller size */
+    q->shrunk = FALSE;
+    target.buffers = MIN(q->window_peak.buffers * HEADROOM, q->stats.limits.buffers);
+    target.bytes = MIN(q->window_peak.bytes * HEADROOM, q->stats.limits.bytes);
+    target.time = MIN(q->window_peak.time * HEADROOM, q->stats.limits.time);
+    q->previous = q->stats.limits;
+    if (set_limits(q, &target)) {
+      q->shrunk = TRUE;
+      q->stats.shrinks++;
+    }
+  } else {
+    return;
+  }
+
+  q->stable = 0;
+  memset(&q->window_peak, 0, sizeof(q->window_peak));
+}
+
+static gboolean queue_tuner_tick(gpointer user_data) {
+  QueueTuner *tuner = user_data;
+
+  g_mutex_lock(&tuner->lock);
+  for (guint i = 0; i < tuner->queues->len; i++)
+    tuned_queue_tick(g_ptr_array_index(tuner->queues, i));
+  g_mutex_unlock(&tuner->lock);
+
+  return G_SOURCE_CONTINUE;
+}
+
+QueueTuner *queue_tuner_new(GstClockTime interval) {
+  QueueTuner *tuner = g_new0(QueueTuner, 1);
+
+  g_mutex_init(&tuner->lock);
+  tuner->queues = g_ptr_array_new_with_free_func(tuned_queue_free);
+
+  tuner->source = g_timeout_source_new(GST_TIME_AS_MSECONDS(interval));
+  g_source_set_callback(tuner->source, queue_tuner_tick, tuner, NULL);
+  g_source_attach(tuner->source, g_main_context_get_thread_default());
+
+  return tuner;
+}
+
+void queue_tuner_free(QueueTuner *tuner) {
+  if (!tuner)
+    return;
+
+  g_source_destroy(tuner->source);
+  g_source_unref(tuner->source);
+  g_ptr_array_unref(tuner->queues);
+  g_mutex_clear(&tuner->lock);
+  g_free(tuner);
+}
+
+void queue_tuner_add(QueueTuner *tuner, GstElement *queue) {
+  TunedQueue *q = g_new0(TunedQueue, 1);
+
+  q->queue = gst_object_ref(queue);
+  get_limits(queue, &q->stats.initial);
+  q->stats.limits = q->stats.initial;
+  q->overrun_id = g_signal_connect(queue, "overrun", G_CALLBACK(overrun_cb), q);
+  q->underrun_id = g_signal_connect(queue, "underrun", G_CALLBACK(underrun_cb), q);
+
+  g_mutex_lock(&tuner->lock);
+  g_ptr_array_add(tuner->queues, q);
+  g_mutex_unlock(&tuner->lock);
+}
+
+gboolean queue_tuner_get_stats(QueueTuner *tuner, GstElement *queue, QueueTunerStats *stats) {
+  gboolean found = FALSE;
+
+  g_mutex_lock(&tuner->lock);
+  for (guint i = 0; i < tuner->queues->len && !found; i++) {
+    TunedQueue *q = g_ptr_array_index(tuner->queues, i);
+
+    if (q->queue == queue) {
+      *stats = q->stats;
+      found = TRUE;
+    }
+  }
+  g_mutex_unlock(&tuner->lock);
+
+  return found;
+}
+
+guint64 queue_tuner_get_bytes_saved(QueueTuner *tuner) {
+  guint64 saved = 0;
+
+  g_mutex_lock(&tuner->lock);
+  for (guint i = 0; i < tuner->queues->len; i++) {
+    TunedQueue *q = g_ptr_array_index(tuner->queues, i);
+
+    saved += q->stats.initial.bytes - q->stats.limits.bytes;
+  }
+  g_mutex_unlock(&tuner->lock);
+
+  return saved;
+}
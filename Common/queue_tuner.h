@@ -0,0 +1,48 @@
+#ifndef __COMMON_QUEUE_TUNER_H__
+#define __COMMON_QUEUE_TUNER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Shrinks the limits of queue elements to what their branch actually needs.
+ *
+ * The overrun and underrun signals are counted from the streaming threads and the current-level-* properties are
+ * sampled once per interval, from the main context. The limits then move with these rules:
+ *  - the first windows keep the initial limits and measure the usual underrun rate of the branch
+ *  - an overrun means the queue is too small to absorb the jitter: the limits double, up to the initial ones
+ *  - after some windows without overrun, the limits shrink to twice the highest level seen since the last change
+ *  - if a shrink makes the branch underrun more than it used to, the previous limits come back and become a floor
+ * A limit that was 0 (unlimited) is left alone. */
+typedef struct _QueueTunerLimits {
+  guint buffers;
+  guint bytes;
+  GstClockTime time;
+} QueueTunerLimits;
+
+typedef struct _QueueTunerStats {
+  guint64 overruns, underruns; /* signals seen */
+  guint64 grows, shrinks;      /* decisions taken, reverting a shrink counts as a grow */
+  QueueTunerLimits initial;    /* limits when the queue was added */
+  QueueTunerLimits limits;     /* limits now */
+  QueueTunerLimits peak;       /* highest levels sampled */
+} QueueTunerStats;
+
+typedef struct _QueueTuner QueueTuner;
+
+/* Ticks every interval on the thread-default main context, which has to be running */
+QueueTuner *queue_tuner_new(GstClockTime interval);
+void queue_tuner_free(QueueTuner *tuner);
+
+/* Starts tuning a queue, with its current limits as the upper bound */
+void queue_tuner_add(QueueTuner *tuner, GstElement *queue);
+
+/* Returns FALSE if the queue was not added */
+gboolean queue_tuner_get_stats(QueueTuner *tuner, GstElement *queue, QueueTunerStats *stats);
+
+/* Bytes the max-size-bytes limits went down by, over all queues: what they can no longer hold at worst */
+guint64 queue_tuner_get_bytes_saved(QueueTuner *tuner);
+
+G_END_DECLS
+
+#endif /* __COMMON_QUEUE_TUNER_H__ */
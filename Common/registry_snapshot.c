@@ -0,0 +1,28 @@
+#include "registry_snapshot.h"
+
+gboolean registry_snapshot_use(const gchar *dir) {
+  gchar *registry, *plugins;
+  gboolean ret;
+
+  if (dir == NULL)
+    dir = g_getenv(REGISTRY_SNAPSHOT_ENV);
+  if (dir == NULL || *dir == '\0')
+    return FALSE;
+
+  registry = g_build_filename(dir, REGISTRY_SNAPSHOT_FILE, NULL);
+  plugins = g_build_filename(dir, REGISTRY_SNAPSHOT_PLUGINS, NULL);
+
+  ret = g_file_test(registry, G_FILE_TEST_IS_REGULAR) && g_file_test(plugins, G_FILE_TEST_IS_DIR);
+  if (ret) {
+    /* The _1_0 variables take precedence over the ones the user may have set */
+    g_setenv("GST_REGISTRY_1_0", registry, TRUE);
+    g_setenv("GST_PLUGIN_SYSTEM_PATH_1_0", plugins, TRUE);
+    g_setenv("GST_PLUGIN_PATH_1_0", plugins, TRUE);
+    g_setenv("GST_REGISTRY_UPDATE", "no", TRUE);
+  }
+
+  g_free(registry);
+  g_free(plugins);
+
+  return ret;
+}
@@ -0,0 +1,23 @@
+#ifndef __COMMON_REGISTRY_SNAPSHOT_H__
+#define __COMMON_REGISTRY_SNAPSHOT_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Trimmed plugin registry made by common_registry_snapshot.
+ *
+ * A snapshot directory holds links to the few plugins some pipelines need and a binary registry of exactly these
+ * plugins, written and checked when the snapshot was made. Using it, gst_init() loads that small registry and doesn't
+ * look at any plugin file, instead of checking every installed plugin against the default registry. */
+#define REGISTRY_SNAPSHOT_ENV "GST_TUTORIAL_REGISTRY_SNAPSHOT" // Snapshot directory used when none is given
+#define REGISTRY_SNAPSHOT_FILE "registry.bin"
+#define REGISTRY_SNAPSHOT_PLUGINS "plugins"
+
+/* Call before gst_init(). Points GStreamer to the snapshot in dir, or in $GST_TUTORIAL_REGISTRY_SNAPSHOT when dir is
+ * NULL, and turns the registry update off. Returns FALSE and changes nothing if there is no snapshot. */
+gboolean registry_snapshot_use(const gchar *dir);
+
+G_END_DECLS
+
+#endif /* __COMMON_REGISTRY_SNAPSHOT_H__ */
@@ -0,0 +1,287 @@
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+#include <string.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "registry_snapshot.h"
+
+#define WRITE_REGISTRY_MODE "--write-registry" // First argument of the child that writes the registry
+#define PREROLL_TIMEOUT (10 * GST_SECOND)      // Longest wait for a --uri to preroll
+
+/* Plugin name -> plugin file, everything the snapshot will hold */
+typedef struct _CustomData {
+  GMutex lock; /* elements are added from the streaming threads while a URI prerolls */
+  GHashTable *plugins;
+} CustomData;
+
+/* Add a plugin by name, FALSE if it is not installed */
+static gboolean add_plugin(CustomData *, const gchar *);
+
+/* Add the plugin of a feature (element, typefinder...) */
+static gboolean add_feature(CustomData *, const gchar *);
+
+/* Preroll a URI in playbin and add the plugin of every element it created */
+static void add_uri(CustomData *, const gchar *);
+
+/* Link the plugins in dir/plugins, then have a fresh process write the registry */
+static gboolean make_snapshot(CustomData *, const gchar *, const gchar *);
+
+/* Child side: scan dir/plugins into dir/registry.bin and check that every plugin loads */
+static int write_registry(const gchar *);
+
+int main(int argc, char *argv[]) {
+  CustomData data;
+  GError *err = NULL;
+  gchar *output = NULL, *self;
+  gchar **elements = NULL, **plugins = NULL, **uris = NULL;
+  GOptionEntry entries[] = {
+      {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Snapshot directory", "DIR"},
+      {"element", 'e', 0, G_OPTION_ARG_STRING_ARRAY, &elements, "Include the plugin of this element", "NAME"},
+      {"plugin", 'p', 0, G_OPTION_ARG_STRING_ARRAY, &plugins, "Include this plugin", "NAME"},
+      {"uri", 'u', 0, G_OPTION_ARG_STRING_ARRAY, &uris, "Include every plugin playbin uses to preroll this URI", "URI"},
+      {NULL}};
+  GOptionContext *context;
+  gboolean ret;
+
+  /* The child must set its environment before gst_init */
+  if (argc == 3 && g_str_equal(argv[1], WRITE_REGISTRY_MODE))
+    return write_registry(argv[2]);
+
+  self = g_strdup(argv[0]);
+
+  /* Initialize GStreamer with the full registry and parse the options */
+  context = g_option_context_new("- make a registry with only the plugins some pipelines need");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("Failed to parse options: %s\n", err->message);
+    g_clear_error(&err);
+    g_option_context_free(context);
+
+    return -1;
+  }
+  g_option_context_free(context);
+
+  if (output == NULL) {
+    g_printerr("--output is required\n");
+    return -1;
+  }
+
+  /* Initialize custom data structure */
+  memset(&data, 0, sizeof(data));
+  g_mutex_init(&data.lock);
+  data.plugins = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+  /* queue, typefind, tee... are used by most pipelines and by playbin itself */
+  add_plugin(&data, "coreelements");
+
+  for (gchar **name = elements; name && *name; name++)
+    if (!add_feature(&data, *name))
+      g_printerr("Skipping element %s, it is not installed\n", *name);
+  for (gchar **name = plugins; name && *name; name++)
+    if (!add_plugin(&data, *name))
+      g_printerr("Skipping plugin %s, it is not installed\n", *name);
+  for (gchar **uri = uris; uri && *uri; uri++)
+    add_uri(&data, *uri);
+
+  ret = make_snapshot(&data, output, self);
+
+  /* Free resources */
+  g_hash_table_destroy(data.plugins);
+  g_mutex_clear(&data.lock);
+  g_strfreev(elements);
+  g_strfreev(plugins);
+  g_strfreev(uris);
+  g_free(output);
+  g_free(self);
+
+  return ret ? 0 : -1;
+}
+
+static gboolean add_plugin(CustomData *data, const gchar *name) {
+  GstPlugin *plugin = gst_registry_find_plugin(gst_registry_get(), name);
+  const gchar *filename;
+
+  if (!plugin)
+    return FALSE;
+
+  /* Plugins linked into the application have no file, they are always there */
+  filename = gst_plugin_get_filename(plugin);
+  if (filename) {
+    g_mutex_lock(&data->lock);
+    g_hash_table_replace(data->plugins, g_strdup(name), g_strdup(filename));
+    g_mutex_unlock(&data->lock);
+  }
+
+  gst_object_unref(plugin);
+
+  return TRUE;
+}
+
+static gboolean add_feature(CustomData *data, const gchar *name) {
+  GstPluginFeature *feature = gst_registry_lookup_feature(gst_registry_get(), name);
+  gboolean ret;
+
+  if (!feature)
+    return FALSE;
+
+  ret = add_plugin(data, gst_plugin_feature_get_plugin_name(feature));
+  gst_object_unref(feature);
+
+  return ret;
+}
+
+static void deep_element_added_cb(GstBin *bin, GstBin *sub_bin, GstElement *element, CustomData *data) {
+  GstElementFactory *factory = gst_element_get_factory(element);
+
+  if (factory)
+    add_feature(data, gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)));
+}
+
+static void add_uri(CustomData *data, const gchar *uri) {
+  GstElement *playbin = gst_element_factory_make("playbin", NULL);
+
+  if (!playbin) {
+    g_printerr("Skipping %s, playbin is not installed\n", uri);
+    return;
+  }
+
+  add_feature(data, "playbin");
+  g_object_set(playbin, "uri", uri, NULL);
+  g_signal_connect(playbin, "deep-element-added", G_CALLBACK(deep_element_added_cb), data);
+
+  /* Prerolling creates the source, demuxers, decoders and sinks */
+  if (gst_element_set_state(playbin, GST_STATE_PAUSED) == GST_STATE_CHANGE_FAILURE ||
+      gst_element_get_state(playbin, NULL, NULL, PREROLL_TIMEOUT) != GST_STATE_CHANGE_SUCCESS)
+    g_printerr("%s did not preroll, its plugins may be missing from the snapshot\n", uri);
+
+  gst_element_set_state(playbin, GST_STATE_NULL);
+  gst_object_unref(playbin);
+}
+
+static gboolean make_snapshot(CustomData *data, const gchar *dir, const gchar *self) {
+#ifdef G_OS_UNIX
+  GHashTableIter iter;
+  gpointer key, value;
+  gchar *plugins_dir, *child_argv[4];
+  GDir *old;
+  GError *err = NULL;
+  gint status;
+  gboolean ret = TRUE;
+
+  plugins_dir = g_build_filename(dir, REGISTRY_SNAPSHOT_PLUGINS, NULL);
+  if (g_mkdir_with_parents(plugins_dir, 0755) < 0) {
+    g_printerr("Could not create %s: %s\n", plugins_dir, g_strerror(errno));
+    g_free(plugins_dir);
+    return FALSE;
+  }
+
+  /* Drop the links of a previous snapshot */
+  old = g_dir_open(plugins_dir, 0, NULL);
+  if (old) {
+    const gchar *name;
+
+    while ((name = g_dir_read_name(old)) != NULL) {
+      gchar *path = g_build_filename(plugins_dir, name, NULL);
+
+      g_unlink(path);
+      g_free(path);
+    }
+    g_dir_close(old);
+  }
+
+  g_hash_table_iter_init(&iter, data->plugins);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    gchar *basename = g_path_get_basename(value);
+    gchar *path = g_build_filename(plugins_dir, basename, NULL);
+
+    if (symlink(value, path) < 0) {
+      g_printerr("Could not link %s: %s\n", (const gchar *)value, g_strerror(errno));
+      ret = FALSE;
+    } else {
+      g_print("  %s (%s)\n", (const gchar *)key, (const gchar *)value);
+    }
+
+    g_free(basename);
+    g_free(path);
+  }
+  g_free(plugins_dir);
+
+  if (!ret)
+    return FALSE;
+
+  /* This process already loaded the full registry, a fresh one writes the trimmed one */
+  child_argv[0] = (gchar *)self;
+  child_argv[1] = WRITE_REGISTRY_MODE;
+  child_argv[2] = (gchar *)dir;
+  child_argv[3] = NULL;
+  if (!g_spawn_sync(NULL, child_argv, NULL, strchr(self, G_DIR_SEPARATOR) ? 0 : G_SPAWN_SEARCH_PATH, NULL, NULL, NULL,
+                    NULL, &status, &err) ||
+      !g_spawn_check_exit_status(status, &err)) {
+    g_printerr("Could not write the registry: %s\n", err->message);
+    g_clear_error(&err);
+    return FALSE;
+  }
+
+  g_print("Snapshot of %u plugins in %s, use it with %s=%s\n", g_hash_table_size(data->plugins), dir,
+          REGISTRY_SNAPSHOT_ENV, dir);
+
+  return TRUE;
+#else
+  g_printerr("Snapshots need symbolic links, they are only made on Unix\n");
+
+  return FALSE;
+#endif
+}
+
+static int write_registry(const gchar *dir) {
+  gchar *registry, *plugins_dir;
+  GList *plugins;
+  gboolean ret = TRUE;
+
+  registry = g_build_filename(dir, REGISTRY_SNAPSHOT_FILE, NULL);
+  plugins_dir = g_build_filename(dir, REGISTRY_SNAPSHOT_PLUGINS, NULL);
+
+  /* Scan only the linked plugins, in this process, into a new registry file */
+  g_unlink(registry);
+  g_setenv("GST_REGISTRY_1_0", registry, TRUE);
+  g_setenv("GST_PLUGIN_SYSTEM_PATH_1_0", plugins_dir, TRUE);
+  g_setenv("GST_PLUGIN_PATH_1_0", plugins_dir, TRUE);
+  g_setenv("GST_REGISTRY_UPDATE", "yes", TRUE);
+  g_setenv("GST_REGISTRY_FORK", "no", TRUE);
+
+  gst_init(NULL, NULL);
+
+  /* A plugin that doesn't load would only fail later, in the workers */
+  plugins = gst_registry_get_plugin_list(gst_registry_get());
+  for (GList *l = plugins; l; l = l->next) {
+    GstPlugin *plugin = l->data;
+    GstPlugin *loaded;
+
+    if (gst_plugin_get_filename(plugin) == NULL)
+      continue;
+
+    loaded = gst_plugin_load(plugin);
+    if (!loaded) {
+      g_printerr("Plugin %s does not load\n", gst_plugin_get_name(plugin));
+      ret = FALSE;
+      continue;
+    }
+    gst_object_unref(loaded);
+  }
+  gst_plugin_list_free(plugins);
+
+  if (ret && !g_file_test(registry, G_FILE_TEST_IS_REGULAR)) {
+    g_printerr("%s was not written\n", registry);
+    ret = FALSE;
+  }
+
+  g_free(registry);
+  g_free(plugins_dir);
+
+  return ret ? 0 : 1;
+}
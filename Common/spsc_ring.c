@@ -0,0 +1,152 @@
+#include "spsc_ring.h"
+
+struct _SpscRing {
+  gpointer *slots;
+  guint mask;
+
+  /* free running indices, head is only written by the producer and tail by the consumer */
+  gint head;
+  gint tail;
+
+  /* parking, a side sets its flag under the lock before it checks the ring one last time and waits */
+  GMutex lock;
+  GCond cond;
+  gint producer_waiting;
+  gint consumer_waiting;
+  gint closed;
+
+  /* each counter has a single writer */
+  guint64 pushed, popped, dropped, backpressure;
+  guint max_occupancy;
+};
+
+SpscRing *spsc_ring_new(guint capacity) {
+  SpscRing *ring = g_new0(SpscRing, 1);
+  guint size = 1;
+
+  while (size < MAX(capacity, 1))
+    size <<= 1;
+
+  ring->slots = g_new0(gpointer, size);
+  ring->mask = size - 1;
+  g_mutex_init(&ring->lock);
+  g_cond_init(&ring->cond);
+
+  return ring;
+}
+
+void spsc_ring_free(SpscRing *ring, GDestroyNotify free_func) {
+  gpointer item;
+
+  while ((item = spsc_ring_pop(ring)) != NULL) {
+    if (free_func)
+      free_func(item);
+  }
+
+  g_mutex_clear(&ring->lock);
+  g_cond_clear(&ring->cond);
+  g_free(ring->slots);
+  g_free(ring);
+}
+
+static void spsc_ring_wake(SpscRing *ring, gint *waiting) {
+  if (g_atomic_int_get(waiting)) {
+    g_mutex_lock(&ring->lock);
+    g_cond_broadcast(&ring->cond);
+    g_mutex_unlock(&ring->lock);
+  }
+}
+
+gboolean spsc_ring_push(SpscRing *ring, gpointer item, gboolean wait) {
+  guint head = (guint)ring->head, occupancy;
+
+  g_return_val_if_fail(item != NULL, FALSE);
+
+  if (g_atomic_int_get(&ring->closed))
+    return FALSE;
+
+  if (head - (guint)g_atomic_int_get(&ring->tail) > ring->mask) {
+    ring->backpressure++;
+    if (!wait) {
+      ring->dropped++;
+      return FALSE;
+    }
+
+    g_mutex_lock(&ring->lock);
+    g_atomic_int_set(&ring->producer_waiting, 1);
+    while (head - (guint)g_atomic_int_get(&ring->tail) > ring->mask && !g_atomic_int_get(&ring->closed))
+      g_cond_wait(&ring->cond, &ring->lock);
+    g_atomic_int_set(&ring->producer_waiting, 0);
+    g_mutex_unlock(&ring->lock);
+
+    if (g_atomic_int_get(&ring->closed))
+      return FALSE;
+  }
+
+  ring->slots[head & ring->mask] = item;
+  /* publishes the slot, the atomic store is a full barrier */
+  g_atomic_int_set(&ring->head, (gint)(head + 1));
+
+  ring->pushed++;
+  occupancy = head + 1 - (guint)g_atomic_int_get(&ring->tail);
+  if (occupancy > ring->max_occupancy)
+    ring->max_occupancy = occupancy;
+
+  spsc_ring_wake(ring, &ring->consumer_waiting);
+
+  return TRUE;
+}
+
+gpointer spsc_ring_pop(SpscRing *ring) {
+  guint tail = (guint)ring->tail;
+  gpointer item;
+
+  if ((guint)g_atomic_int_get(&ring->head) == tail)
+    return NULL;
+
+  item = ring->slots[tail & ring->mask];
+  g_atomic_int_set(&ring->tail, (gint)(tail + 1));
+  ring->popped++;
+
+  spsc_ring_wake(ring, &ring->producer_waiting);
+
+  return item;
+}
+
+gpointer spsc_ring_pop_wait(SpscRing *ring) {
+  gpointer item;
+
+  while ((item = spsc_ring_pop(ring)) == NULL) {
+    g_mutex_lock(&ring->lock);
+    g_atomic_int_set(&ring->consumer_waiting, 1);
+    while (g_atomic_int_get(&ring->head) == ring->tail && !g_atomic_int_get(&ring->closed))
+      g_cond_wait(&ring->cond, &ring->lock);
+    g_atomic_int_set(&ring->consumer_waiting, 0);
+    g_mutex_unlock(&ring->lock);
+
+    if (g_atomic_int_get(&ring->head) == ring->tail)
+      return NULL;
+  }
+
+  return item;
+}
+
+void spsc_ring_close(SpscRing *ring) {
+  g_mutex_lock(&ring->lock);
+  g_atomic_int_set(&ring->closed, 1);
+  g_cond_broadcast(&ring->cond);
+  g_mutex_unlock(&ring->lock);
+}
+
+guint spsc_ring_get_occupancy(SpscRing *ring) {
+  return (guint)g_atomic_int_get(&ring->head) - (guint)g_atomic_int_get(&ring->tail);
+}
+
+void spsc_ring_get_stats(SpscRing *ring, SpscRingStats *stats) {
+  stats->pushed = ring->pushed;
+  stats->popped = ring->popped;
+  stats->dropped = ring->dropped;
+  stats->backpressure = ring->backpressure;
+  stats->max_occupancy = ring->max_occupancy;
+  stats->capacity = ring->mask + 1;
+}
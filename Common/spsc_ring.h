@@ -0,0 +1,50 @@
+#ifndef __COMMON_SPSC_RING_H__
+#define __COMMON_SPSC_RING_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Bounded single producer, single consumer ring of pointers.
+ *
+ * Pushing and popping only use atomic loads and stores of the two indices. The mutex is only taken to park a side
+ * that has to wait (consumer on an empty ring, producer on a full one) and by the other side to wake it up. */
+typedef struct _SpscRing SpscRing;
+
+typedef struct _SpscRingStats {
+  guint64 pushed;        /* items that went in */
+  guint64 popped;        /* items that came out */
+  guint64 dropped;       /* pushes refused because the ring was full */
+  guint64 backpressure;  /* pushes that found the ring full, dropped or waited */
+  guint max_occupancy;   /* most items in the ring at once */
+  guint capacity;
+} SpscRingStats;
+
+/* capacity is rounded up to a power of two */
+SpscRing *spsc_ring_new(guint capacity);
+
+/* Frees the ring, calling free_func on the items still in it */
+void spsc_ring_free(SpscRing *ring, GDestroyNotify free_func);
+
+/* Producer side. When the ring is full, waits for room if wait is TRUE and otherwise counts a drop and returns FALSE.
+ * Also returns FALSE once the ring is closed. The item is never consumed on failure. */
+gboolean spsc_ring_push(SpscRing *ring, gpointer item, gboolean wait);
+
+/* Consumer side. Returns NULL when the ring is empty. */
+gpointer spsc_ring_pop(SpscRing *ring);
+
+/* Consumer side. Waits for an item, returns NULL once the ring is closed and empty. */
+gpointer spsc_ring_pop_wait(SpscRing *ring);
+
+/* Wakes up both sides, every later push fails and pop_wait returns NULL when the ring is empty */
+void spsc_ring_close(SpscRing *ring);
+
+/* Items waiting in the ring, exact from either side and approximate from any other thread */
+guint spsc_ring_get_occupancy(SpscRing *ring);
+
+/* The counters are written without locking, while the ring is in use they are approximate */
+void spsc_ring_get_stats(SpscRing *ring, SpscRingStats *stats);
+
+G_END_DECLS
+
+#endif /* __COMMON_SPSC_RING_H__ */
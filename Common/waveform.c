@@ -0,0 +1,101 @@
+#include "waveform.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WAVEFORM_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* samples evaluated from the same state */
+#define BLOCK 8
+/* the tutorials write 500 * a */
+#define AMPLITUDE 500.0
+
+void waveform_init(Waveform *wf) {
+  wf->a = 0;
+  wf->b = 1;
+  wf->c = 0;
+  wf->d = 1;
+}
+
+/* Frequency of the fast oscillator for the next chunk, exactly like the tutorials compute it */
+static gfloat waveform_next_freq(Waveform *wf) {
+  wf->c += wf->d;
+  wf->d -= wf->c / 1000;
+
+  return 1100 + 1000 * wf->d;
+}
+
+void waveform_fill_reference(Waveform *wf, gint16 *samples, gint n_samples) {
+  gfloat freq = waveform_next_freq(wf);
+
+  for (gint i = 0; i < n_samples; i++) {
+    wf->a += wf->b;
+    wf->b -= wf->a / freq;
+    samples[i] = (gint16)(500 * wf->a);
+  }
+}
+
+void waveform_fill(Waveform *wf, gint16 *samples, gint n_samples) {
+  gdouble k = 1.0 / waveform_next_freq(wf);
+  /* one step: (a, b) <- M (a, b) with M = | 1   1     |
+   *                                       | -k  1 - k | */
+  gdouble m00 = 1, m01 = 1, m10 = -k, m11 = 1 - k;
+  /* p = M^j, row 0 of it gives sample j of a block */
+  gdouble p00 = 1, p01 = 0, p10 = 0, p11 = 1;
+  gfloat ca[BLOCK], cb[BLOCK];
+  gdouble a = wf->a, b = wf->b;
+  gint i = 0;
+
+  for (gint j = 0; j < BLOCK; j++) {
+    gdouble q00 = m00 * p00 + m01 * p10, q01 = m00 * p01 + m01 * p11;
+    gdouble q10 = m10 * p00 + m11 * p10, q11 = m10 * p01 + m11 * p11;
+
+    p00 = q00, p01 = q01, p10 = q10, p11 = q11;
+    ca[j] = (gfloat)(AMPLITUDE * p00);
+    cb[j] = (gfloat)(AMPLITUDE * p01);
+  }
+  /* p is M^BLOCK now */
+
+#ifdef WAVEFORM_HAVE_SSE2
+  {
+    const __m128 ca_lo = _mm_loadu_ps(ca), ca_hi = _mm_loadu_ps(ca + 4);
+    const __m128 cb_lo = _mm_loadu_ps(cb), cb_hi = _mm_loadu_ps(cb + 4);
+
+    for (; i + BLOCK <= n_samples; i += BLOCK) {
+      __m128 va = _mm_set1_ps((gfloat)a), vb = _mm_set1_ps((gfloat)b);
+      __m128 lo = _mm_add_ps(_mm_mul_ps(ca_lo, va), _mm_mul_ps(cb_lo, vb));
+      __m128 hi = _mm_add_ps(_mm_mul_ps(ca_hi, va), _mm_mul_ps(cb_hi, vb));
+      gdouble next_a = p00 * a + p01 * b;
+
+      /* truncate like the (gint16) cast, the pack saturates */
+      _mm_storeu_si128((__m128i *)(samples + i), _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi)));
+
+      b = p10 * a + p11 * b;
+      a = next_a;
+    }
+  }
+#endif
+
+  for (; i + BLOCK <= n_samples; i += BLOCK) {
+    gfloat fa = (gfloat)a, fb = (gfloat)b;
+    gdouble next_a = p00 * a + p01 * b;
+
+    for (gint j = 0; j < BLOCK; j++)
+      samples[i + j] = (gint16)CLAMP(ca[j] * fa + cb[j] * fb, G_MININT16, G_MAXINT16);
+
+    b = p10 * a + p11 * b;
+    a = next_a;
+  }
+
+  /* the last samples of a chunk that is not a multiple of the block, one step at a time */
+  for (; i < n_samples; i++) {
+    gdouble next_a = a + b;
+
+    b = m10 * a + m11 * b;
+    a = next_a;
+    samples[i] = (gint16)CLAMP(AMPLITUDE * a, G_MININT16, G_MAXINT16);
+  }
+
+  wf->a = (gfloat)a;
+  wf->b = (gfloat)b;
+}
@@ -0,0 +1,33 @@
+#ifndef __COMMON_WAVEFORM_H__
+#define __COMMON_WAVEFORM_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The "psychedelic" waveform of the appsrc tutorials: a slow oscillator (c, d) sweeps the frequency of a fast one
+ * (a, b) once per chunk, and a is written out as 16 bit samples. */
+typedef struct _Waveform {
+  gfloat a, b, c, d;
+} Waveform;
+
+void waveform_init(Waveform *wf);
+
+/* Writes the next chunk of n_samples samples.
+ *
+ * The recurrence a += b; b -= a / freq is linear with a constant matrix M inside a chunk, so the coefficients of
+ * M^1 .. M^8 are computed once per chunk. Eight samples are then evaluated independently from the state at the start
+ * of their block (with SSE2 when available), and the state jumps ahead by M^8 in double precision. There is no
+ * division and no serial dependency per sample left.
+ *
+ * The result is not bit-identical to waveform_fill_reference(), which accumulates float rounding at every sample.
+ * Starting from the same state, the samples of a chunk differ by at most one unit where the truncation falls on the
+ * other side of an integer; common_waveform_bench measures the bound. */
+void waveform_fill(Waveform *wf, gint16 *samples, gint n_samples);
+
+/* The original per sample loop of the tutorials */
+void waveform_fill_reference(Waveform *wf, gint16 *samples, gint n_samples);
+
+G_END_DECLS
+
+#endif /* __COMMON_WAVEFORM_H__ */
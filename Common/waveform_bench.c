@@ -0,0 +1,89 @@
+#include <glib.h>
+
+#include "waveform.h"
+
+typedef void (*WaveformFillFunc)(Waveform *, gint16 *, gint);
+
+/* Samples per second produced by fill */
+static gdouble bench_fill(WaveformFillFunc fill, gint chunk, gint n_chunks) {
+  Waveform wf;
+  gint16 *samples = g_new(gint16, chunk);
+  gint64 start;
+  gdouble seconds;
+  gint64 checksum = 0;
+
+  waveform_init(&wf);
+  start = g_get_monotonic_time();
+  for (gint i = 0; i < n_chunks; i++) {
+    fill(&wf, samples, chunk);
+    checksum += samples[i % chunk];
+  }
+  seconds = (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC;
+
+  /* keeps the compiler from dropping the work */
+  g_debug("checksum %" G_GINT64_FORMAT, checksum);
+  g_free(samples);
+
+  return (gdouble)chunk * n_chunks / seconds;
+}
+
+/* Largest difference to the reference over n_chunks chunks, both starting every chunk from the reference state */
+static gint max_error(gint chunk, gint n_chunks) {
+  Waveform reference, fast;
+  gint16 *expected = g_new(gint16, chunk), *samples = g_new(gint16, chunk);
+  gint max = 0;
+
+  waveform_init(&reference);
+  for (gint i = 0; i < n_chunks; i++) {
+    fast = reference;
+    waveform_fill_reference(&reference, expected, chunk);
+    waveform_fill(&fast, samples, chunk);
+
+    for (gint j = 0; j < chunk; j++)
+      max = MAX(max, ABS(expected[j] - samples[j]));
+  }
+
+  g_free(expected);
+  g_free(samples);
+
+  return max;
+}
+
+int main(int argc, char *argv[]) {
+  gint chunk = 512, n_chunks = 100000, rate = 48000;
+  GOptionEntry entries[] = {
+      {"chunk", 'c', 0, G_OPTION_ARG_INT, &chunk, "Samples per chunk", "SAMPLES"},
+      {"chunks", 'n', 0, G_OPTION_ARG_INT, &n_chunks, "Chunks generated per run", "N"},
+      {"rate", 'r', 0, G_OPTION_ARG_INT, &rate, "Sample rate used to express the throughput in channels", "HZ"},
+      {NULL}};
+  GOptionContext *context;
+  GError *err = NULL;
+  gdouble reference, fast;
+
+  context = g_option_context_new("- waveform generator benchmark");
+  g_option_context_add_main_entries(context, entries, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("Failed to parse options: %s\n", err->message);
+    g_clear_error(&err);
+    g_option_context_free(context);
+
+    return -1;
+  }
+  g_option_context_free(context);
+
+  if (chunk <= 0 || n_chunks <= 0 || rate <= 0) {
+    g_printerr("All values must be positive.\n");
+    return -1;
+  }
+
+  reference = bench_fill(waveform_fill_reference, chunk, n_chunks);
+  fast = bench_fill(waveform_fill, chunk, n_chunks);
+
+  g_print("chunk: %d samples, %d chunks\n", chunk, n_chunks);
+  g_print("reference: %8.1f Msamples/s (%6.0f channels at %d Hz)\n", reference / 1e6, reference / rate, rate);
+  g_print("block:     %8.1f Msamples/s (%6.0f channels at %d Hz)\n", fast / 1e6, fast / rate, rate);
+  g_print("speedup:   %8.2fx\n", fast / reference);
+  g_print("max error: %d\n", max_error(chunk, MIN(n_chunks, 10000)));
+
+  return 0;
+}
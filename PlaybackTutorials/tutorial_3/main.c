@@ -1,23 +1,36 @@
 #include <gst/audio/audio.h>
 #include <gst/gst.h>
+#include <string.h>
 
-#define CHUNK_SIZE 1024   // Amount of bytes we are sending in each buffer
-#define SAMPLE_RATE 44100 // Samples per second we are sending
+#include "feed_controller.h"
+#include "producer_pool.h"
+#include "waveform.h"
+
+#define MIN_CHUNK_SIZE 1024             // Smallest amount of bytes we are sending in each buffer
+#define MAX_CHUNK_SIZE 65536            // Largest amount of bytes we are sending in each buffer
+#define MAX_LATENCY (200 * GST_MSECOND) // Most audio we let wait in appsrc
+#define TARGET_CYCLE_RATE 2.0           // need-data/enough-data cycles per second we aim for
+#define SAMPLE_RATE 44100               // Samples per second we are sending
+#define POOL_EXTRA 32                   // Pooled buffers on top of what appsrc queues
 
 /* Structure to contain all our information, so we can pass it to callbacks */
 typedef struct _CustomData {
   GstElement *pipeline;
   GstElement *app_source;
+  GstBufferPool *pool; // Recycles the buffers, sized from the appsrc max-bytes
+  guint chunk_size;    // Size of the buffers of the pool
+
+  FeedController feed; // Picks the chunk size and max-bytes
 
   guint64 num_samples; // Number of samples generted so far (for timestamp generation)
-  gfloat a, b, c, d;   // For waveform generator
+  Waveform wf;         // For waveform generator
 
   guint sourceid; // to control the GSource
 
   GMainLoop *main_loop; // GLib's Main loop
 } CustomData;
 
-/* This method iscalled by the idle GSource in the mainloop, to feed CHUNK_SIZE bytes into appsrc.
+/* This method iscalled by the idle GSource in the mainloop, to feed chunk_size bytes into appsrc.
  * The ide handler is added to the mainloop when appsrc rquests us to start sending data (need-data signal) and is
  * removed when appsrc has enough data (enough-data signal)
  */
@@ -28,9 +41,12 @@ static gboolean push_data(CustomData *);
 static void start_feed(GstElement *, guint, CustomData *);
 
 /* This callback triggers when appsrc has enough data and we can stop sending. We remove the idle handler from the
- * mainloop */
+ * mainloop, and apply the new chunk size and max-bytes if the feed controller changed them */
 static void stop_feed(GstElement *, CustomData *);
 
+/* Configures appsrc and the buffer pool for the given chunk size and max-bytes */
+static void apply_feed(CustomData *, guint, guint64);
+
 /* This function is called when an error message is posted on the bus */
 static void error_cb(GstBus *, GstMessage *, CustomData *);
 
@@ -40,11 +56,12 @@ static void source_setup(GstElement *, GstElement *, CustomData *);
 int main(int argc, char *argv[]) {
   CustomData data;
   GstBus *bus;
+  FeedControllerStats stats;
 
   /* Initialize custom data structure */
   memset(&data, 0, sizeof(data));
-  data.b = 1; // For waveform generation
-  data.d = 1;
+  waveform_init(&data.wf);
+  feed_controller_init(&data.feed, SAMPLE_RATE * 2, 2, MIN_CHUNK_SIZE, MAX_CHUNK_SIZE, MAX_LATENCY, TARGET_CYCLE_RATE);
 
   /* Initialize GStreamer */
   gst_init(&argc, &argv);
@@ -68,44 +85,44 @@ int main(int argc, char *argv[]) {
 
   /* Free resources */
   gst_element_set_state(data.pipeline, GST_STATE_NULL);
+  producer_pool_free(data.pool);
   gst_object_unref(data.pipeline);
+
+  /* What the feed controller did */
+  feed_controller_get_stats(&data.feed, &stats);
+  g_print("Feed: %" G_GUINT64_FORMAT " pushes, %" G_GUINT64_FORMAT " cycles, %" G_GUINT64_FORMAT " grows, %"
+          G_GUINT64_FORMAT " shrinks, last chunk %u bytes, max-bytes %" G_GUINT64_FORMAT "\n",
+          stats.pushes, stats.need_data, stats.grows, stats.shrinks, stats.chunk_size, stats.max_bytes);
+  feed_controller_clear(&data.feed);
+  g_main_loop_unref(data.main_loop);
+
   return 0;
 }
 
 static gboolean push_data(CustomData *data) {
   GstBuffer *buffer;
   GstFlowReturn ret;
-  int i;
   GstMapInfo map;
-  gint16 *raw;
-  gint num_samples = CHUNK_SIZE / 2; /* Because each sample is 16 bits */
-  gfloat freq;
+  guint chunk_size = data->chunk_size;
+  gint num_samples = chunk_size / 2; /* Because each sample is 16 bits */
 
-  /* Create a new empty buffer */
-  buffer = gst_buffer_new_and_alloc(CHUNK_SIZE);
-
-  /* Set its timestamp and duration */
-  GST_BUFFER_TIMESTAMP(buffer) = gst_util_uint64_scale(data->num_samples, GST_SECOND, SAMPLE_RATE);
-  GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale(num_samples, GST_SECOND, SAMPLE_RATE);
+  /* Take a recycled buffer with its timestamp and duration set */
+  buffer = producer_pool_acquire(data->pool, gst_util_uint64_scale(data->num_samples, GST_SECOND, SAMPLE_RATE),
+                                 gst_util_uint64_scale(num_samples, GST_SECOND, SAMPLE_RATE));
+  if (buffer == NULL)
+    return FALSE;
 
   /* Generate some psychodelic waveforms */
   gst_buffer_map(buffer, &map, GST_MAP_WRITE);
-  raw = (gint16 *)map.data;
-  data->c += data->d;
-  data->d -= data->c / 1000;
-  freq = 1100 + 1000 * data->d;
-  for (i = 0; i < num_samples; i++) {
-    data->a += data->b;
-    data->b -= data->a / freq;
-    raw[i] = (gint16)(500 * data->a);
-  }
+  waveform_fill(&data->wf, (gint16 *)map.data, num_samples);
   gst_buffer_unmap(buffer, &map);
   data->num_samples += num_samples;
 
-  /* Push the buffer into the appsrc */
+  /* Push the buffer into the appsrc. This may emit enough-data, which may change the chunk size. */
+  feed_controller_pushed(&data->feed, chunk_size);
   g_signal_emit_by_name(data->app_source, "push-buffer", buffer, &ret);
 
-  /* Free the buffer now that we are done with it */
+  /* Drop our reference, the buffer goes back to the pool once the pipeline is done with it */
   gst_buffer_unref(buffer);
 
   if (ret != GST_FLOW_OK) {
@@ -117,6 +134,8 @@ static gboolean push_data(CustomData *data) {
 }
 
 static void start_feed(GstElement *source, guint size, CustomData *data) {
+  feed_controller_need_data(&data->feed);
+
   if (data->sourceid == 0) {
     g_print("Start feeding\n");
     data->sourceid = g_idle_add((GSourceFunc)push_data, data);
@@ -124,11 +143,35 @@ static void start_feed(GstElement *source, guint size, CustomData *data) {
 }
 
 static void stop_feed(GstElement *source, CustomData *data) {
+  guint chunk_size;
+  guint64 max_bytes;
+
   if (data->sourceid != 0) {
     g_print("Stop feeding\n");
     g_source_remove(data->sourceid);
     data->sourceid = 0;
   }
+
+  if (feed_controller_enough_data(&data->feed, &chunk_size, &max_bytes)) {
+    FeedControllerStats stats;
+
+    feed_controller_get_stats(&data->feed, &stats);
+    g_print("Feed: %.1f cycles/s at %.0f bytes/s, now %u bytes per chunk and max-bytes %" G_GUINT64_FORMAT
+            " (%" G_GUINT64_FORMAT " grows, %" G_GUINT64_FORMAT " shrinks)\n",
+            stats.cycle_rate, stats.byte_rate, chunk_size, max_bytes, stats.grows, stats.shrinks);
+    apply_feed(data, chunk_size, max_bytes);
+  }
+}
+
+static void apply_feed(CustomData *data, guint chunk_size, guint64 max_bytes) {
+  g_object_set(data->app_source, "max-bytes", max_bytes, NULL);
+
+  /* Buffers of the old pool still in the pipeline are freed when they come back */
+  if (data->pool == NULL || chunk_size != data->chunk_size) {
+    producer_pool_free(data->pool);
+    data->pool = producer_pool_new(data->app_source, chunk_size, POOL_EXTRA);
+    data->chunk_size = chunk_size;
+  }
 }
 
 static void error_cb(GstBus *bus, GstMessage *msg, CustomData *data) {
@@ -159,4 +202,9 @@ static void source_setup(GstElement *pipeline, GstElement *source, CustomData *d
   g_signal_connect(source, "need-data", G_CALLBACK(start_feed), data);
   g_signal_connect(source, "enough-data", G_CALLBACK(stop_feed), data);
   gst_caps_unref(audio_caps);
+
+  /* Start with what the feed controller picked so far, the pool is sized from the max-bytes of the new source */
+  producer_pool_free(data->pool);
+  data->pool = NULL;
+  apply_feed(data, feed_controller_get_chunk_size(&data->feed), feed_controller_get_max_bytes(&data->feed));
 }
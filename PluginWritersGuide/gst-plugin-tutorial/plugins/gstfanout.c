@@ -0,0 +1,599 @@
+/*
+ * GStreamer
+ * Copyright (C) 2020  <<user@hostname.org>>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * SECTION:element-fanout
+ *
+ * Sends every buffer to all its source pads, like a tee with a queue on each
+ * branch but without their locks. Each source pad has a bounded single
+ * producer, single consumer ring and a task: the streaming thread of the sink
+ * pad puts a reference to the buffer in every ring and the task of each pad
+ * pushes it downstream. All the branches get the same buffer, with several
+ * references it is read-only and an element that wants to modify it makes its
+ * own copy.
+ *
+ * Serialized events go through the rings with the buffers, so that every
+ * branch sees them in order, and are never dropped. The policy property tells
+ * what happens when a branch doesn't keep up and its ring is full. The lag,
+ * max-lag, dropped and leaked properties of the source pads tell how far
+ * behind each branch is.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * GST_PLUGIN_PATH=<build>/plugins gst-launch-1.0 audiotestsrc ! fanout name=f policy=leak \
+ *     f. ! audioconvert ! autoaudiosink  f. ! wavescope ! videoconvert ! autovideosink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+
+#include "gstfanout.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_fanout_debug);
+#define GST_CAT_DEFAULT gst_fanout_debug
+
+#define DEFAULT_POLICY GST_FANOUT_POLICY_BLOCK
+#define DEFAULT_RING_SIZE 64
+#define MAX_RING_SIZE 65536
+
+enum { PROP_0, PROP_POLICY, PROP_RING_SIZE, PROP_NUM_SRC_PADS };
+
+enum { PROP_PAD_0, PROP_PAD_LAG, PROP_PAD_MAX_LAG, PROP_PAD_DROPPED, PROP_PAD_LEAKED };
+
+static GstStaticPadTemplate sink_factory =
+    GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate src_factory =
+    GST_STATIC_PAD_TEMPLATE("src_%u", GST_PAD_SRC, GST_PAD_REQUEST, GST_STATIC_CAPS_ANY);
+
+GType gst_fanout_policy_get_type(void) {
+  static gsize type = 0;
+  static const GEnumValue values[] = {
+      {GST_FANOUT_POLICY_DROP, "Drop the new buffer for the slow branch", "drop"},
+      {GST_FANOUT_POLICY_BLOCK, "Wait for the slow branch", "block"},
+      {GST_FANOUT_POLICY_LEAK, "Drop the new buffer and skip the old ones of the slow branch", "leak"},
+      {0, NULL, NULL}};
+
+  if (g_once_init_enter(&type)) {
+    GType tmp = g_enum_register_static("GstFanoutPolicy", values);
+
+    g_once_init_leave(&type, tmp);
+  }
+
+  return type;
+}
+
+/* GstFanoutPad */
+
+G_DEFINE_TYPE(GstFanoutPad, gst_fanout_pad, GST_TYPE_PAD);
+
+static void gst_fanout_pad_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec) {
+  GstFanoutPad *pad = GST_FANOUT_PAD(object);
+
+  switch (prop_id) {
+  case PROP_PAD_LAG:
+    GST_OBJECT_LOCK(pad);
+    g_value_set_uint(value, spsc_ring_get_occupancy(pad->ring));
+    GST_OBJECT_UNLOCK(pad);
+    break;
+  case PROP_PAD_MAX_LAG:
+    g_value_set_uint(value, pad->max_lag);
+    break;
+  case PROP_PAD_DROPPED:
+    g_value_set_uint64(value, pad->dropped);
+    break;
+  case PROP_PAD_LEAKED:
+    GST_OBJECT_LOCK(pad);
+    g_value_set_uint64(value, pad->leaked);
+    GST_OBJECT_UNLOCK(pad);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void gst_fanout_pad_finalize(GObject *object) {
+  GstFanoutPad *pad = GST_FANOUT_PAD(object);
+
+  spsc_ring_free(pad->ring, (GDestroyNotify)gst_mini_object_unref);
+
+  G_OBJECT_CLASS(gst_fanout_pad_parent_class)->finalize(object);
+}
+
+static void gst_fanout_pad_class_init(GstFanoutPadClass *klass) {
+  GObjectClass *gobject_class = (GObjectClass *)klass;
+
+  gobject_class->get_property = gst_fanout_pad_get_property;
+  gobject_class->finalize = gst_fanout_pad_finalize;
+
+  g_object_class_install_property(
+      gobject_class, PROP_PAD_LAG,
+      g_param_spec_uint("lag", "Lag", "Buffers and events waiting in the ring of the branch", 0, G_MAXUINT, 0,
+                        G_PARAM_READABLE));
+  g_object_class_install_property(gobject_class, PROP_PAD_MAX_LAG,
+                                  g_param_spec_uint("max-lag", "Max lag", "Highest lag of the branch", 0, G_MAXUINT, 0,
+                                                    G_PARAM_READABLE));
+  g_object_class_install_property(gobject_class, PROP_PAD_DROPPED,
+                                  g_param_spec_uint64("dropped", "Dropped",
+                                                      "Buffers the branch missed with the drop policy", 0, G_MAXUINT64,
+                                                      0, G_PARAM_READABLE));
+  g_object_class_install_property(gobject_class, PROP_PAD_LEAKED,
+                                  g_param_spec_uint64("leaked", "Leaked",
+                                                      "Buffers the branch skipped with the leak policy", 0, G_MAXUINT64,
+                                                      0, G_PARAM_READABLE));
+}
+
+static void gst_fanout_pad_init(GstFanoutPad *pad) {
+  pad->ring_size = DEFAULT_RING_SIZE;
+  pad->ring = spsc_ring_new(pad->ring_size);
+  pad->flushing = 1;
+  pad->last_flow = GST_FLOW_OK;
+}
+
+/* Starts over with an empty ring, only while neither the producer nor the task use it */
+static void gst_fanout_pad_reset(GstFanoutPad *pad) {
+  SpscRing *old;
+
+  GST_OBJECT_LOCK(pad);
+  old = pad->ring;
+  pad->ring = spsc_ring_new(pad->ring_size);
+  GST_OBJECT_UNLOCK(pad);
+  spsc_ring_free(old, (GDestroyNotify)gst_mini_object_unref);
+
+  g_atomic_int_set(&pad->leak_pending, 0);
+  g_atomic_int_set(&pad->last_flow, GST_FLOW_OK);
+  g_atomic_int_set(&pad->flushing, 0);
+}
+
+/* Closes the ring, which wakes up the producer and the task if they wait on it */
+static void gst_fanout_pad_close(GstFanoutPad *pad) {
+  g_atomic_int_set(&pad->flushing, 1);
+  spsc_ring_close(pad->ring);
+}
+
+/* Producer side: puts a reference to the buffer in the ring, returns the flow of the branch. Only the block policy
+ * waits for room. */
+static GstFlowReturn gst_fanout_pad_queue_buffer(GstFanoutPad *pad, GstBuffer *buffer, GstFanoutPolicy policy) {
+  gboolean queued;
+  guint lag;
+
+  gst_buffer_ref(buffer);
+  queued = spsc_ring_push(pad->ring, buffer, policy == GST_FANOUT_POLICY_BLOCK);
+  if (!queued && !g_atomic_int_get(&pad->flushing)) {
+    gst_buffer_unref(buffer);
+
+    if (policy == GST_FANOUT_POLICY_DROP) {
+      pad->dropped++;
+    } else {
+      /* leak: the task skips the old buffers at its next pop, the branch goes on with the next new one */
+      GST_OBJECT_LOCK(pad);
+      pad->leaked++;
+      GST_OBJECT_UNLOCK(pad);
+      g_atomic_int_set(&pad->leak_pending, 1);
+    }
+
+    return g_atomic_int_get(&pad->last_flow);
+  }
+
+  if (!queued) {
+    gst_buffer_unref(buffer);
+
+    /* As with tee, a released branch is not linked anymore, it must not stop the other ones */
+    return g_atomic_int_get(&pad->removed) ? GST_FLOW_NOT_LINKED : GST_FLOW_FLUSHING;
+  }
+
+  lag = spsc_ring_get_occupancy(pad->ring);
+  if (lag > pad->max_lag)
+    pad->max_lag = lag;
+
+  return g_atomic_int_get(&pad->last_flow);
+}
+
+/* Producer side: events are never dropped, whatever the policy */
+static gboolean gst_fanout_pad_queue_event(GstFanoutPad *pad, GstEvent *event) {
+  gst_event_ref(event);
+  if (!spsc_ring_push(pad->ring, event, TRUE)) {
+    gst_event_unref(event);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void gst_fanout_pad_forward(GstFanoutPad *pad, GstMiniObject *item) {
+  if (GST_IS_BUFFER(item))
+    g_atomic_int_set(&pad->last_flow, gst_pad_push(GST_PAD(pad), GST_BUFFER_CAST(item)));
+  else
+    gst_pad_push_event(GST_PAD(pad), GST_EVENT_CAST(item));
+}
+
+/* Consumer side, the task of the source pad */
+static void gst_fanout_pad_loop(GstFanoutPad *pad) {
+  GstMiniObject *item, *next;
+
+  item = spsc_ring_pop_wait(pad->ring);
+  if (item == NULL) {
+    GST_DEBUG_OBJECT(pad, "ring closed, pausing");
+    gst_pad_pause_task(GST_PAD(pad));
+    return;
+  }
+
+  /* The producer found the ring full with the leak policy: go on with the newest buffer. The events in between are
+   * still pushed, in order. */
+  if (g_atomic_int_compare_and_exchange(&pad->leak_pending, 1, 0)) {
+    while ((next = spsc_ring_pop(pad->ring)) != NULL) {
+      if (GST_IS_BUFFER(item)) {
+        gst_mini_object_unref(item);
+        GST_OBJECT_LOCK(pad);
+        pad->leaked++;
+        GST_OBJECT_UNLOCK(pad);
+      } else {
+        gst_fanout_pad_forward(pad, item);
+      }
+      item = next;
+    }
+  }
+
+  gst_fanout_pad_forward(pad, item);
+}
+
+static gboolean gst_fanout_src_activate_mode(GstPad *pad, GstObject *parent, GstPadMode mode, gboolean active) {
+  GstFanoutPad *fanout_pad = GST_FANOUT_PAD(pad);
+
+  if (mode != GST_PAD_MODE_PUSH)
+    return FALSE;
+
+  if (active) {
+    gst_fanout_pad_reset(fanout_pad);
+    return gst_pad_start_task(pad, (GstTaskFunction)gst_fanout_pad_loop, pad, NULL);
+  }
+
+  gst_fanout_pad_close(fanout_pad);
+  return gst_pad_stop_task(pad);
+}
+
+/* GstFanout */
+
+#define gst_fanout_parent_class parent_class
+G_DEFINE_TYPE(GstFanout, gst_fanout, GST_TYPE_ELEMENT);
+
+static void gst_fanout_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
+static void gst_fanout_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+static void gst_fanout_finalize(GObject *object);
+
+static GstPad *gst_fanout_request_new_pad(GstElement *element, GstPadTemplate *templ, const gchar *name,
+                                          const GstCaps *caps);
+static void gst_fanout_release_pad(GstElement *element, GstPad *pad);
+
+static GstFlowReturn gst_fanout_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer);
+static gboolean gst_fanout_sink_event(GstPad *pad, GstObject *parent, GstEvent *event);
+static gboolean gst_fanout_sink_query(GstPad *pad, GstObject *parent, GstQuery *query);
+
+static void gst_fanout_class_init(GstFanoutClass *klass) {
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+
+  gobject_class = (GObjectClass *)klass;
+  gstelement_class = (GstElementClass *)klass;
+
+  gobject_class->set_property = gst_fanout_set_property;
+  gobject_class->get_property = gst_fanout_get_property;
+  gobject_class->finalize = gst_fanout_finalize;
+
+  g_object_class_install_property(gobject_class, PROP_POLICY,
+                                  g_param_spec_enum("policy", "Policy", "What to do when a branch falls behind",
+                                                    GST_TYPE_FANOUT_POLICY, DEFAULT_POLICY, G_PARAM_READWRITE));
+  g_object_class_install_property(gobject_class, PROP_RING_SIZE,
+                                  g_param_spec_uint("ring-size", "Ring size",
+                                                    "Buffers and events a branch can lag behind, rounded up to a power "
+                                                    "of two. Applies to the pads requested afterwards",
+                                                    1, MAX_RING_SIZE, DEFAULT_RING_SIZE, G_PARAM_READWRITE));
+  g_object_class_install_property(gobject_class, PROP_NUM_SRC_PADS,
+                                  g_param_spec_uint("num-src-pads", "Num src pads", "Number of branches", 0, G_MAXUINT,
+                                                    0, G_PARAM_READABLE));
+
+  gst_element_class_set_details_simple(gstelement_class, "Fanout", "Generic",
+                                       "Sends every buffer to all source pads through lock-free rings",
+                                       " <<user@hostname.org>>");
+
+  gst_element_class_add_pad_template(gstelement_class, gst_static_pad_template_get(&sink_factory));
+  gst_element_class_add_pad_template(gstelement_class, gst_static_pad_template_get(&src_factory));
+
+  gstelement_class->request_new_pad = GST_DEBUG_FUNCPTR(gst_fanout_request_new_pad);
+  gstelement_class->release_pad = GST_DEBUG_FUNCPTR(gst_fanout_release_pad);
+}
+
+static void gst_fanout_init(GstFanout *fanout) {
+  fanout->sinkpad = gst_pad_new_from_static_template(&sink_factory, "sink");
+  gst_pad_set_chain_function(fanout->sinkpad, GST_DEBUG_FUNCPTR(gst_fanout_chain));
+  gst_pad_set_event_function(fanout->sinkpad, GST_DEBUG_FUNCPTR(gst_fanout_sink_event));
+  gst_pad_set_query_function(fanout->sinkpad, GST_DEBUG_FUNCPTR(gst_fanout_sink_query));
+  /* caps queries get the intersection of the caps of all branches */
+  GST_PAD_SET_PROXY_CAPS(fanout->sinkpad);
+  gst_element_add_pad(GST_ELEMENT(fanout), fanout->sinkpad);
+
+  fanout->policy = DEFAULT_POLICY;
+  fanout->ring_size = DEFAULT_RING_SIZE;
+  fanout->branches = g_ptr_array_new_with_free_func(gst_object_unref);
+  fanout->next_pad_id = 0;
+}
+
+static void gst_fanout_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec) {
+  GstFanout *fanout = GST_FANOUT(object);
+
+  switch (prop_id) {
+  case PROP_POLICY:
+    GST_OBJECT_LOCK(fanout);
+    fanout->policy = g_value_get_enum(value);
+    GST_OBJECT_UNLOCK(fanout);
+    break;
+  case PROP_RING_SIZE:
+    GST_OBJECT_LOCK(fanout);
+    fanout->ring_size = g_value_get_uint(value);
+    GST_OBJECT_UNLOCK(fanout);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void gst_fanout_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec) {
+  GstFanout *fanout = GST_FANOUT(object);
+
+  switch (prop_id) {
+  case PROP_POLICY:
+    GST_OBJECT_LOCK(fanout);
+    g_value_set_enum(value, fanout->policy);
+    GST_OBJECT_UNLOCK(fanout);
+    break;
+  case PROP_RING_SIZE:
+    GST_OBJECT_LOCK(fanout);
+    g_value_set_uint(value, fanout->ring_size);
+    GST_OBJECT_UNLOCK(fanout);
+    break;
+  case PROP_NUM_SRC_PADS:
+    GST_OBJECT_LOCK(fanout);
+    g_value_set_uint(value, fanout->branches->len);
+    GST_OBJECT_UNLOCK(fanout);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void gst_fanout_finalize(GObject *object) {
+  GstFanout *fanout = GST_FANOUT(object);
+
+  g_ptr_array_unref(fanout->branches);
+
+  G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+/* The current branches, the list stays valid while the caller holds the reference */
+static GPtrArray *gst_fanout_get_branches(GstFanout *fanout) {
+  GPtrArray *branches;
+
+  GST_OBJECT_LOCK(fanout);
+  branches = g_ptr_array_ref(fanout->branches);
+  GST_OBJECT_UNLOCK(fanout);
+
+  return branches;
+}
+
+/* Replaces the branches by a copy with add appended and remove left out, call with the object lock */
+static void gst_fanout_update_branches(GstFanout *fanout, GstPad *add, GstPad *remove) {
+  GPtrArray *branches = g_ptr_array_new_full(fanout->branches->len + 1, gst_object_unref);
+
+  for (guint i = 0; i < fanout->branches->len; i++) {
+    GstPad *pad = g_ptr_array_index(fanout->branches, i);
+
+    if (pad != remove)
+      g_ptr_array_add(branches, gst_object_ref(pad));
+  }
+  if (add)
+    g_ptr_array_add(branches, gst_object_ref(add));
+
+  g_ptr_array_unref(fanout->branches);
+  fanout->branches = branches;
+}
+
+static gboolean gst_fanout_copy_sticky_event(GstPad *pad, GstEvent **event, gpointer user_data) {
+  if (GST_EVENT_TYPE(*event) != GST_EVENT_EOS)
+    gst_pad_store_sticky_event(GST_PAD(user_data), *event);
+
+  return TRUE;
+}
+
+static GstPad *gst_fanout_request_new_pad(GstElement *element, GstPadTemplate *templ, const gchar *name,
+                                          const GstCaps *caps) {
+  GstFanout *fanout = GST_FANOUT(element);
+  GstFanoutPad *pad;
+  gchar *pad_name;
+  guint id, ring_size;
+  gboolean streaming;
+
+  GST_OBJECT_LOCK(fanout);
+  if (name == NULL || sscanf(name, "src_%u", &id) != 1)
+    id = fanout->next_pad_id;
+  fanout->next_pad_id = MAX(fanout->next_pad_id, id + 1);
+  ring_size = fanout->ring_size;
+  streaming = GST_STATE(fanout) > GST_STATE_READY;
+  GST_OBJECT_UNLOCK(fanout);
+
+  pad_name = g_strdup_printf("src_%u", id);
+  pad = g_object_new(GST_TYPE_FANOUT_PAD, "name", pad_name, "direction", templ->direction, "template", templ, NULL);
+  g_free(pad_name);
+
+  pad->ring_size = ring_size;
+  gst_pad_set_activatemode_function(GST_PAD(pad), GST_DEBUG_FUNCPTR(gst_fanout_src_activate_mode));
+
+  /* A branch added while streaming starts its task now and gets the current caps and segment with its first buffer */
+  if (streaming) {
+    gst_pad_set_active(GST_PAD(pad), TRUE);
+    gst_pad_sticky_events_foreach(fanout->sinkpad, gst_fanout_copy_sticky_event, pad);
+  }
+
+  /* adding the pad takes the floating reference, and drops it when the name is already used */
+  gst_object_ref(pad);
+  if (!gst_element_add_pad(element, GST_PAD(pad))) {
+    GST_WARNING_OBJECT(fanout, "pad %s already exists", GST_OBJECT_NAME(pad));
+    gst_pad_set_active(GST_PAD(pad), FALSE);
+    gst_object_unref(pad);
+
+    return NULL;
+  }
+
+  GST_OBJECT_LOCK(fanout);
+  gst_fanout_update_branches(fanout, GST_PAD(pad), NULL);
+  GST_OBJECT_UNLOCK(fanout);
+  gst_object_unref(pad);
+
+  return GST_PAD(pad);
+}
+
+static void gst_fanout_release_pad(GstElement *element, GstPad *pad) {
+  GstFanout *fanout = GST_FANOUT(element);
+
+  /* the streaming thread may still push to the ring with an older list, until the ring is closed. It gets
+   * GST_FLOW_NOT_LINKED from then on, also when it was waiting for room. */
+  GST_OBJECT_LOCK(fanout);
+  gst_fanout_update_branches(fanout, NULL, pad);
+  GST_OBJECT_UNLOCK(fanout);
+  g_atomic_int_set(&GST_FANOUT_PAD(pad)->removed, 1);
+
+  gst_pad_set_active(pad, FALSE);
+  gst_element_remove_pad(element, pad);
+}
+
+static GstFlowReturn gst_fanout_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer) {
+  GstFanout *fanout = GST_FANOUT(parent);
+  GstFanoutPolicy policy;
+  GPtrArray *branches;
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint n_ok = 0, n_eos = 0;
+
+  GST_OBJECT_LOCK(fanout);
+  branches = g_ptr_array_ref(fanout->branches);
+  policy = fanout->policy;
+  GST_OBJECT_UNLOCK(fanout);
+
+  for (guint i = 0; i < branches->len; i++) {
+    GstFlowReturn flow = gst_fanout_pad_queue_buffer(g_ptr_array_index(branches, i), buffer, policy);
+
+    if (flow == GST_FLOW_OK)
+      n_ok++;
+    else if (flow == GST_FLOW_EOS)
+      n_eos++;
+    else if (flow != GST_FLOW_NOT_LINKED && ret == GST_FLOW_OK)
+      ret = flow;
+  }
+
+  /* As with tee the stream goes on while one branch takes it, flushing and errors stop it */
+  if (ret == GST_FLOW_OK && n_ok == 0)
+    ret = n_eos > 0 && n_eos == branches->len ? GST_FLOW_EOS : GST_FLOW_NOT_LINKED;
+
+  g_ptr_array_unref(branches);
+  gst_buffer_unref(buffer);
+
+  return ret;
+}
+
+static gboolean gst_fanout_sink_event(GstPad *pad, GstObject *parent, GstEvent *event) {
+  GstFanout *fanout = GST_FANOUT(parent);
+  GPtrArray *branches = gst_fanout_get_branches(fanout);
+  gboolean ret = TRUE;
+
+  switch (GST_EVENT_TYPE(event)) {
+  case GST_EVENT_FLUSH_START:
+    /* Unblock the tasks pushing downstream first, then the producer and the tasks waiting on the rings */
+    ret = gst_pad_event_default(pad, parent, event);
+    for (guint i = 0; i < branches->len; i++) {
+      GstFanoutPad *srcpad = g_ptr_array_index(branches, i);
+
+      gst_fanout_pad_close(srcpad);
+      gst_pad_pause_task(GST_PAD(srcpad));
+    }
+    break;
+  case GST_EVENT_FLUSH_STOP:
+    /* The streaming thread is stopped, start again from empty rings */
+    for (guint i = 0; i < branches->len; i++) {
+      GstFanoutPad *srcpad = g_ptr_array_index(branches, i);
+
+      if (GST_PAD_IS_ACTIVE(srcpad))
+        gst_fanout_pad_reset(srcpad);
+    }
+    ret = gst_pad_event_default(pad, parent, event);
+    for (guint i = 0; i < branches->len; i++) {
+      GstPad *srcpad = g_ptr_array_index(branches, i);
+
+      if (GST_PAD_IS_ACTIVE(srcpad))
+        gst_pad_start_task(srcpad, (GstTaskFunction)gst_fanout_pad_loop, srcpad, NULL);
+    }
+    break;
+  default:
+    if (!GST_EVENT_IS_SERIALIZED(event)) {
+      ret = gst_pad_event_default(pad, parent, event);
+      break;
+    }
+
+    /* Serialized events are queued with the buffers, so that each branch gets them in order */
+    for (guint i = 0; i < branches->len; i++)
+      gst_fanout_pad_queue_event(g_ptr_array_index(branches, i), event);
+    gst_event_unref(event);
+    break;
+  }
+
+  g_ptr_array_unref(branches);
+
+  return ret;
+}
+
+static gboolean gst_fanout_sink_query(GstPad *pad, GstObject *parent, GstQuery *query) {
+  switch (GST_QUERY_TYPE(query)) {
+  case GST_QUERY_ALLOCATION:
+    /* the buffers are shared by all branches, none of them can provide the pool */
+    return FALSE;
+  default:
+    return gst_pad_query_default(pad, parent, query);
+  }
+}
+
+static gboolean fanout_init(GstPlugin *plugin) {
+  GST_DEBUG_CATEGORY_INIT(gst_fanout_debug, "fanout", 0, "lock-free fan-out to many branches");
+
+  return gst_element_register(plugin, "fanout", GST_RANK_NONE, GST_TYPE_FANOUT);
+}
+
+#ifndef PACKAGE
+#define PACKAGE "myfirstmyfilter"
+#endif
+
+GST_PLUGIN_DEFINE(GST_VERSION_MAJOR, GST_VERSION_MINOR, fanout, "Lock-free fan-out to many branches", fanout_init,
+                  "0.1.0", "LGPL", "MyFilter", "Realtek")
@@ -0,0 +1,83 @@
+/*
+ * GStreamer
+ * Copyright (C) 2020  <<user@hostname.org>>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_FANOUT_H__
+#define __GST_FANOUT_H__
+
+#include <gst/gst.h>
+
+#include "spsc_ring.h"
+
+G_BEGIN_DECLS
+
+/* What a branch does with a new buffer when its ring is full */
+typedef enum {
+  GST_FANOUT_POLICY_DROP,  /* the new buffer is dropped for that branch */
+  GST_FANOUT_POLICY_BLOCK, /* the producer waits for room, the slowest branch sets the pace */
+  GST_FANOUT_POLICY_LEAK,  /* the new buffer is dropped and the branch skips the ones it has not pushed yet */
+} GstFanoutPolicy;
+
+#define GST_TYPE_FANOUT_POLICY (gst_fanout_policy_get_type())
+GType gst_fanout_policy_get_type(void);
+
+#define GST_TYPE_FANOUT_PAD (gst_fanout_pad_get_type())
+G_DECLARE_FINAL_TYPE(GstFanoutPad, gst_fanout_pad, GST, FANOUT_PAD, GstPad)
+
+/* One branch: the source pad, its ring and the task pushing what comes out of the ring */
+struct _GstFanoutPad {
+  GstPad parent;
+
+  /* the sink pad streaming thread is the only producer and the pad task the only consumer. The ring is only replaced
+   * while both are stopped, under the object lock so that the properties can read it. */
+  SpscRing *ring;
+  guint ring_size;
+
+  gint flushing;     /* set when the ring is closed for a flush or a deactivation */
+  gint removed;      /* set when the pad is released, the producer may still hold it in an older list */
+  gint leak_pending; /* set by the producer when it found the ring full under the leak policy */
+  gint last_flow;    /* GstFlowReturn of the last buffer pushed downstream */
+
+  /* lag counters, read without locking. max_lag and dropped have a single writer, leaked is written by both sides
+   * under the object lock. */
+  guint max_lag;
+  guint64 dropped;
+  guint64 leaked;
+};
+
+#define GST_TYPE_FANOUT (gst_fanout_get_type())
+G_DECLARE_FINAL_TYPE(GstFanout, gst_fanout, GST, FANOUT, GstElement)
+
+struct _GstFanout {
+  GstElement element;
+
+  GstPad *sinkpad;
+
+  /* protected by the object lock. branches is never modified, requesting or releasing a pad replaces it, so that the
+   * streaming thread only takes the lock to get a reference. */
+  GstFanoutPolicy policy;
+  guint ring_size;
+  GPtrArray *branches;
+  guint next_pad_id;
+};
+
+G_END_DECLS
+
+#endif /* __GST_FANOUT_H__ */
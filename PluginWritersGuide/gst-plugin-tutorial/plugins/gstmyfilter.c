@@ -46,12 +46,36 @@
 /**
  * SECTION:element-myfilter
  *
- * FIXME:Describe myfilter here.
+ * myfilter adjusts the brightness and contrast of raw video. The luma plane of
+ * I420 and NV12 and the color components of RGBA are processed in place with
+ * the fastest kernel the CPU supports (AVX2, SSE2 or a scalar table lookup),
+ * chosen once when the caps are set. The "kernel" property reports the choice.
+ *
+ * With the default settings there is nothing to do and the element runs in
+ * passthrough mode: buffers are handed downstream without being touched,
+ * mapped or copied.
+ *
+ * With "n-threads" other than 1 every frame is cut into horizontal slices that
+ * are processed in parallel. The streaming thread takes the first slice, the
+ * others go to worker threads that are started when the element goes to READY
+ * and are reused for every frame.
+ *
+ * Writable input buffers are processed in place. When upstream still holds a
+ * reference, the result is written straight into a buffer from the pool agreed
+ * on in the allocation query: downstream's pool when it offers one, otherwise
+ * our own pre-allocated, 32 byte aligned #GstVideoBufferPool. Upstream is
+ * offered the same kind of pool, so in steady state nothing is allocated.
+ *
+ * Buffer lists still go through basetransform buffer by buffer, so QoS,
+ * segment tracking and discont marking work as usual, but the output is
+ * collected and pushed downstream as a list: the downstream dispatch and
+ * locking is paid once per list.
  *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
- * gst-launch -v -m fakesrc ! myfilter ! fakesink silent=TRUE
+ * gst-launch-1.0 -v videotestsrc ! myfilter brightness=40 contrast=1.2 ! videoconvert ! autovideosink
+ * gst-launch-1.0 videotestsrc ! video/x-raw,width=3840,height=2160 ! myfilter contrast=1.5 n-threads=0 ! fakesink
  * ]|
  * </refsect2>
  */
@@ -61,38 +85,80 @@
 #endif
 
 #include <gst/gst.h>
+#include <gst/video/gstvideopool.h>
 
 #include "gstmyfilter.h"
 
 GST_DEBUG_CATEGORY_STATIC(gst_my_filter_debug);
 #define GST_CAT_DEFAULT gst_my_filter_debug
 
+#define DEFAULT_BRIGHTNESS 0
+#define DEFAULT_CONTRAST 1.0
+#define DEFAULT_N_THREADS 1
+#define MAX_N_THREADS 64
+
+/* buffers allocated up front when a pool is activated */
+#define MIN_POOL_BUFFERS 4
+/* alignment of the buffer memory, the width of an AVX2 register */
+#define MEMORY_ALIGN 32
+
 /* Filter signals and args */
 enum {
   /* FILL ME */
   LAST_SIGNAL
 };
 
-enum { PROP_0, PROP_SILENT };
+enum { PROP_0, PROP_SILENT, PROP_BRIGHTNESS, PROP_CONTRAST, PROP_KERNEL, PROP_N_THREADS };
+
+/* A band of rows of one frame, processed by one thread */
+typedef struct _GstMyFilterSlice {
+  GstMyFilterKernelFunc process;
+  const GstMyFilterKernelParams *params;
+
+  const guint8 *src;
+  guint8 *dest;
+  gint src_stride, dest_stride;
+  gint row_size;
+  gint n_rows;
+} GstMyFilterSlice;
+
+/* the capabilities of the inputs and outputs. */
+#define MYFILTER_VIDEO_CAPS GST_VIDEO_CAPS_MAKE("{ I420, NV12, RGBA }")
 
-/* the capabilities of the inputs and outputs.
- *
- * describe the real formats here.
- */
 static GstStaticPadTemplate sink_factory =
-    GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS("ANY"));
+    GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS(MYFILTER_VIDEO_CAPS));
 
 static GstStaticPadTemplate src_factory =
-    GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS("ANY"));
+    GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS(MYFILTER_VIDEO_CAPS));
 
 #define gst_my_filter_parent_class parent_class
-G_DEFINE_TYPE(GstMyFilter, gst_my_filter, GST_TYPE_ELEMENT);
+G_DEFINE_TYPE(GstMyFilter, gst_my_filter, GST_TYPE_VIDEO_FILTER);
 
 static void gst_my_filter_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
 static void gst_my_filter_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+static void gst_my_filter_finalize(GObject *object);
+
+static GstStateChangeReturn gst_my_filter_change_state(GstElement *element, GstStateChange transition);
+
+static gboolean gst_my_filter_start(GstBaseTransform *trans);
+static gboolean gst_my_filter_propose_allocation(GstBaseTransform *trans, GstQuery *decide_query, GstQuery *query);
+static gboolean gst_my_filter_decide_allocation(GstBaseTransform *trans, GstQuery *query);
+static GstFlowReturn gst_my_filter_prepare_output_buffer(GstBaseTransform *trans, GstBuffer *inbuf,
+                                                         GstBuffer **outbuf);
+static GstFlowReturn gst_my_filter_transform(GstBaseTransform *trans, GstBuffer *inbuf, GstBuffer *outbuf);
+
+static GstFlowReturn gst_my_filter_chain_list(GstPad *pad, GstObject *parent, GstBufferList *list);
+static GstPadProbeReturn gst_my_filter_collect_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+
+static gboolean gst_my_filter_set_info(GstVideoFilter *vfilter, GstCaps *incaps, GstVideoInfo *in_info,
+                                       GstCaps *outcaps, GstVideoInfo *out_info);
+static GstFlowReturn gst_my_filter_transform_frame(GstVideoFilter *vfilter, GstVideoFrame *in_frame,
+                                                    GstVideoFrame *out_frame);
+static GstFlowReturn gst_my_filter_transform_frame_ip(GstVideoFilter *vfilter, GstVideoFrame *frame);
 
-static gboolean gst_my_filter_sink_event(GstPad *pad, GstObject *parent, GstEvent *event);
-static GstFlowReturn gst_my_filter_chain(GstPad *pad, GstObject *parent, GstBuffer *buf);
+static void gst_my_filter_update_params(GstMyFilter *filter);
+static gint gst_my_filter_get_n_threads(GstMyFilter *filter);
+static void gst_my_filter_slice_worker(gpointer data, gpointer user_data);
 
 /* GObject vmethod implementations */
 
@@ -100,41 +166,82 @@ static GstFlowReturn gst_my_filter_chain(GstPad *pad, GstObject *parent, GstBuff
 static void gst_my_filter_class_init(GstMyFilterClass *klass) {
   GObjectClass *gobject_class;
   GstElementClass *gstelement_class;
+  GstBaseTransformClass *gstbasetransform_class;
+  GstVideoFilterClass *gstvideofilter_class;
 
   gobject_class = (GObjectClass *)klass;
   gstelement_class = (GstElementClass *)klass;
+  gstbasetransform_class = (GstBaseTransformClass *)klass;
+  gstvideofilter_class = (GstVideoFilterClass *)klass;
 
   gobject_class->set_property = gst_my_filter_set_property;
   gobject_class->get_property = gst_my_filter_get_property;
+  gobject_class->finalize = gst_my_filter_finalize;
 
   g_object_class_install_property(
       gobject_class, PROP_SILENT,
       g_param_spec_boolean("silent", "Silent", "Produce verbose output ?", FALSE, G_PARAM_READWRITE));
+  g_object_class_install_property(gobject_class, PROP_BRIGHTNESS,
+                                  g_param_spec_int("brightness", "Brightness", "Value added to every component", -255,
+                                                   255, DEFAULT_BRIGHTNESS, G_PARAM_READWRITE));
+  g_object_class_install_property(gobject_class, PROP_CONTRAST,
+                                  g_param_spec_double("contrast", "Contrast", "Contrast scale around mid-gray", 0.0,
+                                                      2.0, DEFAULT_CONTRAST, G_PARAM_READWRITE));
+  g_object_class_install_property(
+      gobject_class, PROP_KERNEL,
+      g_param_spec_string("kernel", "Kernel", "Processing kernel in use (scalar, sse2, avx2)", NULL, G_PARAM_READABLE));
+  g_object_class_install_property(gobject_class, PROP_N_THREADS,
+                                  g_param_spec_int("n-threads", "Threads",
+                                                   "Number of threads processing slices of a frame (0 = automatic)", 0,
+                                                   MAX_N_THREADS, DEFAULT_N_THREADS, G_PARAM_READWRITE));
 
-  gst_element_class_set_details_simple(gstelement_class, "MyFilter", "FIXME:Generic", "FIXME:Generic Template Element",
-                                       " <<user@hostname.org>>");
+  gst_element_class_set_details_simple(gstelement_class, "MyFilter", "Filter/Effect/Video",
+                                       "Adjusts brightness and contrast of raw video", " <<user@hostname.org>>");
 
   gst_element_class_add_pad_template(gstelement_class, gst_static_pad_template_get(&src_factory));
   gst_element_class_add_pad_template(gstelement_class, gst_static_pad_template_get(&sink_factory));
+
+  gstelement_class->change_state = GST_DEBUG_FUNCPTR(gst_my_filter_change_state);
+
+  gstbasetransform_class->start = GST_DEBUG_FUNCPTR(gst_my_filter_start);
+  gstbasetransform_class->propose_allocation = GST_DEBUG_FUNCPTR(gst_my_filter_propose_allocation);
+  gstbasetransform_class->decide_allocation = GST_DEBUG_FUNCPTR(gst_my_filter_decide_allocation);
+  gstbasetransform_class->prepare_output_buffer = GST_DEBUG_FUNCPTR(gst_my_filter_prepare_output_buffer);
+  gstbasetransform_class->transform = GST_DEBUG_FUNCPTR(gst_my_filter_transform);
+  /* In passthrough mode there is nothing to look at, don't even map the buffers */
+  gstbasetransform_class->transform_ip_on_passthrough = FALSE;
+
+  gstvideofilter_class->set_info = GST_DEBUG_FUNCPTR(gst_my_filter_set_info);
+  gstvideofilter_class->transform_frame = GST_DEBUG_FUNCPTR(gst_my_filter_transform_frame);
+  gstvideofilter_class->transform_frame_ip = GST_DEBUG_FUNCPTR(gst_my_filter_transform_frame_ip);
 }
 
 /* initialize the new element
- * instantiate pads and add them to element
- * set pad calback functions
+ * GstBaseTransform creates the pads and installs the chain and event functions
  * initialize instance structure
  */
 static void gst_my_filter_init(GstMyFilter *filter) {
-  filter->sinkpad = gst_pad_new_from_static_template(&sink_factory, "sink");
-  gst_pad_set_event_function(filter->sinkpad, GST_DEBUG_FUNCPTR(gst_my_filter_sink_event));
-  gst_pad_set_chain_function(filter->sinkpad, GST_DEBUG_FUNCPTR(gst_my_filter_chain));
-  GST_PAD_SET_PROXY_CAPS(filter->sinkpad);
-  gst_element_add_pad(GST_ELEMENT(filter), filter->sinkpad);
-
-  filter->srcpad = gst_pad_new_from_static_template(&src_factory, "src");
-  GST_PAD_SET_PROXY_CAPS(filter->srcpad);
-  gst_element_add_pad(GST_ELEMENT(filter), filter->srcpad);
+  GstBaseTransform *trans = GST_BASE_TRANSFORM(filter);
 
   filter->silent = FALSE;
+  filter->brightness = DEFAULT_BRIGHTNESS;
+  filter->contrast = DEFAULT_CONTRAST;
+  filter->kernel = gst_my_filter_kernel_get_best();
+  filter->n_threads = DEFAULT_N_THREADS;
+  g_mutex_init(&filter->slice_lock);
+  g_cond_init(&filter->slice_cond);
+
+  /* Not an always-in-place transform: that way basetransform runs the allocation query and gives us a pool. Writable
+   * buffers are still processed in place, see prepare_output_buffer. */
+  gst_base_transform_set_in_place(trans, FALSE);
+
+  /* basetransform only handles single buffers, take whole lists ourselves */
+  gst_pad_set_chain_list_function(GST_BASE_TRANSFORM_SINK_PAD(trans), GST_DEBUG_FUNCPTR(gst_my_filter_chain_list));
+  gst_pad_add_probe(GST_BASE_TRANSFORM_SRC_PAD(trans), GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                    gst_my_filter_collect_probe, filter, NULL);
+
+  /* Starts in passthrough, the default brightness and contrast don't change anything */
+  gst_my_filter_update_params(filter);
 }
 
 static void gst_my_filter_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec) {
@@ -144,6 +251,26 @@ static void gst_my_filter_set_property(GObject *object, guint prop_id, const GVa
   case PROP_SILENT:
     filter->silent = g_value_get_boolean(value);
     break;
+  case PROP_BRIGHTNESS:
+    GST_OBJECT_LOCK(filter);
+    filter->brightness = g_value_get_int(value);
+    GST_OBJECT_UNLOCK(filter);
+    gst_my_filter_update_params(filter);
+    break;
+  case PROP_CONTRAST:
+    GST_OBJECT_LOCK(filter);
+    filter->contrast = g_value_get_double(value);
+    GST_OBJECT_UNLOCK(filter);
+    gst_my_filter_update_params(filter);
+    break;
+  case PROP_N_THREADS:
+    GST_OBJECT_LOCK(filter);
+    filter->n_threads = g_value_get_int(value);
+    /* The pool only grows while it is running, slices may already be queued on the threads it has */
+    if (filter->workers && gst_my_filter_get_n_threads(filter) - 1 > g_thread_pool_get_max_threads(filter->workers))
+      g_thread_pool_set_max_threads(filter->workers, gst_my_filter_get_n_threads(filter) - 1, NULL);
+    GST_OBJECT_UNLOCK(filter);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -157,54 +284,502 @@ static void gst_my_filter_get_property(GObject *object, guint prop_id, GValue *v
   case PROP_SILENT:
     g_value_set_boolean(value, filter->silent);
     break;
+  case PROP_BRIGHTNESS:
+    GST_OBJECT_LOCK(filter);
+    g_value_set_int(value, filter->brightness);
+    GST_OBJECT_UNLOCK(filter);
+    break;
+  case PROP_CONTRAST:
+    GST_OBJECT_LOCK(filter);
+    g_value_set_double(value, filter->contrast);
+    GST_OBJECT_UNLOCK(filter);
+    break;
+  case PROP_KERNEL:
+    g_value_set_string(value, filter->kernel->name);
+    break;
+  case PROP_N_THREADS:
+    GST_OBJECT_LOCK(filter);
+    g_value_set_int(value, filter->n_threads);
+    GST_OBJECT_UNLOCK(filter);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
   }
 }
 
-/* GstElement vmethod implementations */
+static void gst_my_filter_finalize(GObject *object) {
+  GstMyFilter *filter = GST_MYFILTER(object);
+
+  g_mutex_clear(&filter->slice_lock);
+  g_cond_clear(&filter->slice_cond);
 
-/* this function handles sink events */
-static gboolean gst_my_filter_sink_event(GstPad *pad, GstObject *parent, GstEvent *event) {
-  GstMyFilter *filter;
-  gboolean ret;
+  G_OBJECT_CLASS(parent_class)->finalize(object);
+}
 
-  filter = GST_MYFILTER(parent);
+/* recompute the kernel parameters and switch passthrough on or off */
+static void gst_my_filter_update_params(GstMyFilter *filter) {
+  GstBaseTransform *trans = GST_BASE_TRANSFORM(filter);
+  gboolean passthrough;
 
-  GST_LOG_OBJECT(filter, "Received %s event: %" GST_PTR_FORMAT, GST_EVENT_TYPE_NAME(event), event);
+  GST_OBJECT_LOCK(filter);
+  gst_my_filter_kernel_params_init(&filter->params, filter->brightness, filter->contrast);
+  passthrough = filter->brightness == 0 && filter->params.contrast_q9 == 512;
+  GST_OBJECT_UNLOCK(filter);
 
-  switch (GST_EVENT_TYPE(event)) {
-  case GST_EVENT_CAPS: {
-    GstCaps *caps;
+  if (passthrough != gst_base_transform_is_passthrough(trans)) {
+    gst_base_transform_set_passthrough(trans, passthrough);
+    /* No pool is negotiated in passthrough, redo the allocation query before the next buffer */
+    gst_pad_mark_reconfigure(GST_BASE_TRANSFORM_SRC_PAD(trans));
+  }
+}
 
-    gst_event_parse_caps(event, &caps);
-    /* do something with the caps */
+/* number of slices per frame, called with the object lock held */
+static gint gst_my_filter_get_n_threads(GstMyFilter *filter) {
+  if (filter->n_threads == 0)
+    return MIN(g_get_num_processors(), MAX_N_THREADS);
+
+  return filter->n_threads;
+}
+
+/* GstElement vmethod implementations */
 
-    /* and forward */
-    ret = gst_pad_event_default(pad, parent, event);
+static GstStateChangeReturn gst_my_filter_change_state(GstElement *element, GstStateChange transition) {
+  GstMyFilter *filter = GST_MYFILTER(element);
+  GstStateChangeReturn ret;
+  GThreadPool *workers;
+  GError *err = NULL;
+
+  switch (transition) {
+  case GST_STATE_CHANGE_NULL_TO_READY:
+    /* Start the worker threads now, so no thread is ever created on the streaming thread */
+    GST_OBJECT_LOCK(filter);
+    filter->workers =
+        g_thread_pool_new(gst_my_filter_slice_worker, filter, gst_my_filter_get_n_threads(filter) - 1, TRUE, &err);
+    GST_OBJECT_UNLOCK(filter);
+
+    if (!filter->workers) {
+      GST_ELEMENT_ERROR(filter, RESOURCE, FAILED, ("Could not start worker threads"), ("%s", err->message));
+      g_clear_error(&err);
+
+      return GST_STATE_CHANGE_FAILURE;
+    }
+    break;
+  default:
     break;
   }
+
+  ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+
+  switch (transition) {
+  case GST_STATE_CHANGE_READY_TO_NULL:
+    GST_OBJECT_LOCK(filter);
+    workers = filter->workers;
+    filter->workers = NULL;
+    GST_OBJECT_UNLOCK(filter);
+
+    if (workers)
+      g_thread_pool_free(workers, TRUE, TRUE);
+    break;
   default:
-    ret = gst_pad_event_default(pad, parent, event);
     break;
   }
+
   return ret;
 }
 
-/* chain function
- * this function does the actual processing
- */
-static GstFlowReturn gst_my_filter_chain(GstPad *pad, GstObject *parent, GstBuffer *buf) {
-  GstMyFilter *filter;
+/* GstBaseTransform vmethod implementations */
 
-  filter = GST_MYFILTER(parent);
+/* called when the element starts processing */
+static gboolean gst_my_filter_start(GstBaseTransform *trans) {
+  GstMyFilter *filter = GST_MYFILTER(trans);
 
+  /* Say hello once per stream instead of once per buffer, stdout is far too slow for the streaming thread */
   if (filter->silent == FALSE)
     g_print("I'm plugged, therefore I'm in.\n");
 
-  /* just push out the incoming buffer without touching it */
-  return gst_pad_push(filter->srcpad, buf);
+  return TRUE;
+}
+
+static GstBufferPool *gst_my_filter_create_pool(GstCaps *caps, guint size, guint min, guint max,
+                                                GstAllocator *allocator, const GstAllocationParams *params) {
+  GstBufferPool *pool;
+  GstStructure *config;
+
+  pool = gst_video_buffer_pool_new();
+
+  config = gst_buffer_pool_get_config(pool);
+  gst_buffer_pool_config_set_params(config, caps, size, min, max);
+  gst_buffer_pool_config_set_allocator(config, allocator, params);
+  gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+
+  if (!gst_buffer_pool_set_config(pool, config)) {
+    gst_object_unref(pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+/* make sure the allocation params in the query ask for at least MEMORY_ALIGN */
+static void gst_my_filter_align_allocation_params(GstQuery *query, GstAllocator **allocator,
+                                                  GstAllocationParams *params) {
+  if (gst_query_get_n_allocation_params(query) > 0) {
+    gst_query_parse_nth_allocation_param(query, 0, allocator, params);
+    params->align = MAX(params->align, MEMORY_ALIGN - 1);
+    gst_query_set_nth_allocation_param(query, 0, *allocator, params);
+  } else {
+    *allocator = NULL;
+    gst_allocation_params_init(params);
+    params->align = MEMORY_ALIGN - 1;
+    gst_query_add_allocation_param(query, NULL, params);
+  }
+}
+
+/* upstream asks what buffers it should give us */
+static gboolean gst_my_filter_propose_allocation(GstBaseTransform *trans, GstQuery *decide_query, GstQuery *query) {
+  GstBufferPool *pool;
+  GstAllocator *allocator;
+  GstAllocationParams params;
+  GstVideoInfo info;
+  GstCaps *caps;
+
+  /* in passthrough basetransform forwards the query to downstream */
+  if (decide_query == NULL)
+    return GST_BASE_TRANSFORM_CLASS(parent_class)->propose_allocation(trans, decide_query, query);
+
+  gst_query_parse_allocation(query, &caps, NULL);
+  if (caps == NULL || !gst_video_info_from_caps(&info, caps))
+    return FALSE;
+
+  /* Offer a pre-allocated pool of aligned buffers. The buffers usually come back to us writable, and get processed in
+   * place and pushed on, so the pool keeps upstream from allocating every frame. */
+  if (gst_query_get_n_allocation_pools(query) == 0) {
+    gst_my_filter_align_allocation_params(query, &allocator, &params);
+
+    pool = gst_my_filter_create_pool(caps, GST_VIDEO_INFO_SIZE(&info), MIN_POOL_BUFFERS, 0, allocator, &params);
+    if (allocator)
+      gst_object_unref(allocator);
+
+    if (pool) {
+      gst_query_add_allocation_pool(query, pool, GST_VIDEO_INFO_SIZE(&info), MIN_POOL_BUFFERS, 0);
+      gst_object_unref(pool);
+    }
+  }
+
+  /* GstVideoFilter adds the video meta, basetransform copies the metas downstream accepts */
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->propose_allocation(trans, decide_query, query);
+}
+
+/* decide which pool our output buffers come from */
+static gboolean gst_my_filter_decide_allocation(GstBaseTransform *trans, GstQuery *query) {
+  GstMyFilter *filter = GST_MYFILTER(trans);
+  GstBufferPool *pool = NULL;
+  GstAllocator *allocator;
+  GstAllocationParams params;
+  GstVideoInfo info;
+  GstCaps *caps;
+  guint size = 0, min = 0, max = 0;
+  gboolean update_pool;
+
+  gst_query_parse_allocation(query, &caps, NULL);
+  if (caps == NULL || !gst_video_info_from_caps(&info, caps))
+    return FALSE;
+
+  gst_my_filter_align_allocation_params(query, &allocator, &params);
+
+  update_pool = gst_query_get_n_allocation_pools(query) > 0;
+  if (update_pool)
+    gst_query_parse_nth_allocation_pool(query, 0, &pool, &size, &min, &max);
+
+  size = MAX(size, GST_VIDEO_INFO_SIZE(&info));
+  min = MAX(min, MIN_POOL_BUFFERS);
+  if (max != 0)
+    max = MAX(max, min);
+
+  if (pool) {
+    /* reuse the pool downstream offered */
+    GST_DEBUG_OBJECT(filter, "using downstream pool %" GST_PTR_FORMAT, pool);
+  } else {
+    /* nothing offered, never fall back to allocating every buffer */
+    pool = gst_my_filter_create_pool(caps, size, min, max, allocator, &params);
+    GST_DEBUG_OBJECT(filter, "using our own pool %" GST_PTR_FORMAT, pool);
+  }
+
+  if (allocator)
+    gst_object_unref(allocator);
+
+  if (pool == NULL)
+    return FALSE;
+
+  if (update_pool)
+    gst_query_set_nth_allocation_pool(query, 0, pool, size, min, max);
+  else
+    gst_query_add_allocation_pool(query, pool, size, min, max);
+  gst_object_unref(pool);
+
+  /* GstVideoFilter enables the video meta on the pool, basetransform configures it with the values set above */
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->decide_allocation(trans, query);
+}
+
+static GstFlowReturn gst_my_filter_prepare_output_buffer(GstBaseTransform *trans, GstBuffer *inbuf,
+                                                         GstBuffer **outbuf) {
+  /* Nobody else can see a writable buffer, process it in place. Otherwise basetransform takes a buffer from the
+   * negotiated pool and we write the result there, instead of copying the input first. */
+  if (!gst_base_transform_is_passthrough(trans) && gst_buffer_is_writable(inbuf)) {
+    *outbuf = inbuf;
+    return GST_FLOW_OK;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->prepare_output_buffer(trans, inbuf, outbuf);
+}
+
+static GstFlowReturn gst_my_filter_transform(GstBaseTransform *trans, GstBuffer *inbuf, GstBuffer *outbuf) {
+  /* GstVideoFilter can't map the same buffer for reading and for writing, use the in place path for it */
+  if (inbuf == outbuf)
+    return GST_BASE_TRANSFORM_CLASS(parent_class)->transform_ip(trans, outbuf);
+
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->transform(trans, inbuf, outbuf);
+}
+
+/* GstPad function implementations */
+
+/* hand the buffers to basetransform's chain function one by one */
+static GstFlowReturn gst_my_filter_chain_list_single(GstPad *pad, GstObject *parent, GstBufferList *list) {
+  GstMyFilter *filter = GST_MYFILTER(parent);
+  GstPadChainFunction chain = GST_PAD_CHAINFUNC(pad);
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  /* take the buffers out of the list, so they stay writable if nobody else holds them */
+  list = gst_buffer_list_make_writable(list);
+  while (ret == GST_FLOW_OK && filter->collected_ret == GST_FLOW_OK && gst_buffer_list_length(list) > 0) {
+    GstBuffer *buffer = gst_buffer_ref(gst_buffer_list_get(list, 0));
+
+    gst_buffer_list_remove(list, 0, 1);
+    ret = chain(pad, parent, buffer);
+  }
+
+  gst_buffer_list_unref(list);
+
+  return ret;
+}
+
+/* push what was collected so far as one list */
+static GstFlowReturn gst_my_filter_push_collected(GstMyFilter *filter) {
+  GstBufferList *list = filter->collected;
+
+  if (gst_buffer_list_length(list) == 0)
+    return GST_FLOW_OK;
+
+  filter->collected = gst_buffer_list_new();
+
+  return gst_pad_push_list(GST_BASE_TRANSFORM_SRC_PAD(filter), list);
+}
+
+/* while a list is processed, takes the buffers basetransform pushes instead of letting them go downstream */
+static GstPadProbeReturn gst_my_filter_collect_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  GstMyFilter *filter = user_data;
+
+  if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    if (filter->collected == NULL)
+      return GST_PAD_PROBE_OK;
+
+    gst_buffer_list_add(filter->collected, GST_PAD_PROBE_INFO_BUFFER(info));
+    return GST_PAD_PROBE_HANDLED;
+  }
+
+  /* Only serialized events come from the streaming thread. One sent in the middle of the list, like the caps of a
+   * renegotiation, must follow the buffers before it. */
+  if (GST_EVENT_IS_SERIALIZED(GST_PAD_PROBE_INFO_EVENT(info)) && filter->collected &&
+      filter->collected_ret == GST_FLOW_OK)
+    filter->collected_ret = gst_my_filter_push_collected(filter);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* chain_list function
+ * runs basetransform's chain function for every buffer and pushes the output downstream as one list
+ */
+static GstFlowReturn gst_my_filter_chain_list(GstPad *pad, GstObject *parent, GstBufferList *list) {
+  GstMyFilter *filter = GST_MYFILTER(parent);
+  GstBaseTransform *trans = GST_BASE_TRANSFORM(parent);
+  GstFlowReturn ret, push_ret;
+
+  /* Caps and allocation are (re)negotiated by the first buffer, that one can't wait in a list */
+  if (!GST_VIDEO_FILTER(parent)->negotiated || gst_pad_needs_reconfigure(GST_BASE_TRANSFORM_SRC_PAD(trans)))
+    return gst_my_filter_chain_list_single(pad, parent, list);
+
+  filter->collected = gst_buffer_list_new_sized(gst_buffer_list_length(list));
+  filter->collected_ret = GST_FLOW_OK;
+
+  ret = gst_my_filter_chain_list_single(pad, parent, list);
+  if (ret == GST_FLOW_OK)
+    ret = filter->collected_ret;
+
+  /* What was processed before an error still goes downstream */
+  push_ret = gst_my_filter_push_collected(filter);
+  if (ret == GST_FLOW_OK)
+    ret = push_ret;
+
+  gst_buffer_list_unref(filter->collected);
+  filter->collected = NULL;
+  filter->collected_ret = GST_FLOW_OK;
+
+  return ret;
+}
+
+/* GstVideoFilter vmethod implementations */
+
+/* this function is called with the negotiated caps, pick the kernel here */
+static gboolean gst_my_filter_set_info(GstVideoFilter *vfilter, GstCaps *incaps, GstVideoInfo *in_info,
+                                       GstCaps *outcaps, GstVideoInfo *out_info) {
+  GstMyFilter *filter = GST_MYFILTER(vfilter);
+
+  filter->kernel = gst_my_filter_kernel_get_best();
+
+  switch (GST_VIDEO_INFO_FORMAT(in_info)) {
+  case GST_VIDEO_FORMAT_I420:
+  case GST_VIDEO_FORMAT_NV12:
+    /* only the luma plane is processed, chroma is left as it is */
+    filter->process = filter->kernel->process_plane;
+    break;
+  case GST_VIDEO_FORMAT_RGBA:
+    filter->process = filter->kernel->process_rgba;
+    break;
+  default:
+    GST_ERROR_OBJECT(filter, "unsupported format %s", GST_VIDEO_INFO_NAME(in_info));
+    return FALSE;
+  }
+
+  GST_INFO_OBJECT(filter, "using %s kernel for %s", filter->kernel->name, GST_VIDEO_INFO_NAME(in_info));
+
+  return TRUE;
+}
+
+static void gst_my_filter_process_slice(GstMyFilterSlice *slice) {
+  for (gint y = 0; y < slice->n_rows; y++) {
+    slice->process(slice->src + y * slice->src_stride, slice->dest + y * slice->dest_stride, slice->row_size,
+                   slice->params);
+  }
+}
+
+/* runs on the worker threads */
+static void gst_my_filter_slice_worker(gpointer data, gpointer user_data) {
+  GstMyFilter *filter = GST_MYFILTER(user_data);
+
+  gst_my_filter_process_slice((GstMyFilterSlice *)data);
+
+  g_mutex_lock(&filter->slice_lock);
+  if (--filter->slices_pending == 0)
+    g_cond_signal(&filter->slice_cond);
+  g_mutex_unlock(&filter->slice_lock);
+}
+
+/* Process one plane, cut in n_slices bands of rows. The first band is done on the calling thread, the others are
+ * handed to the workers and we wait for them before returning. */
+static void gst_my_filter_process_plane(GstMyFilter *filter, const guint8 *src, gint src_stride, guint8 *dest,
+                                        gint dest_stride, gint row_size, gint height, gint n_slices,
+                                        const GstMyFilterKernelParams *params) {
+  GstMyFilterSlice slices[MAX_N_THREADS];
+  gint first_row = 0;
+
+  n_slices = CLAMP(n_slices, 1, height);
+
+  for (gint i = 0; i < n_slices; i++) {
+    gint next_row = (gint)((gint64)height * (i + 1) / n_slices);
+
+    slices[i].process = filter->process;
+    slices[i].params = params;
+    slices[i].src = src + first_row * src_stride;
+    slices[i].dest = dest + first_row * dest_stride;
+    slices[i].src_stride = src_stride;
+    slices[i].dest_stride = dest_stride;
+    slices[i].row_size = row_size;
+    slices[i].n_rows = next_row - first_row;
+
+    first_row = next_row;
+  }
+
+  if (n_slices == 1) {
+    gst_my_filter_process_slice(&slices[0]);
+    return;
+  }
+
+  filter->slices_pending = n_slices - 1;
+  for (gint i = 1; i < n_slices; i++)
+    g_thread_pool_push(filter->workers, &slices[i], NULL);
+
+  gst_my_filter_process_slice(&slices[0]);
+
+  g_mutex_lock(&filter->slice_lock);
+  while (filter->slices_pending > 0)
+    g_cond_wait(&filter->slice_cond, &filter->slice_lock);
+  g_mutex_unlock(&filter->slice_lock);
+}
+
+/* snapshot of the settings for one frame */
+static void gst_my_filter_get_frame_params(GstMyFilter *filter, GstMyFilterKernelParams *params, gint *n_slices) {
+  GST_OBJECT_LOCK(filter);
+  *params = filter->params;
+  /* one slice per worker, plus the one done on this thread */
+  *n_slices = 1;
+  if (filter->workers)
+    *n_slices = MIN(gst_my_filter_get_n_threads(filter), g_thread_pool_get_max_threads(filter->workers) + 1);
+  GST_OBJECT_UNLOCK(filter);
+}
+
+/* transform_frame function
+ * used when the input buffer is not writable, the output is a buffer from the pool
+ */
+static GstFlowReturn gst_my_filter_transform_frame(GstVideoFilter *vfilter, GstVideoFrame *in_frame,
+                                                    GstVideoFrame *out_frame) {
+  GstMyFilter *filter = GST_MYFILTER(vfilter);
+  GstMyFilterKernelParams params;
+  gint n_slices;
+
+  if (filter->silent == FALSE)
+    GST_LOG_OBJECT(filter, "processing %" GST_PTR_FORMAT " into %" GST_PTR_FORMAT, in_frame->buffer,
+                   out_frame->buffer);
+
+  gst_my_filter_get_frame_params(filter, &params, &n_slices);
+
+  /* plane 0 is Y for I420 and NV12 and the packed pixels for RGBA */
+  gst_my_filter_process_plane(filter, GST_VIDEO_FRAME_PLANE_DATA(in_frame, 0),
+                              GST_VIDEO_FRAME_PLANE_STRIDE(in_frame, 0), GST_VIDEO_FRAME_PLANE_DATA(out_frame, 0),
+                              GST_VIDEO_FRAME_PLANE_STRIDE(out_frame, 0),
+                              GST_VIDEO_FRAME_COMP_WIDTH(in_frame, 0) * GST_VIDEO_FRAME_COMP_PSTRIDE(in_frame, 0),
+                              GST_VIDEO_FRAME_COMP_HEIGHT(in_frame, 0), n_slices, &params);
+
+  /* the chroma planes are not processed */
+  for (guint plane = 1; plane < GST_VIDEO_FRAME_N_PLANES(in_frame); plane++) {
+    if (!gst_video_frame_copy_plane(out_frame, in_frame, plane))
+      return GST_FLOW_ERROR;
+  }
+
+  return GST_FLOW_OK;
+}
+
+/* transform_frame_ip function
+ * used for writable input buffers, it is not called in passthrough mode
+ */
+static GstFlowReturn gst_my_filter_transform_frame_ip(GstVideoFilter *vfilter, GstVideoFrame *frame) {
+  GstMyFilter *filter = GST_MYFILTER(vfilter);
+  GstMyFilterKernelParams params;
+  guint8 *data;
+  gint stride, n_slices;
+
+  if (filter->silent == FALSE)
+    GST_LOG_OBJECT(filter, "processing %" GST_PTR_FORMAT, frame->buffer);
+
+  gst_my_filter_get_frame_params(filter, &params, &n_slices);
+
+  data = GST_VIDEO_FRAME_PLANE_DATA(frame, 0);
+  stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0);
+  gst_my_filter_process_plane(filter, data, stride, data, stride,
+                              GST_VIDEO_FRAME_COMP_WIDTH(frame, 0) * GST_VIDEO_FRAME_COMP_PSTRIDE(frame, 0),
+                              GST_VIDEO_FRAME_COMP_HEIGHT(frame, 0), n_slices, &params);
+
+  return GST_FLOW_OK;
 }
 
 /* entry point to initialize the plug-in
@@ -48,18 +48,42 @@
 #define __GST_MYFILTER_H__
 
 #include <gst/gst.h>
+#include <gst/video/gstvideofilter.h>
+#include <gst/video/video.h>
+
+#include "gstmyfilterkernels.h"
 
 G_BEGIN_DECLS
 
 #define GST_TYPE_MYFILTER (gst_my_filter_get_type())
-G_DECLARE_FINAL_TYPE(GstMyFilter, gst_my_filter, GST, MYFILTER, GstElement)
+G_DECLARE_FINAL_TYPE(GstMyFilter, gst_my_filter, GST, MYFILTER, GstVideoFilter)
 
 struct _GstMyFilter {
-  GstElement element;
-
-  GstPad *sinkpad, *srcpad;
+  GstVideoFilter element;
 
   gboolean silent;
+  gint brightness;
+  gdouble contrast;
+
+  /* derived from brightness and contrast, protected by the object lock */
+  GstMyFilterKernelParams params;
+
+  /* selected in set_info, so the streaming thread only calls through a pointer */
+  const GstMyFilterKernel *kernel;
+  GstMyFilterKernelFunc process;
+
+  /* slice threading, n_threads and workers are protected by the object lock.
+   * The workers are created in NULL->READY and live until READY->NULL. */
+  gint n_threads;
+  GThreadPool *workers;
+  GMutex slice_lock;
+  GCond slice_cond;
+  gint slices_pending;
+
+  /* output of the buffer list being processed, and the result of pushing part of it early. Only used by the
+   * streaming thread, see chain_list. */
+  GstBufferList *collected;
+  GstFlowReturn collected_ret;
 };
 
 G_END_DECLS
@@ -0,0 +1,244 @@
+/*
+ * GStreamer
+ * Copyright (C) 2020  <<user@hostname.org>>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gstmyfilterkernels.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MYFILTER_HAVE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+/* MSVC lets us use any intrinsic without changing the target of the whole file */
+#define MYFILTER_TARGET_SSE2
+#define MYFILTER_TARGET_AVX2
+#else
+#define MYFILTER_TARGET_SSE2 __attribute__((target("sse2")))
+#define MYFILTER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+void gst_my_filter_kernel_params_init(GstMyFilterKernelParams *params, gint brightness, gdouble contrast) {
+  params->contrast_q9 = (gint16)(contrast * 512 + 0.5);
+  params->offset = (gint16)(128 + brightness);
+
+  for (gint x = 0; x < 256; x++) {
+    gint v = ((((x - 128) * 128) * params->contrast_q9) >> 16) + params->offset;
+
+    params->lut[x] = (guint8)CLAMP(v, 0, 255);
+  }
+}
+
+/* Scalar kernels, a table lookup per byte. Also used for the tails of the SIMD kernels. */
+
+static void process_plane_scalar(const guint8 *src, guint8 *dest, gint n, const GstMyFilterKernelParams *params) {
+  for (gint i = 0; i < n; i++)
+    dest[i] = params->lut[src[i]];
+}
+
+static void process_rgba_scalar(const guint8 *src, guint8 *dest, gint n, const GstMyFilterKernelParams *params) {
+  for (gint i = 0; i < n; i += 4) {
+    dest[i + 0] = params->lut[src[i + 0]];
+    dest[i + 1] = params->lut[src[i + 1]];
+    dest[i + 2] = params->lut[src[i + 2]];
+    dest[i + 3] = src[i + 3];
+  }
+}
+
+static const GstMyFilterKernel kernel_scalar = {"scalar", process_plane_scalar, process_rgba_scalar};
+
+#ifdef MYFILTER_HAVE_X86
+
+/* SSE2 kernels, 16 bytes per iteration */
+
+MYFILTER_TARGET_SSE2
+static inline __m128i process_16_sse2(__m128i x, __m128i contrast, __m128i offset) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bias = _mm_set1_epi16(128);
+  __m128i lo, hi;
+
+  /* widen to 16 bits, center around 0 and scale so that the multiply-high keeps 7 + 9 fractional bits */
+  lo = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(x, zero), bias), 7);
+  hi = _mm_slli_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(x, zero), bias), 7);
+  lo = _mm_add_epi16(_mm_mulhi_epi16(lo, contrast), offset);
+  hi = _mm_add_epi16(_mm_mulhi_epi16(hi, contrast), offset);
+
+  /* the unsigned saturating pack is the clamp to 0 .. 255 */
+  return _mm_packus_epi16(lo, hi);
+}
+
+MYFILTER_TARGET_SSE2
+static void process_plane_sse2(const guint8 *src, guint8 *dest, gint n, const GstMyFilterKernelParams *params) {
+  const __m128i contrast = _mm_set1_epi16(params->contrast_q9);
+  const __m128i offset = _mm_set1_epi16(params->offset);
+  gint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+
+    _mm_storeu_si128((__m128i *)(dest + i), process_16_sse2(x, contrast, offset));
+  }
+
+  process_plane_scalar(src + i, dest + i, n - i, params);
+}
+
+MYFILTER_TARGET_SSE2
+static void process_rgba_sse2(const guint8 *src, guint8 *dest, gint n, const GstMyFilterKernelParams *params) {
+  const __m128i contrast = _mm_set1_epi16(params->contrast_q9);
+  const __m128i offset = _mm_set1_epi16(params->offset);
+  const __m128i alpha = _mm_set1_epi32((gint)0xff000000);
+  gint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i y = process_16_sse2(x, contrast, offset);
+
+    /* put the original alpha bytes back */
+    y = _mm_or_si128(_mm_andnot_si128(alpha, y), _mm_and_si128(alpha, x));
+    _mm_storeu_si128((__m128i *)(dest + i), y);
+  }
+
+  process_rgba_scalar(src + i, dest + i, n - i, params);
+}
+
+static const GstMyFilterKernel kernel_sse2 = {"sse2", process_plane_sse2, process_rgba_sse2};
+
+/* AVX2 kernels, 32 bytes per iteration. unpack and pack both work per 128 bit lane, so the byte order is preserved
+ * exactly like in the SSE2 version. */
+
+MYFILTER_TARGET_AVX2
+static inline __m256i process_32_avx2(__m256i x, __m256i contrast, __m256i offset) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i bias = _mm256_set1_epi16(128);
+  __m256i lo, hi;
+
+  lo = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_unpacklo_epi8(x, zero), bias), 7);
+  hi = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_unpackhi_epi8(x, zero), bias), 7);
+  lo = _mm256_add_epi16(_mm256_mulhi_epi16(lo, contrast), offset);
+  hi = _mm256_add_epi16(_mm256_mulhi_epi16(hi, contrast), offset);
+
+  return _mm256_packus_epi16(lo, hi);
+}
+
+MYFILTER_TARGET_AVX2
+static void process_plane_avx2(const guint8 *src, guint8 *dest, gint n, const GstMyFilterKernelParams *params) {
+  const __m256i contrast = _mm256_set1_epi16(params->contrast_q9);
+  const __m256i offset = _mm256_set1_epi16(params->offset);
+  gint i;
+
+  for (i = 0; i + 32 <= n; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+
+    _mm256_storeu_si256((__m256i *)(dest + i), process_32_avx2(x, contrast, offset));
+  }
+
+  process_plane_scalar(src + i, dest + i, n - i, params);
+}
+
+MYFILTER_TARGET_AVX2
+static void process_rgba_avx2(const guint8 *src, guint8 *dest, gint n, const GstMyFilterKernelParams *params) {
+  const __m256i contrast = _mm256_set1_epi16(params->contrast_q9);
+  const __m256i offset = _mm256_set1_epi16(params->offset);
+  const __m256i alpha = _mm256_set1_epi32((gint)0xff000000);
+  gint i;
+
+  for (i = 0; i + 32 <= n; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+    __m256i y = process_32_avx2(x, contrast, offset);
+
+    y = _mm256_blendv_epi8(y, x, alpha);
+    _mm256_storeu_si256((__m256i *)(dest + i), y);
+  }
+
+  process_rgba_scalar(src + i, dest + i, n - i, params);
+}
+
+static const GstMyFilterKernel kernel_avx2 = {"avx2", process_plane_avx2, process_rgba_avx2};
+
+static gboolean cpu_has_sse2(void) {
+#if defined(__x86_64__) || defined(_M_X64)
+  /* part of the x86-64 baseline */
+  return TRUE;
+#elif defined(_MSC_VER)
+  int info[4];
+
+  __cpuid(info, 1);
+  return (info[3] & (1 << 26)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static gboolean cpu_has_avx2(void) {
+#if defined(_MSC_VER)
+  int info[4];
+
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return FALSE;
+
+  /* the CPU must support AVX and the OS must save the YMM registers */
+  __cpuid(info, 1);
+  if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+    return FALSE;
+  if ((_xgetbv(0) & 0x6) != 0x6)
+    return FALSE;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif /* MYFILTER_HAVE_X86 */
+
+static const GstMyFilterKernel *select_kernel(void) {
+  const gchar *wanted = g_getenv("GST_MYFILTER_KERNEL");
+
+  if (wanted && strcmp(wanted, "scalar") == 0)
+    return &kernel_scalar;
+
+#ifdef MYFILTER_HAVE_X86
+  if ((!wanted || strcmp(wanted, "avx2") == 0) && cpu_has_avx2())
+    return &kernel_avx2;
+  if (cpu_has_sse2())
+    return &kernel_sse2;
+#endif
+
+  return &kernel_scalar;
+}
+
+const GstMyFilterKernel *gst_my_filter_kernel_get_best(void) {
+  static const GstMyFilterKernel *kernel = NULL;
+
+  if (g_once_init_enter(&kernel)) {
+    g_once_init_leave(&kernel, select_kernel());
+  }
+
+  return kernel;
+}
@@ -0,0 +1,59 @@
+/*
+ * GStreamer
+ * Copyright (C) 2020  <<user@hostname.org>>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_MYFILTER_KERNELS_H__
+#define __GST_MYFILTER_KERNELS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Parameters of the brightness/contrast operation, precomputed from the element properties.
+ *
+ * Every kernel computes, for each byte x:
+ *   out = CLAMP ((((x - 128) << 7) * contrast_q9 >> 16) + offset, 0, 255)
+ * which is exactly what the SIMD multiply-high instructions produce, so all kernels are bit-exact with the LUT. */
+typedef struct _GstMyFilterKernelParams {
+  gint16 contrast_q9; /* contrast in Q9 fixed point, 0 .. 1024 */
+  gint16 offset;      /* 128 + brightness */
+  guint8 lut[256];    /* the same operation as a table, used by the scalar kernel */
+} GstMyFilterKernelParams;
+
+/* Process n bytes of one row. src and dest may be the same pointer. */
+typedef void (*GstMyFilterKernelFunc)(const guint8 *src, guint8 *dest, gint n, const GstMyFilterKernelParams *params);
+
+typedef struct _GstMyFilterKernel {
+  const gchar *name;
+
+  /* every byte of the row is a component (Y plane of I420/NV12) */
+  GstMyFilterKernelFunc process_plane;
+  /* the row is RGBA, the alpha byte of every pixel is copied unchanged */
+  GstMyFilterKernelFunc process_rgba;
+} GstMyFilterKernel;
+
+void gst_my_filter_kernel_params_init(GstMyFilterKernelParams *params, gint brightness, gdouble contrast);
+
+/* Returns the fastest kernel supported by the CPU. The CPU is only probed once. Setting the GST_MYFILTER_KERNEL
+ * environment variable to "scalar", "sse2" or "avx2" restricts the choice, which is handy for benchmarking. */
+const GstMyFilterKernel *gst_my_filter_kernel_get_best(void);
+
+G_END_DECLS
+
+#endif /* __GST_MYFILTER_KERNELS_H__ */
@@ -0,0 +1,562 @@
+/*
+ * GStreamer
+ * Copyright (C) 2020  <<user@hostname.org>>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:tracer-perf
+ *
+ * The perf tracer measures where the streaming threads spend their time. Every
+ * buffer (or buffer list) pushed on a pad is timed from the push until it
+ * returns, which is the time spent in the peer element and everything further
+ * downstream in the same thread. Nested pushes are subtracted, so each element
+ * gets its inclusive and its exclusive (own) processing time, with a log2
+ * histogram of the latter. Per pad the number of buffers and bytes is counted,
+ * and the fill level of every queue is sampled.
+ *
+ * The hooks only touch counters owned by the calling thread. Each thread
+ * merges them into the totals every interval, so the global lock is taken once
+ * per interval and thread instead of once per buffer.
+ *
+ * Params:
+ *   interval: report period in milliseconds, default 1000
+ *   print:    also print the hottest elements to stderr at every report
+ *
+ * <refsect2>
+ * <title>Example</title>
+ * |[
+ * GST_PLUGIN_PATH=<build>/plugins GST_TRACERS="perf(interval=500,print=true)" GST_DEBUG="GST_TRACER:7" \
+ *     ./tutorial_7
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstperftracer.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_perf_tracer_debug);
+#define GST_CAT_DEFAULT gst_perf_tracer_debug
+
+#define DEFAULT_INTERVAL (GST_SECOND)
+/* bucket i of the histograms counts exclusive times below 2^(i + HISTOGRAM_SHIFT) ns */
+#define HISTOGRAM_SHIFT 10
+#define HISTOGRAM_BUCKETS 24
+/* elements printed per report with print=true */
+#define PRINT_TOP 5
+
+typedef struct _GstPerfElementStats {
+  gchar *name;
+  guint64 calls;
+  GstClockTime inclusive, exclusive;
+  guint64 histogram[HISTOGRAM_BUCKETS];
+} GstPerfElementStats;
+
+typedef struct _GstPerfPadStats {
+  gchar *name;
+  guint64 buffers, bytes;
+  /* totals at the previous report, to compute the rates */
+  guint64 reported_buffers, reported_bytes;
+} GstPerfPadStats;
+
+/* A push in progress on the calling thread */
+typedef struct _GstPerfFrame {
+  GstElement *element; /* peer element that processes the buffer, NULL for ghost pads */
+  GstClockTime start;
+  GstClockTime children; /* time spent in nested pushes */
+} GstPerfFrame;
+
+/* Counters of one thread, only touched by that thread until they are flushed */
+typedef struct _GstPerfThreadStats {
+  GstPerfTracer *tracer; /* protected by the threads lock */
+  GHashTable *elements;  /* GstElement * -> GstPerfElementStats */
+  GHashTable *pads;      /* GstPad * -> GstPerfPadStats */
+  GArray *stack;         /* GstPerfFrame */
+  GstClockTime last_flush;
+} GstPerfThreadStats;
+
+static GstTracerRecord *tr_element, *tr_pad, *tr_queue;
+
+static void gst_perf_thread_stats_free(gpointer data);
+static GPrivate thread_stats = G_PRIVATE_INIT(gst_perf_thread_stats_free);
+
+/* every GstPerfThreadStats alive, so the tracer can detach them when it goes away */
+G_LOCK_DEFINE_STATIC(threads);
+static GList *threads = NULL;
+
+#define gst_perf_tracer_parent_class parent_class
+G_DEFINE_TYPE(GstPerfTracer, gst_perf_tracer, GST_TYPE_TRACER);
+
+static void gst_perf_element_stats_free(gpointer data) {
+  GstPerfElementStats *stats = data;
+
+  g_free(stats->name);
+  g_free(stats);
+}
+
+static void gst_perf_pad_stats_free(gpointer data) {
+  GstPerfPadStats *stats = data;
+
+  g_free(stats->name);
+  g_free(stats);
+}
+
+static void gst_perf_weak_ref_free(gpointer data) {
+  g_weak_ref_clear(data);
+  g_free(data);
+}
+
+/* Merging and reporting */
+
+static void gst_perf_tracer_merge_locked(GstPerfTracer *self, GstPerfThreadStats *stats) {
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init(&iter, stats->elements);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    GstPerfElementStats *local = value, *total;
+
+    total = g_hash_table_lookup(self->elements, local->name);
+    if (total == NULL) {
+      total = g_new0(GstPerfElementStats, 1);
+      total->name = g_strdup(local->name);
+      g_hash_table_insert(self->elements, total->name, total);
+    }
+
+    total->calls += local->calls;
+    total->inclusive += local->inclusive;
+    total->exclusive += local->exclusive;
+    for (gint i = 0; i < HISTOGRAM_BUCKETS; i++)
+      total->histogram[i] += local->histogram[i];
+  }
+
+  g_hash_table_iter_init(&iter, stats->pads);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    GstPerfPadStats *local = value, *total;
+
+    total = g_hash_table_lookup(self->pads, local->name);
+    if (total == NULL) {
+      total = g_new0(GstPerfPadStats, 1);
+      total->name = g_strdup(local->name);
+      g_hash_table_insert(self->pads, total->name, total);
+    }
+
+    total->buffers += local->buffers;
+    total->bytes += local->bytes;
+  }
+
+  /* the pointers are only trusted for one interval, an element or pad may be freed and its address reused */
+  g_hash_table_remove_all(stats->elements);
+  g_hash_table_remove_all(stats->pads);
+}
+
+static gint gst_perf_compare_exclusive(gconstpointer a, gconstpointer b) {
+  const GstPerfElementStats *x = *(GstPerfElementStats *const *)a, *y = *(GstPerfElementStats *const *)b;
+
+  return x->exclusive < y->exclusive ? 1 : (x->exclusive > y->exclusive ? -1 : 0);
+}
+
+static void gst_perf_tracer_print_locked(GstPerfTracer *self, guint top) {
+  GPtrArray *sorted = g_ptr_array_new();
+  GHashTableIter iter;
+  gpointer value;
+  GstClockTime total = 0;
+
+  g_hash_table_iter_init(&iter, self->elements);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    g_ptr_array_add(sorted, value);
+    total += ((GstPerfElementStats *)value)->exclusive;
+  }
+  g_ptr_array_sort(sorted, gst_perf_compare_exclusive);
+
+  g_printerr("perf: %-24s %10s %-17s %-17s %6s\n", "element", "calls", "exclusive", "inclusive", "share");
+  for (guint i = 0; i < sorted->len && i < top; i++) {
+    GstPerfElementStats *stats = g_ptr_array_index(sorted, i);
+
+    g_printerr("perf: %-24s %10" G_GUINT64_FORMAT " %" GST_TIME_FORMAT " %" GST_TIME_FORMAT " %5.1f%%\n",
+               stats->name, stats->calls, GST_TIME_ARGS(stats->exclusive), GST_TIME_ARGS(stats->inclusive),
+               total > 0 ? 100.0 * stats->exclusive / total : 0.0);
+  }
+
+  g_ptr_array_free(sorted, TRUE);
+}
+
+static void gst_perf_tracer_report_locked(GstPerfTracer *self, GstClockTime ts) {
+  gdouble elapsed = (gdouble)(ts - self->last_report) / GST_SECOND;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init(&iter, self->elements);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    GstPerfElementStats *stats = value;
+    GString *histogram = g_string_new(NULL);
+
+    for (gint i = 0; i < HISTOGRAM_BUCKETS; i++) {
+      if (stats->histogram[i] > 0)
+        g_string_append_printf(histogram, "%s<%" G_GUINT64_FORMAT "ns:%" G_GUINT64_FORMAT, histogram->len ? " " : "",
+                               (guint64)1 << (i + HISTOGRAM_SHIFT), stats->histogram[i]);
+    }
+
+    gst_tracer_record_log(tr_element, stats->name, stats->calls, stats->inclusive, stats->exclusive, histogram->str);
+    g_string_free(histogram, TRUE);
+  }
+
+  g_hash_table_iter_init(&iter, self->pads);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    GstPerfPadStats *stats = value;
+
+    gst_tracer_record_log(tr_pad, stats->name, stats->buffers, stats->bytes,
+                          elapsed > 0 ? (stats->buffers - stats->reported_buffers) / elapsed : 0.0,
+                          elapsed > 0 ? (stats->bytes - stats->reported_bytes) / elapsed : 0.0);
+    stats->reported_buffers = stats->buffers;
+    stats->reported_bytes = stats->bytes;
+  }
+
+  if (self->print)
+    gst_perf_tracer_print_locked(self, PRINT_TOP);
+
+  self->last_report = ts;
+}
+
+static void gst_perf_tracer_sample_queue(GstElement *queue) {
+  guint level_buffers, level_bytes, max_buffers, max_bytes;
+  guint64 level_time, max_time;
+  gdouble fill = 0.0;
+
+  g_object_get(queue, "current-level-buffers", &level_buffers, "current-level-bytes", &level_bytes,
+               "current-level-time", &level_time, "max-size-buffers", &max_buffers, "max-size-bytes", &max_bytes,
+               "max-size-time", &max_time, NULL);
+
+  /* a queue is full as soon as one of its limits is reached */
+  if (max_buffers > 0)
+    fill = MAX(fill, (gdouble)level_buffers / max_buffers);
+  if (max_bytes > 0)
+    fill = MAX(fill, (gdouble)level_bytes / max_bytes);
+  if (max_time > 0)
+    fill = MAX(fill, (gdouble)level_time / max_time);
+
+  gst_tracer_record_log(tr_queue, GST_OBJECT_NAME(queue), level_buffers, level_bytes, level_time, 100.0 * fill);
+}
+
+/* Called by a thread at the bottom of its push stack once its interval is over */
+static void gst_perf_tracer_flush(GstPerfTracer *self, GstPerfThreadStats *stats, GstClockTime ts) {
+  GPtrArray *queues = NULL;
+
+  g_mutex_lock(&self->lock);
+  gst_perf_tracer_merge_locked(self, stats);
+  stats->last_flush = ts;
+
+  if (ts - self->last_report >= self->interval) {
+    gst_perf_tracer_report_locked(self, ts);
+
+    /* the queues are sampled without our lock, reading their properties takes their own */
+    queues = g_ptr_array_new_with_free_func(gst_object_unref);
+    for (guint i = 0; i < self->queues->len;) {
+      GstElement *queue = g_weak_ref_get(g_ptr_array_index(self->queues, i));
+
+      if (queue) {
+        g_ptr_array_add(queues, queue);
+        i++;
+      } else {
+        g_ptr_array_remove_index_fast(self->queues, i);
+      }
+    }
+  }
+  g_mutex_unlock(&self->lock);
+
+  if (queues) {
+    for (guint i = 0; i < queues->len; i++)
+      gst_perf_tracer_sample_queue(g_ptr_array_index(queues, i));
+    g_ptr_array_free(queues, TRUE);
+  }
+}
+
+/* Per thread counters */
+
+static GstPerfThreadStats *gst_perf_thread_stats_get(GstPerfTracer *self, GstClockTime ts) {
+  GstPerfThreadStats *stats = g_private_get(&thread_stats);
+
+  if (G_LIKELY(stats != NULL && stats->tracer == self))
+    return stats;
+
+  if (stats == NULL) {
+    stats = g_new0(GstPerfThreadStats, 1);
+    stats->elements = g_hash_table_new_full(NULL, NULL, NULL, gst_perf_element_stats_free);
+    stats->pads = g_hash_table_new_full(NULL, NULL, NULL, gst_perf_pad_stats_free);
+    stats->stack = g_array_new(FALSE, FALSE, sizeof(GstPerfFrame));
+    g_private_set(&thread_stats, stats);
+  }
+
+  G_LOCK(threads);
+  if (stats->tracer == NULL)
+    threads = g_list_prepend(threads, stats);
+  stats->tracer = self;
+  G_UNLOCK(threads);
+
+  stats->last_flush = ts;
+
+  return stats;
+}
+
+static void gst_perf_thread_stats_free(gpointer data) {
+  GstPerfThreadStats *stats = data;
+
+  /* the thread is exiting, hand over what it counted since the last flush */
+  G_LOCK(threads);
+  if (stats->tracer) {
+    g_mutex_lock(&stats->tracer->lock);
+    gst_perf_tracer_merge_locked(stats->tracer, stats);
+    g_mutex_unlock(&stats->tracer->lock);
+    threads = g_list_remove(threads, stats);
+  }
+  G_UNLOCK(threads);
+
+  g_hash_table_destroy(stats->elements);
+  g_hash_table_destroy(stats->pads);
+  g_array_free(stats->stack, TRUE);
+  g_free(stats);
+}
+
+/* Hooks */
+
+static void gst_perf_tracer_push_pre(GstPerfTracer *self, GstClockTime ts, GstPad *pad, guint n_buffers,
+                                     gsize n_bytes) {
+  GstPerfThreadStats *stats = gst_perf_thread_stats_get(self, ts);
+  GstPerfPadStats *pad_stats;
+  GstPerfFrame frame;
+  GstPad *peer;
+  GstObject *parent;
+
+  pad_stats = g_hash_table_lookup(stats->pads, pad);
+  if (G_UNLIKELY(pad_stats == NULL)) {
+    pad_stats = g_new0(GstPerfPadStats, 1);
+    pad_stats->name = g_strdup_printf("%s:%s", GST_DEBUG_PAD_NAME(pad));
+    g_hash_table_insert(stats->pads, pad, pad_stats);
+  }
+  pad_stats->buffers += n_buffers;
+  pad_stats->bytes += n_bytes;
+
+  /* the peer of a ghost pad's target is a proxy pad, its parent is the ghost pad and not an element. The push the
+   * ghost pad does next accounts for the element inside the bin. */
+  peer = GST_PAD_PEER(pad);
+  parent = peer ? GST_OBJECT_PARENT(peer) : NULL;
+
+  frame.element = (parent && GST_IS_ELEMENT(parent)) ? GST_ELEMENT_CAST(parent) : NULL;
+  frame.start = ts;
+  frame.children = 0;
+  g_array_append_val(stats->stack, frame);
+}
+
+static void gst_perf_tracer_push_post(GstPerfTracer *self, GstClockTime ts) {
+  GstPerfThreadStats *stats = g_private_get(&thread_stats);
+  GstPerfFrame frame;
+  GstClockTime duration, exclusive;
+
+  /* the push started before this thread was traced */
+  if (G_UNLIKELY(stats == NULL || stats->tracer != self || stats->stack->len == 0))
+    return;
+
+  frame = g_array_index(stats->stack, GstPerfFrame, stats->stack->len - 1);
+  g_array_set_size(stats->stack, stats->stack->len - 1);
+
+  duration = ts > frame.start ? ts - frame.start : 0;
+  exclusive = duration > frame.children ? duration - frame.children : 0;
+
+  if (stats->stack->len > 0)
+    g_array_index(stats->stack, GstPerfFrame, stats->stack->len - 1).children += duration;
+
+  if (frame.element) {
+    GstPerfElementStats *element_stats = g_hash_table_lookup(stats->elements, frame.element);
+    guint64 scaled = exclusive >> HISTOGRAM_SHIFT;
+
+    if (G_UNLIKELY(element_stats == NULL)) {
+      element_stats = g_new0(GstPerfElementStats, 1);
+      element_stats->name = g_strdup(GST_OBJECT_NAME(frame.element));
+      g_hash_table_insert(stats->elements, frame.element, element_stats);
+    }
+
+    element_stats->calls++;
+    element_stats->inclusive += duration;
+    element_stats->exclusive += exclusive;
+    /* g_bit_storage(0) is 1, times below 2^HISTOGRAM_SHIFT go to bucket 0 */
+    element_stats->histogram[MIN(scaled ? g_bit_storage(scaled) : 0, HISTOGRAM_BUCKETS - 1)]++;
+  }
+
+  /* only flush when no push is in progress, so the nested pushes never wait for the lock */
+  if (stats->stack->len == 0 && ts - stats->last_flush >= self->interval)
+    gst_perf_tracer_flush(self, stats, ts);
+}
+
+static void do_push_buffer_pre(GstPerfTracer *self, GstClockTime ts, GstPad *pad, GstBuffer *buffer) {
+  gst_perf_tracer_push_pre(self, ts, pad, 1, gst_buffer_get_size(buffer));
+}
+
+static void do_push_buffer_list_pre(GstPerfTracer *self, GstClockTime ts, GstPad *pad, GstBufferList *list) {
+  gst_perf_tracer_push_pre(self, ts, pad, gst_buffer_list_length(list), gst_buffer_list_calculate_size(list));
+}
+
+static void do_push_post(GstPerfTracer *self, GstClockTime ts, GstPad *pad, GstFlowReturn res) {
+  gst_perf_tracer_push_post(self, ts);
+}
+
+static void do_element_new(GstPerfTracer *self, GstClockTime ts, GstElement *element) {
+  GObjectClass *klass = G_OBJECT_GET_CLASS(element);
+  GWeakRef *ref;
+
+  /* queue and queue2 */
+  if (!g_object_class_find_property(klass, "current-level-buffers") ||
+      !g_object_class_find_property(klass, "max-size-buffers"))
+    return;
+
+  ref = g_new0(GWeakRef, 1);
+  g_weak_ref_init(ref, element);
+
+  g_mutex_lock(&self->lock);
+  g_ptr_array_add(self->queues, ref);
+  g_mutex_unlock(&self->lock);
+}
+
+/* GObject vmethod implementations */
+
+static void gst_perf_tracer_constructed(GObject *object) {
+  GstPerfTracer *self = GST_PERF_TRACER(object);
+  gchar *params, *tmp;
+  GstStructure *s;
+  gint interval;
+
+  G_OBJECT_CLASS(parent_class)->constructed(object);
+
+  g_object_get(self, "params", &params, NULL);
+  if (params == NULL)
+    return;
+
+  tmp = g_strdup_printf("perf,%s", params);
+  s = gst_structure_from_string(tmp, NULL);
+  g_free(tmp);
+
+  if (s) {
+    if (gst_structure_get_int(s, "interval", &interval) && interval > 0)
+      self->interval = interval * GST_MSECOND;
+    gst_structure_get_boolean(s, "print", &self->print);
+    gst_structure_free(s);
+  } else {
+    GST_WARNING_OBJECT(self, "Can't parse params '%s'", params);
+  }
+
+  g_free(params);
+}
+
+static void gst_perf_tracer_finalize(GObject *object) {
+  GstPerfTracer *self = GST_PERF_TRACER(object);
+
+  /* threads that are still around keep their counters to themselves from now on */
+  G_LOCK(threads);
+  for (GList *l = threads; l; l = l->next)
+    ((GstPerfThreadStats *)l->data)->tracer = NULL;
+  g_list_free(threads);
+  threads = NULL;
+  G_UNLOCK(threads);
+
+  if (self->print) {
+    g_printerr("perf: summary\n");
+    gst_perf_tracer_print_locked(self, G_MAXUINT);
+  }
+
+  g_hash_table_destroy(self->elements);
+  g_hash_table_destroy(self->pads);
+  g_ptr_array_free(self->queues, TRUE);
+  g_mutex_clear(&self->lock);
+
+  G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+static GstStructure *gst_perf_tracer_value(GType type, const gchar *description) {
+  return gst_structure_new("value", "type", G_TYPE_GTYPE, type, "description", G_TYPE_STRING, description, NULL);
+}
+
+static GstStructure *gst_perf_tracer_scope(GstTracerValueScope scope) {
+  return gst_structure_new("scope", "type", G_TYPE_GTYPE, G_TYPE_STRING, "related-to", GST_TYPE_TRACER_VALUE_SCOPE,
+                           scope, NULL);
+}
+
+static void gst_perf_tracer_class_init(GstPerfTracerClass *klass) {
+  GObjectClass *gobject_class = (GObjectClass *)klass;
+
+  gobject_class->constructed = gst_perf_tracer_constructed;
+  gobject_class->finalize = gst_perf_tracer_finalize;
+
+  /* the values are cumulative, the rates are over the last interval */
+  tr_element = gst_tracer_record_new(
+      "perf-element.class", "element", GST_TYPE_STRUCTURE, gst_perf_tracer_scope(GST_TRACER_VALUE_SCOPE_ELEMENT),
+      "calls", GST_TYPE_STRUCTURE, gst_perf_tracer_value(G_TYPE_UINT64, "buffers and lists processed"), "inclusive",
+      GST_TYPE_STRUCTURE, gst_perf_tracer_value(G_TYPE_UINT64, "time in the element and downstream, in ns"),
+      "exclusive", GST_TYPE_STRUCTURE, gst_perf_tracer_value(G_TYPE_UINT64, "time in the element itself, in ns"),
+      "histogram", GST_TYPE_STRUCTURE, gst_perf_tracer_value(G_TYPE_STRING, "log2 histogram of the exclusive time"),
+      NULL);
+  tr_pad = gst_tracer_record_new(
+      "perf-pad.class", "pad", GST_TYPE_STRUCTURE, gst_perf_tracer_scope(GST_TRACER_VALUE_SCOPE_PAD), "buffers",
+      GST_TYPE_STRUCTURE, gst_perf_tracer_value(G_TYPE_UINT64, "buffers pushed"), "bytes", GST_TYPE_STRUCTURE,
+      gst_perf_tracer_value(G_TYPE_UINT64, "bytes pushed"), "buffer-rate", GST_TYPE_STRUCTURE,
+      gst_perf_tracer_value(G_TYPE_DOUBLE, "buffers per second"), "byte-rate", GST_TYPE_STRUCTURE,
+      gst_perf_tracer_value(G_TYPE_DOUBLE, "bytes per second"), NULL);
+  tr_queue = gst_tracer_record_new(
+      "perf-queue.class", "queue", GST_TYPE_STRUCTURE, gst_perf_tracer_scope(GST_TRACER_VALUE_SCOPE_ELEMENT),
+      "buffers", GST_TYPE_STRUCTURE, gst_perf_tracer_value(G_TYPE_UINT, "buffers queued"), "bytes",
+      GST_TYPE_STRUCTURE, gst_perf_tracer_value(G_TYPE_UINT, "bytes queued"), "time", GST_TYPE_STRUCTURE,
+      gst_perf_tracer_value(G_TYPE_UINT64, "time queued, in ns"), "fill", GST_TYPE_STRUCTURE,
+      gst_perf_tracer_value(G_TYPE_DOUBLE, "percentage of the closest limit"), NULL);
+
+  GST_OBJECT_FLAG_SET(tr_element, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+  GST_OBJECT_FLAG_SET(tr_pad, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+  GST_OBJECT_FLAG_SET(tr_queue, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+}
+
+static void gst_perf_tracer_init(GstPerfTracer *self) {
+  GstTracer *tracer = GST_TRACER(self);
+
+  self->interval = DEFAULT_INTERVAL;
+  self->print = FALSE;
+
+  g_mutex_init(&self->lock);
+  self->elements = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, gst_perf_element_stats_free);
+  self->pads = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, gst_perf_pad_stats_free);
+  self->queues = g_ptr_array_new_with_free_func(gst_perf_weak_ref_free);
+  /* the hooks get timestamps relative to gst_init() */
+  self->last_report = 0;
+
+  gst_tracing_register_hook(tracer, "pad-push-pre", G_CALLBACK(do_push_buffer_pre));
+  gst_tracing_register_hook(tracer, "pad-push-post", G_CALLBACK(do_push_post));
+  gst_tracing_register_hook(tracer, "pad-push-list-pre", G_CALLBACK(do_push_buffer_list_pre));
+  gst_tracing_register_hook(tracer, "pad-push-list-post", G_CALLBACK(do_push_post));
+  gst_tracing_register_hook(tracer, "element-new", G_CALLBACK(do_element_new));
+}
+
+static gboolean perftracer_init(GstPlugin *plugin) {
+  GST_DEBUG_CATEGORY_INIT(gst_perf_tracer_debug, "perftracer", 0, "per element latency and throughput tracer");
+
+  return gst_tracer_register(plugin, "perf", GST_TYPE_PERF_TRACER);
+}
+
+#ifndef PACKAGE
+#define PACKAGE "myfirstmyfilter"
+#endif
+
+GST_PLUGIN_DEFINE(GST_VERSION_MAJOR, GST_VERSION_MINOR, perftracer, "Per element latency and throughput tracer",
+                  perftracer_init, "0.1.0", "LGPL", "MyFilter", "Realtek")
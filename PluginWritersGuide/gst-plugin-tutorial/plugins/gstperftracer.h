@@ -0,0 +1,49 @@
+/*
+ * GStreamer
+ * Copyright (C) 2020  <<user@hostname.org>>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_PERF_TRACER_H__
+#define __GST_PERF_TRACER_H__
+
+#include <gst/gst.h>
+#include <gst/gsttracer.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_PERF_TRACER (gst_perf_tracer_get_type())
+G_DECLARE_FINAL_TYPE(GstPerfTracer, gst_perf_tracer, GST, PERF_TRACER, GstTracer)
+
+struct _GstPerfTracer {
+  GstTracer parent;
+
+  /* from the "params" property */
+  GstClockTime interval;
+  gboolean print;
+
+  /* totals of all threads, everything below is protected by lock */
+  GMutex lock;
+  GHashTable *elements; /* element name -> GstPerfElementStats */
+  GHashTable *pads;     /* element:pad name -> GstPerfPadStats */
+  GPtrArray *queues;    /* GWeakRef to every queue created, their fill level is sampled at each report */
+  GstClockTime last_report;
+};
+
+G_END_DECLS
+
+#endif /* __GST_PERF_TRACER_H__ */
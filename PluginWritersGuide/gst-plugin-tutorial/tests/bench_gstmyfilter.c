@@ -0,0 +1,232 @@
+/* Microbenchmark for myfilter.
+ *
+ * Drives the element through a GstHarness with synthetic frames of several formats and sizes, in the three modes the
+ * element has: passthrough, in place (the buffer is writable) and copy (upstream keeps a reference, so the result goes
+ * to a pooled buffer). Results are printed as JSON, one object per case:
+ *
+ *   GST_PLUGIN_PATH=<dir of libmyfilter> ./bench-gstmyfilter --iterations 1000 --output bench.json
+ *
+ * Allocations are counted by installing a counting allocator as the default GstAllocator, so they are the GstMemory
+ * allocations made while the measured buffers went through the element.
+ */
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/gst.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct _BenchFormat {
+  const gchar *format;
+  gint width, height;
+} BenchFormat;
+
+typedef enum { BENCH_MODE_PASSTHROUGH, BENCH_MODE_IN_PLACE, BENCH_MODE_COPY } BenchMode;
+
+static const BenchFormat bench_formats[] = {
+    {"I420", 640, 480}, {"I420", 1920, 1080}, {"I420", 3840, 2160}, {"NV12", 1920, 1080},
+    {"RGBA", 640, 480}, {"RGBA", 1920, 1080},
+};
+
+static const gchar *bench_mode_names[] = {"passthrough", "in-place", "copy"};
+
+static gsize bench_format_size(const BenchFormat *fmt) {
+  if (strcmp(fmt->format, "RGBA") == 0)
+    return (gsize)fmt->width * fmt->height * 4;
+
+  /* I420 and NV12, every size used here is even */
+  return (gsize)fmt->width * fmt->height * 3 / 2;
+}
+
+/* Counting allocator, hands everything to the system memory allocator */
+
+typedef struct _BenchAllocator {
+  GstAllocator parent;
+
+  GstAllocator *sysmem;
+} BenchAllocator;
+
+typedef struct _BenchAllocatorClass {
+  GstAllocatorClass parent_class;
+} BenchAllocatorClass;
+
+static GType bench_allocator_get_type(void);
+G_DEFINE_TYPE(BenchAllocator, bench_allocator, GST_TYPE_ALLOCATOR);
+
+static volatile gint n_allocations = 0;
+
+static GstMemory *bench_allocator_alloc(GstAllocator *allocator, gsize size, GstAllocationParams *params) {
+  BenchAllocator *self = (BenchAllocator *)allocator;
+
+  g_atomic_int_inc(&n_allocations);
+
+  /* the memory belongs to sysmem, so it is also freed by sysmem */
+  return gst_allocator_alloc(self->sysmem, size, params);
+}
+
+static void bench_allocator_finalize(GObject *object) {
+  BenchAllocator *self = (BenchAllocator *)object;
+
+  gst_object_unref(self->sysmem);
+
+  G_OBJECT_CLASS(bench_allocator_parent_class)->finalize(object);
+}
+
+static void bench_allocator_class_init(BenchAllocatorClass *klass) {
+  G_OBJECT_CLASS(klass)->finalize = bench_allocator_finalize;
+  GST_ALLOCATOR_CLASS(klass)->alloc = bench_allocator_alloc;
+}
+
+static void bench_allocator_init(BenchAllocator *self) { self->sysmem = gst_allocator_find(GST_ALLOCATOR_SYSMEM); }
+
+/* Benchmark */
+
+static gint compare_guint64(gconstpointer a, gconstpointer b) {
+  guint64 x = *(const guint64 *)a, y = *(const guint64 *)b;
+
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static gboolean run_case(const BenchFormat *fmt, BenchMode mode, gint iterations, gint warmup, gint n_threads,
+                         GString *json) {
+  GstHarness *h;
+  GstBuffer *buf, *out_buf;
+  GstCaps *caps;
+  gsize size = bench_format_size(fmt);
+  guint64 *latencies, total = 0;
+  gint allocations;
+  gchar *kernel = NULL;
+
+  caps = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING, fmt->format, "width", G_TYPE_INT, fmt->width,
+                             "height", G_TYPE_INT, fmt->height, "framerate", GST_TYPE_FRACTION, 30, 1, NULL);
+
+  h = gst_harness_new("myfilter");
+  g_object_set(h->element, "silent", TRUE, "n-threads", n_threads, "brightness",
+               mode == BENCH_MODE_PASSTHROUGH ? 0 : 10, NULL);
+  gst_harness_set_src_caps(h, caps);
+
+  buf = gst_harness_create_buffer(h, size);
+  gst_buffer_memset(buf, 0, 100, size);
+
+  latencies = g_new(guint64, iterations);
+  allocations = 0;
+
+  for (gint i = -warmup; i < iterations; i++) {
+    GstClockTime start, stop;
+
+    /* only the measured iterations count, the pools fill up during the warmup */
+    if (i == 0)
+      allocations = g_atomic_int_get(&n_allocations);
+
+    start = gst_util_get_timestamp();
+    if (mode == BENCH_MODE_IN_PLACE) {
+      /* we give away our only reference, the same buffer comes back */
+      out_buf = gst_harness_push_and_pull(h, buf);
+      buf = out_buf;
+    } else {
+      out_buf = gst_harness_push_and_pull(h, gst_buffer_ref(buf));
+    }
+    stop = gst_util_get_timestamp();
+
+    if (out_buf == NULL) {
+      g_printerr("No buffer came out of myfilter (%s %dx%d %s)\n", fmt->format, fmt->width, fmt->height,
+                 bench_mode_names[mode]);
+      /* in place, the harness took our only reference */
+      if (mode != BENCH_MODE_IN_PLACE)
+        gst_buffer_unref(buf);
+      g_free(latencies);
+      gst_harness_teardown(h);
+
+      return FALSE;
+    }
+    if (mode != BENCH_MODE_IN_PLACE)
+      gst_buffer_unref(out_buf);
+
+    if (i >= 0) {
+      latencies[i] = stop - start;
+      total += stop - start;
+    }
+  }
+
+  allocations = g_atomic_int_get(&n_allocations) - allocations;
+
+  g_object_get(h->element, "kernel", &kernel, NULL);
+  qsort(latencies, iterations, sizeof(guint64), compare_guint64);
+
+  if (json->len > 0)
+    g_string_append(json, ",\n");
+  g_string_append_printf(json, "    {\"format\": \"%s\", \"width\": %d, \"height\": %d, \"mode\": \"%s\", ",
+                         fmt->format, fmt->width, fmt->height, bench_mode_names[mode]);
+  g_string_append_printf(json, "\"kernel\": \"%s\", \"n_threads\": %d, \"iterations\": %d, ", kernel, n_threads,
+                         iterations);
+  g_string_append_printf(json, "\"buffers_per_second\": %.1f, \"ns_per_buffer\": %.1f, ",
+                         iterations / ((gdouble)total / GST_SECOND), (gdouble)total / iterations);
+  g_string_append_printf(json, "\"p50_ns\": %" G_GUINT64_FORMAT ", \"p99_ns\": %" G_GUINT64_FORMAT ", ",
+                         latencies[iterations / 2], latencies[MIN(iterations - 1, iterations * 99 / 100)]);
+  g_string_append_printf(json, "\"allocations_per_buffer\": %.4f}", (gdouble)allocations / iterations);
+
+  g_free(kernel);
+  g_free(latencies);
+  gst_buffer_unref(buf);
+  gst_harness_teardown(h);
+
+  return TRUE;
+}
+
+int main(int argc, char *argv[]) {
+  gint iterations = 500, warmup = 20, n_threads = 1;
+  gchar *output = NULL;
+  GOptionEntry entries[] = {
+      {"iterations", 'n', 0, G_OPTION_ARG_INT, &iterations, "Measured buffers per case", "N"},
+      {"warmup", 'w', 0, G_OPTION_ARG_INT, &warmup, "Buffers pushed before measuring", "N"},
+      {"threads", 't', 0, G_OPTION_ARG_INT, &n_threads, "n-threads property of myfilter (0 = automatic)", "N"},
+      {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the JSON report to FILE instead of stdout", "FILE"},
+      {NULL}};
+  GOptionContext *context;
+  GError *err = NULL;
+  GString *results, *report;
+  gboolean ok = TRUE;
+
+  context = g_option_context_new("- myfilter microbenchmark");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("%s\n", err->message);
+    g_clear_error(&err);
+
+    return -1;
+  }
+  g_option_context_free(context);
+
+  if (iterations <= 0 || warmup < 0) {
+    g_printerr("iterations must be positive and warmup not negative\n");
+    return -1;
+  }
+
+  /* Count every GstMemory allocation from here on */
+  gst_allocator_set_default(g_object_new(bench_allocator_get_type(), NULL));
+
+  results = g_string_new(NULL);
+  for (guint i = 0; i < G_N_ELEMENTS(bench_formats) && ok; i++) {
+    for (gint mode = BENCH_MODE_PASSTHROUGH; mode <= BENCH_MODE_COPY && ok; mode++)
+      ok = run_case(&bench_formats[i], mode, iterations, warmup, n_threads, results);
+  }
+
+  report = g_string_new(NULL);
+  g_string_append_printf(report, "{\n  \"element\": \"myfilter\",\n  \"results\": [\n%s\n  ]\n}\n", results->str);
+
+  if (ok && output) {
+    if (!g_file_set_contents(output, report->str, report->len, &err)) {
+      g_printerr("Could not write %s: %s\n", output, err->message);
+      g_clear_error(&err);
+      ok = FALSE;
+    }
+  } else if (ok) {
+    g_print("%s", report->str);
+  }
+
+  g_string_free(results, TRUE);
+  g_string_free(report, TRUE);
+  g_free(output);
+
+  return ok ? 0 : -1;
+}
@@ -0,0 +1,227 @@
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/gst.h>
+
+#define TEST_CAPS "application/x-test"
+#define TEST_BUFFER_SIZE 16
+
+static GstPadProbeReturn block_buffers(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    return GST_PAD_PROBE_OK;
+}
+
+static gpointer push_buffer(gpointer user_data) {
+    GstHarness *h = user_data;
+
+    return GINT_TO_POINTER(gst_harness_push(h, gst_harness_create_buffer(h, TEST_BUFFER_SIZE)));
+}
+
+GST_START_TEST (test_fanout)
+{
+    GstElement *fanout;
+
+    /* Setup */
+    fanout = gst_check_setup_element("fanout");
+
+    /* Test */
+    fail_unless(fanout != NULL, "Could not create element");
+
+    /* Teardown */
+    gst_check_teardown_element(fanout);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_fanout_shared_buffer)
+{
+    GstHarness *h1, *h2;
+    GstBuffer *in_buf, *out_buf1, *out_buf2;
+    guint n_pads;
+
+    /* Setup: two branches of the same element */
+    h1 = gst_harness_new_with_padnames("fanout", "sink", "src_%u");
+    h2 = gst_harness_new_with_element(h1->element, NULL, "src_%u");
+    gst_harness_set_src_caps_str(h1, TEST_CAPS);
+
+    g_object_get(h1->element, "num-src-pads", &n_pads, NULL);
+    fail_unless_equals_int(n_pads, 2);
+
+    /* Test: both branches get the very buffer that was pushed */
+    in_buf = gst_harness_create_buffer(h1, TEST_BUFFER_SIZE);
+    fail_unless_equals_int(gst_harness_push(h1, gst_buffer_ref(in_buf)), GST_FLOW_OK);
+    out_buf1 = gst_harness_pull(h1);
+    out_buf2 = gst_harness_pull(h2);
+    fail_unless(out_buf1 == in_buf, "Buffer was copied for the first branch");
+    fail_unless(out_buf2 == in_buf, "Buffer was copied for the second branch");
+
+    /* Test: the caps went through the rings too */
+    fail_unless(gst_pad_has_current_caps(h2->sinkpad));
+
+    /* Teardown */
+    gst_buffer_unref(out_buf1);
+    gst_buffer_unref(out_buf2);
+    gst_buffer_unref(in_buf);
+    gst_harness_teardown(h2);
+    gst_harness_teardown(h1);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_fanout_drop_policy)
+{
+    GstElement *fanout;
+    GstHarness *h;
+    GstPad *srcpad;
+    gulong probe;
+    guint64 dropped;
+    gint i;
+
+    /* Setup: a branch that can hold one buffer, with its task stuck on the first one */
+    fanout = gst_element_factory_make("fanout", NULL);
+    fail_unless(fanout != NULL, "Could not create element");
+    gst_util_set_object_arg(G_OBJECT(fanout), "policy", "drop");
+    g_object_set(fanout, "ring-size", 1, NULL);
+
+    h = gst_harness_new_full(fanout, NULL, "sink", NULL, "src_%u");
+    gst_harness_set_src_caps_str(h, TEST_CAPS);
+    srcpad = gst_pad_get_peer(h->sinkpad);
+    probe = gst_pad_add_probe(srcpad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BLOCK, block_buffers, NULL, NULL);
+
+    /* Test: the producer never waits, what doesn't fit is dropped for that branch */
+    for (i = 0; i < 4; i++)
+        fail_unless_equals_int(gst_harness_push(h, gst_harness_create_buffer(h, TEST_BUFFER_SIZE)), GST_FLOW_OK);
+    g_object_get(srcpad, "dropped", &dropped, NULL);
+    fail_unless(dropped >= 2, "Only %" G_GUINT64_FORMAT " buffers dropped", dropped);
+
+    /* Teardown */
+    gst_pad_remove_probe(srcpad, probe);
+    gst_object_unref(srcpad);
+    gst_object_unref(fanout);
+    gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_fanout_block_policy)
+{
+    GstElement *fanout;
+    GstHarness *h;
+    GstPad *srcpad;
+    guint64 dropped, leaked;
+    gint i;
+
+    /* Setup: a branch that can hold one buffer */
+    fanout = gst_element_factory_make("fanout", NULL);
+    fail_unless(fanout != NULL, "Could not create element");
+    gst_util_set_object_arg(G_OBJECT(fanout), "policy", "block");
+    g_object_set(fanout, "ring-size", 1, NULL);
+
+    h = gst_harness_new_full(fanout, NULL, "sink", NULL, "src_%u");
+    gst_harness_set_src_caps_str(h, TEST_CAPS);
+    srcpad = gst_pad_get_peer(h->sinkpad);
+
+    /* Test: the producer waits for the branch, every buffer goes through */
+    for (i = 0; i < 8; i++)
+        fail_unless_equals_int(gst_harness_push(h, gst_harness_create_buffer(h, TEST_BUFFER_SIZE)), GST_FLOW_OK);
+    for (i = 0; i < 8; i++)
+        gst_buffer_unref(gst_harness_pull(h));
+    g_object_get(srcpad, "dropped", &dropped, "leaked", &leaked, NULL);
+    fail_unless_equals_uint64(dropped, 0);
+    fail_unless_equals_uint64(leaked, 0);
+
+    /* Teardown */
+    gst_object_unref(srcpad);
+    gst_object_unref(fanout);
+    gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_fanout_leak_policy)
+{
+    GstElement *fanout;
+    GstHarness *h;
+    GstPad *srcpad;
+    gulong probe;
+    guint64 leaked;
+    gint i;
+
+    /* Setup: a branch that can hold one buffer, with its task stuck on the first one */
+    fanout = gst_element_factory_make("fanout", NULL);
+    fail_unless(fanout != NULL, "Could not create element");
+    gst_util_set_object_arg(G_OBJECT(fanout), "policy", "leak");
+    g_object_set(fanout, "ring-size", 1, NULL);
+
+    h = gst_harness_new_full(fanout, NULL, "sink", NULL, "src_%u");
+    gst_harness_set_src_caps_str(h, TEST_CAPS);
+    srcpad = gst_pad_get_peer(h->sinkpad);
+    probe = gst_pad_add_probe(srcpad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BLOCK, block_buffers, NULL, NULL);
+
+    /* Test: the producer never waits for the stalled branch, what doesn't fit is leaked */
+    for (i = 0; i < 4; i++)
+        fail_unless_equals_int(gst_harness_push(h, gst_harness_create_buffer(h, TEST_BUFFER_SIZE)), GST_FLOW_OK);
+    g_object_get(srcpad, "leaked", &leaked, NULL);
+    fail_unless(leaked >= 2, "Only %" G_GUINT64_FORMAT " buffers leaked", leaked);
+
+    /* Test: once unblocked the branch goes on */
+    gst_pad_remove_probe(srcpad, probe);
+    gst_buffer_unref(gst_harness_pull(h));
+
+    /* Teardown */
+    gst_object_unref(srcpad);
+    gst_object_unref(fanout);
+    gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_fanout_release_while_streaming)
+{
+    GstElement *fanout;
+    GstHarness *h;
+    GstPad *pad;
+    GThread *thread;
+    gint i;
+
+    /* Setup: a second branch, not linked and stuck on its first buffer, with the block policy */
+    fanout = gst_element_factory_make("fanout", NULL);
+    fail_unless(fanout != NULL, "Could not create element");
+    gst_util_set_object_arg(G_OBJECT(fanout), "policy", "block");
+    g_object_set(fanout, "ring-size", 1, NULL);
+
+    h = gst_harness_new_full(fanout, NULL, "sink", NULL, "src_%u");
+    gst_harness_set_src_caps_str(h, TEST_CAPS);
+    pad = gst_element_request_pad(fanout, gst_element_get_pad_template(fanout, "src_%u"), NULL, NULL);
+    fail_unless(pad != NULL, "Could not request a second branch");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BLOCK, block_buffers, NULL, NULL);
+
+    /* One buffer blocked in the task, one in the ring */
+    for (i = 0; i < 2; i++)
+        fail_unless_equals_int(gst_harness_push(h, gst_harness_create_buffer(h, TEST_BUFFER_SIZE)), GST_FLOW_OK);
+
+    /* Test: the producer waiting for the released branch is woken up and the stream goes on */
+    thread = g_thread_new("push", push_buffer, h);
+    g_usleep(G_USEC_PER_SEC / 10);
+    gst_element_release_request_pad(fanout, pad);
+    fail_unless_equals_int(GPOINTER_TO_INT(g_thread_join(thread)), GST_FLOW_OK);
+    fail_unless_equals_int(gst_harness_push(h, gst_harness_create_buffer(h, TEST_BUFFER_SIZE)), GST_FLOW_OK);
+    for (i = 0; i < 4; i++)
+        gst_buffer_unref(gst_harness_pull(h));
+
+    /* Teardown */
+    gst_object_unref(pad);
+    gst_object_unref(fanout);
+    gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+static Suite* fanout_suite(void) {
+    Suite *s = suite_create("fanout");
+    TCase *tc_chain = tcase_create("general");
+
+    suite_add_tcase(s, tc_chain);
+    tcase_add_test(tc_chain, test_fanout);
+    tcase_add_test(tc_chain, test_fanout_shared_buffer);
+    tcase_add_test(tc_chain, test_fanout_drop_policy);
+    tcase_add_test(tc_chain, test_fanout_block_policy);
+    tcase_add_test(tc_chain, test_fanout_leak_policy);
+    tcase_add_test(tc_chain, test_fanout_release_while_streaming);
+
+    return s;
+}
+
+GST_CHECK_MAIN(fanout);
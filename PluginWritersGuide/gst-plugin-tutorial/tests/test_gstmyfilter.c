@@ -1,6 +1,10 @@
 #include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
 #include <gst/gst.h>
 
+#define TEST_I420_CAPS "video/x-raw,format=I420,width=64,height=48,framerate=30/1"
+#define TEST_I420_SIZE (64 * 48 * 3 / 2)
+
 static GstElement * setup_myfilter(void) {
     GstElement *myfilter;
 
@@ -33,12 +37,215 @@ GST_START_TEST (test_myfilter)
 }
 GST_END_TEST;
 
+GST_START_TEST (test_myfilter_passthrough)
+{
+    GstHarness *h;
+    GstBuffer *in_buf, *out_buf;
+
+    /* Setup */
+    h = gst_harness_new("myfilter");
+    g_object_set(h->element, "silent", TRUE, NULL);
+    gst_harness_set_src_caps_str(h, TEST_I420_CAPS);
+
+    /* Test: keep our own reference so the buffer is not writable, it must still come out without a copy */
+    in_buf = gst_harness_create_buffer(h, TEST_I420_SIZE);
+    out_buf = gst_harness_push_and_pull(h, gst_buffer_ref(in_buf));
+    fail_unless(out_buf == in_buf, "Buffer was copied in passthrough mode");
+
+    /* Teardown */
+    gst_buffer_unref(out_buf);
+    gst_buffer_unref(in_buf);
+    gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_myfilter_brightness)
+{
+    GstHarness *h;
+    GstBuffer *in_buf, *out_buf;
+    GstMapInfo map;
+
+    /* Setup */
+    h = gst_harness_new("myfilter");
+    g_object_set(h->element, "silent", TRUE, "brightness", 10, NULL);
+    gst_harness_set_src_caps_str(h, TEST_I420_CAPS);
+
+    in_buf = gst_harness_create_buffer(h, TEST_I420_SIZE);
+    gst_buffer_memset(in_buf, 0, 100, TEST_I420_SIZE);
+
+    /* Test: luma is brightened, chroma is left alone */
+    out_buf = gst_harness_push_and_pull(h, in_buf);
+    fail_unless(gst_buffer_map(out_buf, &map, GST_MAP_READ));
+    fail_unless_equals_int(map.data[0], 110);
+    fail_unless_equals_int(map.data[64 * 48 - 1], 110);
+    fail_unless_equals_int(map.data[64 * 48], 100);
+    fail_unless_equals_int(map.data[TEST_I420_SIZE - 1], 100);
+    gst_buffer_unmap(out_buf, &map);
+
+    /* Teardown */
+    gst_buffer_unref(out_buf);
+    gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_myfilter_slices)
+{
+    GstHarness *h;
+    GstBuffer *in_buf, *out_buf;
+    GstMapInfo map;
+    gint i;
+
+    /* Setup: more threads than there are CPUs, and a height that doesn't divide evenly */
+    h = gst_harness_new("myfilter");
+    g_object_set(h->element, "silent", TRUE, "brightness", -20, "n-threads", 5, NULL);
+    gst_harness_set_src_caps_str(h, TEST_I420_CAPS);
+
+    in_buf = gst_harness_create_buffer(h, TEST_I420_SIZE);
+    gst_buffer_memset(in_buf, 0, 100, TEST_I420_SIZE);
+
+    /* Test: every luma row was processed exactly once */
+    out_buf = gst_harness_push_and_pull(h, in_buf);
+    fail_unless(gst_buffer_map(out_buf, &map, GST_MAP_READ));
+    for (i = 0; i < 64 * 48; i++)
+        fail_unless_equals_int(map.data[i], 80);
+    gst_buffer_unmap(out_buf, &map);
+
+    /* Teardown */
+    gst_buffer_unref(out_buf);
+    gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_myfilter_not_writable)
+{
+    GstHarness *h;
+    GstBuffer *in_buf, *out_buf;
+    GstMapInfo map;
+
+    /* Setup */
+    h = gst_harness_new("myfilter");
+    g_object_set(h->element, "silent", TRUE, "brightness", 10, NULL);
+    gst_harness_set_src_caps_str(h, TEST_I420_CAPS);
+
+    in_buf = gst_harness_create_buffer(h, TEST_I420_SIZE);
+    gst_buffer_memset(in_buf, 0, 100, TEST_I420_SIZE);
+
+    /* Test: we keep a reference, so the result must go to a new buffer and the input must stay untouched */
+    out_buf = gst_harness_push_and_pull(h, gst_buffer_ref(in_buf));
+    fail_unless(out_buf != in_buf);
+
+    fail_unless(gst_buffer_map(out_buf, &map, GST_MAP_READ));
+    fail_unless_equals_int(map.data[0], 110);
+    fail_unless_equals_int(map.data[TEST_I420_SIZE - 1], 100);
+    gst_buffer_unmap(out_buf, &map);
+
+    fail_unless(gst_buffer_map(in_buf, &map, GST_MAP_READ));
+    fail_unless_equals_int(map.data[0], 100);
+    gst_buffer_unmap(in_buf, &map);
+
+    /* Test: the output buffer came from a pool */
+    fail_unless(out_buf->pool != NULL);
+
+    /* Teardown */
+    gst_buffer_unref(out_buf);
+    gst_buffer_unref(in_buf);
+    gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+/* counts the buffer lists leaving the element, and the buffers in them */
+static GstPadProbeReturn count_lists_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    guint *counts = user_data;
+
+    counts[0]++;
+    counts[1] += gst_buffer_list_length(GST_PAD_PROBE_INFO_BUFFER_LIST(info));
+
+    return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (test_myfilter_buffer_list)
+{
+    GstHarness *h;
+    GstBufferList *list;
+    GstBuffer *shared_buf, *out_buf;
+    GstMapInfo map;
+    GstPad *srcpad;
+    guint counts[2] = {0, 0};
+    gint i;
+
+    /* Setup */
+    h = gst_harness_new("myfilter");
+    g_object_set(h->element, "silent", TRUE, "brightness", 10, NULL);
+    gst_harness_set_src_caps_str(h, TEST_I420_CAPS);
+
+    srcpad = gst_element_get_static_pad(h->element, "src");
+    gst_pad_add_probe(srcpad, GST_PAD_PROBE_TYPE_BUFFER_LIST, count_lists_probe, counts, NULL);
+
+    /* the first buffer negotiates caps and allocation, it goes through on its own */
+    out_buf = gst_harness_create_buffer(h, TEST_I420_SIZE);
+    gst_buffer_memset(out_buf, 0, 100, TEST_I420_SIZE);
+    fail_unless_equals_int(gst_harness_push(h, out_buf), GST_FLOW_OK);
+    gst_buffer_unref(gst_harness_pull(h));
+
+    /* one buffer is still referenced by us, the other two are only owned by the list */
+    shared_buf = gst_harness_create_buffer(h, TEST_I420_SIZE);
+    gst_buffer_memset(shared_buf, 0, 100, TEST_I420_SIZE);
+
+    list = gst_buffer_list_new();
+    for (i = 0; i < 3; i++) {
+        GstBuffer *buf;
+
+        if (i == 1) {
+            buf = gst_buffer_ref(shared_buf);
+        } else {
+            buf = gst_harness_create_buffer(h, TEST_I420_SIZE);
+            gst_buffer_memset(buf, 0, 100, TEST_I420_SIZE);
+        }
+        GST_BUFFER_PTS(buf) = (i + 1) * GST_SECOND / 30;
+        gst_buffer_list_add(list, buf);
+    }
+
+    /* Test: the list goes downstream as one list, not buffer by buffer */
+    fail_unless_equals_int(gst_pad_push_list(h->srcpad, list), GST_FLOW_OK);
+    fail_unless_equals_int(counts[0], 1);
+    fail_unless_equals_int(counts[1], 3);
+    fail_unless_equals_int(gst_harness_buffers_received(h), 4);
+
+    /* Test: every buffer of the list comes out processed and in order */
+    for (i = 0; i < 3; i++) {
+        out_buf = gst_harness_pull(h);
+        fail_unless(out_buf != NULL);
+        fail_unless_equals_uint64(GST_BUFFER_PTS(out_buf), (i + 1) * GST_SECOND / 30);
+
+        fail_unless(gst_buffer_map(out_buf, &map, GST_MAP_READ));
+        fail_unless_equals_int(map.data[0], 110);
+        gst_buffer_unmap(out_buf, &map);
+        gst_buffer_unref(out_buf);
+    }
+
+    /* Test: the buffer we held on to was not modified */
+    fail_unless(gst_buffer_map(shared_buf, &map, GST_MAP_READ));
+    fail_unless_equals_int(map.data[0], 100);
+    gst_buffer_unmap(shared_buf, &map);
+
+    /* Teardown */
+    gst_object_unref(srcpad);
+    gst_buffer_unref(shared_buf);
+    gst_harness_teardown(h);
+}
+GST_END_TEST;
+
 static Suite* myfilter_suite(void) {
     Suite *s = suite_create("myfilter");
     TCase *tc_chain = tcase_create("general");
 
     suite_add_tcase(s, tc_chain);
     tcase_add_test(tc_chain, test_myfilter);
+    tcase_add_test(tc_chain, test_myfilter_passthrough);
+    tcase_add_test(tc_chain, test_myfilter_brightness);
+    tcase_add_test(tc_chain, test_myfilter_slices);
+    tcase_add_test(tc_chain, test_myfilter_not_writable);
+    tcase_add_test(tc_chain, test_myfilter_buffer_list);
 
     return s;
 }